@@ -12,3 +12,11 @@
 #   define log_error(fmt, ...)       (fflush(nullptr), fprintf(stderr, fmt "\n", ## __VA_ARGS__), fflush(nullptr))
 #endif
 
+
+// used by ConfigFileParser.h
+#if !defined(ICY_LOG)
+#   define ICY_LOG(fmt, ...)         log_host (fmt, ## __VA_ARGS__)
+#endif
+#if !defined(ICY_LOG_ERROR)
+#   define ICY_LOG_ERROR(fmt, ...)   log_error(fmt, ## __VA_ARGS__)
+#endif
@@ -8,6 +8,7 @@
 #include "fs.h"
 #include "defer.h"
 #include "icy_log.h"
+#include "icy_assert.h"
 
 using ConfigParseAddFunc = std::function<void(const std::string&, const std::string&)>;
 
@@ -47,5 +47,14 @@
 #   endif
 #endif
 
+// Linux is also PLATFORM_POSIX. This narrower define gates Linux-only syscalls (getdents64, etc).
+#if !defined(PLATFORM_LINUX)
+#   if defined(__linux__)
+#       define PLATFORM_LINUX   1
+#   else
+#       define PLATFORM_LINUX   0
+#   endif
+#endif
+
 #define PLATFORM_SCE (PLATFORM_PS4 || PLATFORM_PS5)
 
@@ -4,8 +4,13 @@
 #include <vector>
 #include <functional>
 #include <string>
+#include <string_view>
+#include <atomic>
+#include <type_traits>
+#include <iterator>
 
 #include "StringUtil.h"
+#include "posix_file.h"
 
 #if PLATFORM_PS4
 #define fread_s(a, b, c, d, e) fread(a, c, d, e)
@@ -15,14 +20,62 @@
 #   include <sys/stat.h>
 #endif
 
+// FS_NATIVE_IS_UNIVERSAL - set when the host libc accepts universal paths as-is, in which case
+// fs::path never stores a second native copy of the path and c_str() is an identity view.
+#if !defined(FS_NATIVE_IS_UNIVERSAL)
+#	if PLATFORM_MSW
+#		define FS_NATIVE_IS_UNIVERSAL	0
+#	else
+#		define FS_NATIVE_IS_UNIVERSAL	1
+#	endif
+#endif
+
+// FS_PATH_CACHE_HASH - fs::path remembers its case-folded hash once computed, so repeated lookups
+// and equality tests against hashed paths avoid rescanning the string. Costs one word per path.
+#if !defined(FS_PATH_CACHE_HASH)
+#	define FS_PATH_CACHE_HASH		1
+#endif
+
 namespace fs {
 
 class path;
+class path_view;
+class path_list;
+class path_builder;
+
+enum class path_error : uint8_t {
+	none = 0,
+	rooted_without_drive,		// eg. \foo or /foo, msw-style rooted path lacking a drive letter
+};
+
+// upper bound of output length for the buffer-based ConvertFromMsw() and PathFromString().
+constexpr size_t ConvertFromMswMaxLen(size_t srclen) {
+	return (srclen + 2 > 9) ? (srclen + 2) : 9;		// drive letter prefix, or NUL -> /dev/null
+}
 
 bool		IsMswPathSep		(char c);
 std::string ConvertFromMsw		(const std::string& msw_path);
 std::string ConvertToMsw		(const std::string& unix_path);
 std::string PathFromString		(const char* path);
+const char*	PathErrorString		(path_error error);
+
+// Buffer-based conversions, which neither allocate nor log. dst must have room for
+// ConvertFromMswMaxLen(src.length()) bytes, and is not null-terminated. Return output length,
+// which is zero on error.
+size_t		ConvertFromMsw		(char* dst, std::string_view msw_path, path_error* error = nullptr);
+size_t		PathFromString		(char* dst, std::string_view path, path_error* error = nullptr);
+
+// Normalizes a batch of user-provided strings into dest, one entry per input such that indices
+// line up. Invalid entries are added as empty paths and reported via 'errors' (if provided, which
+// is resized to count). Large batches are split across threads. Returns the number of errors.
+int			PathsFromStrings	(path_list& dest, const char* const* srcs, size_t count, std::vector<path_error>* errors = nullptr);
+inline int	PathsFromStrings	(path_list& dest, const std::vector<const char*>& srcs, std::vector<path_error>* errors = nullptr) {
+	return PathsFromStrings(dest, srcs.data(), srcs.size(), errors);
+}
+
+// one stat() of the path. Returns a zeroed record (Exists() is false) if it can't be stat'd.
+// exists(), file_size(), is_directory() and create_directory() are all built on it.
+CStatInfo	status				(const path& path);
 
 bool		exists				(const path& path);
 void		remove				(const path& path);
@@ -34,15 +87,378 @@ std::string replace_extension	(const std::string& srcpath, const std::string& ex
 std::string remove_extension	(const std::string& srcpath, const std::string& ext_to_remove);
 bool		stat				(const path& path, struct stat& st);
 std::string absolute			(const path& fspath);
+path		current_path		();
+
+// absolute path resolved against base (current_path() if unspecified or empty) and lexically
+// normalized, without consulting the filesystem.
+path		lexically_absolute	(const path& fspath);
+path		lexically_absolute	(const path& fspath, const path& base);
+
+bool		HasDevicePrefix		(std::string_view uni_path);
+size_t		LexicallyNormal		(char* uni_path, size_t length);		// in-place, returns new length
 
 std::vector<path>	directory_iterator(const path& path);
 void				directory_iterator(const std::function<void (const fs::path& path)>& func, const path& path);
+void				directory_iterator(path_list& dest, const path& path);
+
+// case-insensitive comparison matching the semantics of strcasecmp(), for non-terminated strings.
+inline int CompareNoCase(std::string_view left, std::string_view right) {
+	auto len = (left.length() < right.length()) ? left.length() : right.length();
+	for (size_t i=0; i<len; ++i) {
+		int lc = tolower((uint8_t)left [i]);
+		int rc = tolower((uint8_t)right[i]);
+		if (lc != rc) return lc - rc;
+	}
+	if (left.length() == right.length()) return 0;
+	return (left.length() < right.length()) ? -1 : 1;
+}
+
+// case-folded hash consistent with CompareNoCase(), never returns 0.
+size_t HashNoCase(std::string_view uni_path);
+
+// --------------------------------------------------------------------------------------------------
+// path_view
+//
+// Non-owning view of a universal path, for decomposing paths without heap allocation. The viewed
+// string is expected to already be in universal form (eg. the contents of an fs::path), no
+// conversion or validation is performed. Accessors mirror those of fs::path and return views into
+// the same storage, so the view must not outlive the string it refers to.
+//
+class path_view
+{
+protected:
+	std::string_view	uni_path_;
+
+	static const uint8_t separator = '/';
+
+public:
+	constexpr path_view() = default;
+	constexpr path_view(std::string_view uni_path) : uni_path_(uni_path) { }
+	constexpr path_view(const char* uni_path) : uni_path_(uni_path) { }
+	path_view(const std::string& uni_path) : uni_path_(uni_path) { }
+	explicit path_view(const path& src);
+
+	constexpr bool empty() const { return uni_path_.empty(); }
+
+	constexpr std::string_view extension() const {
+		auto pos = uni_path_.find_last_of('.');
+		if (pos != std::string_view::npos)
+			return uni_path_.substr(pos);
+
+		return {};
+	}
+
+	constexpr std::string_view filename() const {
+		auto pos = uni_path_.find_last_of(separator);
+		if (pos != std::string_view::npos)
+			return uni_path_.substr(pos + 1);
+
+		return uni_path_;
+	}
+
+	constexpr path_view parent_path() const {
+		auto pos = uni_path_.find_last_of(separator);
+		if (pos != std::string_view::npos)
+			return uni_path_.substr(0, pos);
+
+		return *this;
+	}
+
+	constexpr path_view dirname() const { return parent_path(); }
+
+	constexpr bool is_absolute() const {
+		return (!uni_path_.empty() && uni_path_[0] == separator);
+	}
+
+	// length of the leading element yielded by iteration: the root name, or "/" if there is none.
+	constexpr size_t root_length() const {
+		auto root = root_name();
+		if (!root.empty()) return root.length();
+		return is_absolute() ? 1 : 0;
+	}
+
+	constexpr bool is_device() const {
+		if (uni_path_.empty() || uni_path_[0] != '/') return 0;		// shortcut early out.
+
+		for (std::string_view dev : { std::string_view("/dev/null"), std::string_view("/dev/tty") }) {
+			if (uni_path_.substr(0, dev.length()) != dev) continue;
+			if (uni_path_.length() == dev.length()) return 1;
+			if (uni_path_[dev.length()] == '/') return 1;
+		}
+		return 0;
+	}
+
+	constexpr std::string_view uni_string() const { return uni_path_; }
+
+	// Root prefix of the path, or empty if it has none:
+	//   /c/dir         -> /c           (drive)
+	//   //server/dir   -> //server     (network share)
+	//   umd:/dir       -> umd:         (device)
+	// A plain absolute path such as /dev/null has a root directory but no root name.
+	constexpr std::string_view root_name() const {
+		auto len = uni_path_.length();
+		if (len >= 2 && uni_path_[0] == separator) {
+			if (uni_path_[1] == separator) {
+				auto end = uni_path_.find(separator, 2);
+				return uni_path_.substr(0, end);
+			}
+			bool is_drive = (uni_path_[1] >= 'a' && uni_path_[1] <= 'z') || (uni_path_[1] >= 'A' && uni_path_[1] <= 'Z') || (uni_path_[1] >= '0' && uni_path_[1] <= '9');
+			if (is_drive && (len == 2 || uni_path_[2] == separator)) {
+				return uni_path_.substr(0, 2);
+			}
+			return {};
+		}
+
+		auto pos = uni_path_.find_first_of("/:");
+		if (pos != std::string_view::npos && pos > 0 && uni_path_[pos] == ':') {
+			return uni_path_.substr(0, pos + 1);
+		}
+		return {};
+	}
+
+	// --------------------------------------------------------------------------------------------------
+	// Component iteration. Yields the root name (or "/" for a plain absolute path) followed by each
+	// non-empty component; "/c/one//two" yields "/c", "one", "two". Components are views into the
+	// path's own storage and no allocation is performed.
+	//
+	class iterator
+	{
+	protected:
+		std::string_view	path_;
+		size_t				root_len_;
+		size_t				pos_;
+		size_t				len_;
+
+	public:
+		using iterator_category	= std::bidirectional_iterator_tag;
+		using value_type		= std::string_view;
+		using difference_type	= std::ptrdiff_t;
+		using pointer			= const std::string_view*;
+		using reference			= std::string_view;
+
+		constexpr iterator() : root_len_(0), pos_(0), len_(0) { }
+
+		constexpr iterator(std::string_view path, size_t root_len, size_t pos)
+			: path_(path), root_len_(root_len), pos_(pos), len_(0)
+		{
+			if (pos_ >= path_.length()) {
+				pos_ = path_.length();
+			}
+			else if (pos_ < root_len_) {
+				len_ = root_len_;
+			}
+			else {
+				while (pos_ < path_.length() && path_[pos_] == separator) {
+					++pos_;
+				}
+				len_ = component_length();
+			}
+		}
+
+		constexpr std::string_view operator*() const { return path_.substr(pos_, len_); }
+
+		constexpr iterator& operator++() {
+			pos_ += len_;
+			while (pos_ < path_.length() && path_[pos_] == separator) {
+				++pos_;
+			}
+			len_ = component_length();
+			return *this;
+		}
+
+		constexpr iterator& operator--() {
+			auto end = pos_;
+			while (end > root_len_ && path_[end - 1] == separator) {
+				--end;
+			}
+			if (end <= root_len_) {
+				pos_ = 0;
+				len_ = root_len_;
+				return *this;
+			}
+			auto beg = end;
+			while (beg > root_len_ && path_[beg - 1] != separator) {
+				--beg;
+			}
+			pos_ = beg;
+			len_ = end - beg;
+			return *this;
+		}
+
+		constexpr iterator operator++(int) { auto prev = *this; ++*this; return prev; }
+		constexpr iterator operator--(int) { auto prev = *this; --*this; return prev; }
+
+		constexpr bool operator==(const iterator& s) const { return pos_ == s.pos_ && path_.data() == s.path_.data(); }
+		constexpr bool operator!=(const iterator& s) const { return !operator==(s); }
+
+	protected:
+		constexpr size_t component_length() const {
+			auto end = path_.find(separator, pos_);
+			return ((end == std::string_view::npos) ? path_.length() : end) - pos_;
+		}
+	};
+
+	using const_iterator			= iterator;
+	using reverse_iterator			= std::reverse_iterator<iterator>;
+	using const_reverse_iterator	= reverse_iterator;
+
+	constexpr iterator begin() const { return { uni_path_, root_length(), 0 }; }
+	constexpr iterator end  () const { return { uni_path_, root_length(), uni_path_.length() }; }
+
+	reverse_iterator rbegin() const { return reverse_iterator(end  ()); }
+	reverse_iterator rend  () const { return reverse_iterator(begin()); }
+
+	size_t hash() const { return HashNoCase(uni_path_); }
+
+	// case folding never changes length, so a length mismatch is a cheap early-out.
+	bool  operator == (const path_view& s)      const { return uni_path_.length() == s.uni_path_.length() && CompareNoCase(uni_path_, s.uni_path_) == 0; }
+	bool  operator != (const path_view& s)      const { return !operator==(s); }
+	bool  operator >  (const path_view& s)      const { return CompareNoCase(uni_path_, s.uni_path_) >  0; }
+	bool  operator >= (const path_view& s)      const { return CompareNoCase(uni_path_, s.uni_path_) >= 0; }
+	bool  operator <  (const path_view& s)      const { return CompareNoCase(uni_path_, s.uni_path_) <  0; }
+	bool  operator <= (const path_view& s)      const { return CompareNoCase(uni_path_, s.uni_path_) <= 0; }
+};
+
+// --------------------------------------------------------------------------------------------------
+// Compile-time path literals
+//
+// PathFromStringConstexpr() is the scalar, constexpr twin of the buffer-based PathFromString() and
+// produces identical output. It exists so that path constants can be normalized by the compiler:
+//
+//     static constexpr auto cfg_dir = "c:\\data\\cfg"_upath;     // "/c/data/cfg"
+//     fs::path cfg = cfg_dir;                                    // no runtime normalization
+//
+// An invalid layout in a constant-evaluated literal is a compile error, since the error path calls
+// UpathLiteralInvalid(), which is not constexpr. Evaluated at runtime it aborts with a message.
+//
+constexpr size_t PathFromStringConstexpr(char* dst, std::string_view src, path_error* error = nullptr) {
+	auto is_alnum = [](char c) {
+		return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9');
+	};
+	auto emit = [dst](std::string_view literal) {
+		for (size_t i=0; i<literal.length(); ++i) {
+			dst[i] = literal[i];
+		}
+		return literal.length();
+	};
+
+	if (error) {
+		*error = path_error::none;
+	}
+
+	if (src.empty()) return 0;
+	if (src == "NUL") return emit("/dev/null");
+	if (src == "CON") return emit("/dev/tty");
+
+	size_t srcpos = 0;
+	size_t length = 0;
+	if (src[0] == '/') {
+		// already universal, copied verbatim.
+		length = emit(src);
+	}
+	else {
+		if (src.length() >= 2 && is_alnum(src[0]) && src[1] == ':') {
+			dst[0] = '/';
+			dst[1] = (src[0] >= 'A' && src[0] <= 'Z') ? char(src[0] - 'A' + 'a') : src[0];
+			if (src.length() == 2) {
+				return 2;
+			}
+			srcpos = length = 2;
+		}
+		else if (src[0] == '\\' && (src.length() < 2 || src[1] != '\\')) {
+			if (error) {
+				*error = path_error::rooted_without_drive;
+			}
+			return 0;
+		}
+
+		for (; srcpos < src.length(); ++srcpos) {
+			dst[length++] = (src[srcpos] == '\\') ? '/' : src[srcpos];
+		}
+	}
+
+	if (length && dst[length-1] == '/') {
+		--length;
+	}
+	return length;
+}
+
+// not constexpr by design, see above.
+void UpathLiteralInvalid(std::string_view src, path_error error);
+
+// A normalized universal path held by value, typically produced at compile time by _upath.
+template<size_t Cap>
+struct upath_literal
+{
+	char	str_[Cap + 1]	= {};			// null-terminated
+	size_t	len_			= 0;
+
+	constexpr upath_literal() = default;
+	constexpr upath_literal(std::string_view src) {
+		path_error error = path_error::none;
+		if (ConvertFromMswMaxLen(src.length()) > Cap) {
+			UpathLiteralInvalid(src, path_error::none);
+		}
+		else {
+			len_ = PathFromStringConstexpr(str_, src, &error);
+			if (error != path_error::none) {
+				UpathLiteralInvalid(src, error);
+			}
+		}
+	}
+
+	constexpr std::string_view	uni_string() const { return { str_, len_ }; }
+	constexpr path_view			view      () const { return uni_string(); }
+	constexpr const char*		uni_c_str () const { return str_; }
+};
+
+// capacity of a _upath literal, in normalized bytes.
+constexpr size_t upath_literal_max = 255;
+
+inline namespace literals {
+	constexpr upath_literal<upath_literal_max> operator""_upath(const char* src, size_t len) {
+		return upath_literal<upath_literal_max>(std::string_view(src, len));
+	}
+}
 
 class path
 {
 protected:
+	// Lazily-materialized native path. Copies of a path do not inherit the cache, since most copies
+	// are intermediates (parent_path, operator/) that are never handed to libc.
+	// Materialization is lock-free: racing threads each build the string, first one wins.
+	struct native_cache {
+		mutable std::atomic<std::string*>	ptr = { nullptr };
+
+		native_cache() = default;
+		native_cache(const native_cache&) noexcept { }
+		native_cache(native_cache&& rvalue) noexcept { ptr = rvalue.ptr.exchange(nullptr); }
+		native_cache& operator=(const native_cache&) noexcept { reset(); return *this; }
+		native_cache& operator=(native_cache&& rvalue) noexcept { reset(); ptr = rvalue.ptr.exchange(nullptr); return *this; }
+		~native_cache() { reset(); }
+
+		void reset() { delete ptr.exchange(nullptr); }
+	};
+
+	// Lazily-computed HashNoCase() of the universal path, 0 when not yet computed. Unlike the native
+	// cache, the hash is cheap to carry over when copying.
+	struct hash_cache {
+		mutable std::atomic<size_t>			value = { 0 };
+
+		hash_cache() = default;
+		hash_cache(const hash_cache& src) noexcept { value.store(src.value.load(std::memory_order_relaxed), std::memory_order_relaxed); }
+		hash_cache& operator=(const hash_cache& src) noexcept { value.store(src.value.load(std::memory_order_relaxed), std::memory_order_relaxed); return *this; }
+
+		void reset() { value.store(0, std::memory_order_relaxed); }
+	};
+
 	std::string		uni_path_;			// universal path, path separators are forward slashes only (may include platform prefixes)
-	std::string		libc_path_;			// native path expected by libc and such
+#if !FS_NATIVE_IS_UNIVERSAL
+	native_cache	libc_path_;			// native path expected by libc and such, built on first use.
+#endif
+#if FS_PATH_CACHE_HASH
+	hash_cache		hash_;
+#endif
 
 	static const uint8_t separator = '/';
 
@@ -50,52 +466,64 @@ public:
 	path() = default;
 	path(const char* src) {
 		uni_path_ = fs::PathFromString(src);
-		update_native_path();
 	}
 
 	template<int len>
 	path(const char (&src)[len]) {
 		uni_path_ = fs::PathFromString(src);
-		update_native_path();
 	}
 
 	path(char* (&src)) {
 		uni_path_ = fs::PathFromString(src);
-		update_native_path();
 	}
 
 	template<int len>
 	fs::path& operator=(const char (&src)[len]) {
 		uni_path_ = fs::PathFromString(src);
-		update_native_path();
+		invalidate_cache();
 		return *this;
 	}
 
 	fs::path& operator=(char* (&src)) {
 		uni_path_ = fs::PathFromString(src);
-		update_native_path();
+		invalidate_cache();
 		return *this;
 	}
 
 	path(const std::string& src) {
 		uni_path_ = fs::PathFromString(src.c_str());
-		update_native_path();
 	}
 
+	// path_view contents are already universal, so no normalization is performed.
+	explicit path(const path_view& src) : uni_path_(src.uni_string()) { }
+
+	// literals are normalized at compile time, see _upath.
+	template<size_t Cap>
+	path(const upath_literal<Cap>& src) : uni_path_(src.uni_string()) { }
+
+	path_view view() const { return path_view(uni_path_); }
+
 	// accepting implicit std::string conversions Causes too many problems with ambiguous assignments on clang.
 	// Not worth the convenience of not typing .c_str() here or there.
 	//fs::path& operator=(const std::string& src) {
 	//	uni_path_ = fs::PathFromString(src.c_str());
-	//	update_native_path();
+	//	invalidate_cache();
 	//	return *this;
 	//}
 
 	bool empty() const { return uni_path_.empty(); }
-	void clear() { uni_path_.clear(); libc_path_.clear(); }
+	void clear() { uni_path_.clear(); invalidate_cache(); }
 
 	path& append(const std::string& comp);
 	path& concat(const std::string& src);
 
+	// in-place lexical normalization ("." and ".." components, duplicate separators), see LexicallyNormal().
+	path& normalize();
+
+	path lexically_normal() const {
+		return path(*this).normalize();
+	}
+
 	// immutable extention replacement, intentionally differs from STL's mutable version, because
 	// no one wants or expects mutable string/path operations in this context.
 	path replace_extension(const std::string& extension) const {
@@ -105,49 +533,44 @@ public:
 	std::string extension() const {
 		// implementation note: returns a string because a filename will itself never have
 		// variances based on host OS / platform.
-
-		std::string extension;
-		auto pos = uni_path_.find_last_of('.');
-
-		if (pos != std::string::npos)
-			extension = uni_path_.substr(pos);
-
-		return extension;
+		return std::string(view().extension());
 	}
 
 	std::string filename() const {
 		// implementation note: returns a string because a filename will itself never have
 		// variances based on host OS / platform.
-		auto pos = uni_path_.find_last_of(separator);
-		if (pos != std::string::npos)
-			return uni_path_.substr(pos + 1);
-
-		return uni_path_;
+		return std::string(view().filename());
 	}
 
 	path parent_path() const {
-		auto pos = uni_path_.find_last_of(separator);
-		if (pos != std::string::npos)
-			return uni_path_.substr(0, pos).c_str();
-
-		return *this;
+		return path(view().parent_path());
 	}
 
 
-	bool is_absolute() const {
-		return (!uni_path_.empty() && uni_path_[0] == separator);
+	// case-folded hash, consistent with operator==
+	size_t hash() const {
+#if FS_PATH_CACHE_HASH
+		if (auto cached = hash_.value.load(std::memory_order_relaxed)) {
+			return cached;
+		}
+		auto result = HashNoCase(uni_path_);
+		hash_.value.store(result, std::memory_order_relaxed);
+		return result;
+#else
+		return HashNoCase(uni_path_);
+#endif
 	}
 
-	bool is_device() const {
-		if (uni_path_.empty() || uni_path_[0] != '/') return 0;		// shortcut early out.
+	bool is_absolute() const { return view().is_absolute(); }
+	bool is_device  () const { return view().is_device  (); }
 
-		if (uni_path_ == "/dev/null") return 1;
-		if (uni_path_ == "/dev/tty" ) return 1;
-		if (StringUtil::BeginsWith(uni_path_, "/dev/null/")) return 1;
-		if (StringUtil::BeginsWith(uni_path_, "/dev/tty/" )) return 1;
+	std::string_view root_name() const { return view().root_name(); }
 
-		return 0;
-	}
+	// component iteration, see path_view::iterator. Iterators are invalidated by modifying the path.
+	path_view::iterator			begin () const { return view().begin (); }
+	path_view::iterator			end   () const { return view().end   (); }
+	path_view::reverse_iterator	rbegin() const { return view().rbegin(); }
+	path_view::reverse_iterator	rend  () const { return view().rend  (); }
 
 	// POSIX style alias for C++ 'parent_path()'
 	path dirname() const { return parent_path(); }
@@ -188,7 +611,8 @@ public:
 	path  operator +  (const std::string& ext)  const { return path(*this).concat(ext); }
 	path& operator += (const std::string& ext)	      { return concat(ext); }
 
-	std::string asLibcStr() const { return libc_path(); }
+	// returns a native copy without populating the native path cache.
+	std::string asLibcStr() const;
 
 	static std::string asLibcStr(const char* src) {
 		return fs::path(src).asLibcStr();
@@ -199,11 +623,165 @@ public:
 
 public:
 	std::string& raw_modifiable_uni () { return uni_path_; }
-	void		 raw_commit_modified() { update_native_path(); }
+	void		 raw_commit_modified() { invalidate_cache(); }
 
 protected:
+	friend class path_builder;
+
 	const std::string& libc_path() const;
-	void update_native_path();
+
+	void invalidate_cache() {
+#if !FS_NATIVE_IS_UNIVERSAL
+		libc_path_.reset();
+#endif
+#if FS_PATH_CACHE_HASH
+		hash_.reset();
+#endif
+	}
+};
+
+inline path_view::path_view(const path& src) : uni_path_(src.uni_string()) { }
+
+// containers of paths must relocate by move, not by copy.
+static_assert(std::is_nothrow_move_constructible<path>::value, "fs::path must be nothrow-movable.");
+
+// --------------------------------------------------------------------------------------------------
+// path_builder
+//
+// Fused join of several components. A chain such as `root / dir / sub / file` produces a temporary
+// fs::path for every operator/, each one copying the result so far. The builder instead collects the
+// components and joins them in a single pass into a single allocation:
+//
+//     fs::path full = fs::path_builder(root) / dir / sub / file;
+//
+// Semantics match path::append(): raw strings are normalized by PathFromString(), and a component
+// that is rooted after normalization discards everything before it. Components are referenced,
+// not copied, so the builder must not outlive its arguments; it's meant to be consumed within the
+// expression that creates it.
+//
+class path_builder
+{
+protected:
+	struct component {
+		std::string_view	str;
+		bool				universal;		// from a path or path_view, no normalization needed
+	};
+
+	static const int inline_max = 8;
+
+	component				inline_[inline_max];
+	std::vector<component>	overflow_;		// only used by unusually long chains
+	int						count_ = 0;
+
+	void add(std::string_view str, bool universal) {
+		if (count_ < inline_max) {
+			inline_[count_] = { str, universal };
+		}
+		else {
+			overflow_.push_back({ str, universal });
+		}
+		++count_;
+	}
+
+	const component& at(int idx) const {
+		return (idx < inline_max) ? inline_[idx] : overflow_[idx - inline_max];
+	}
+
+public:
+	path_builder() = default;
+	explicit path_builder(const path& base)				{ add(base.uni_string(), true);  }
+	explicit path_builder(path_view base)				{ add(base.uni_string(), true);  }
+
+	path_builder& operator / (const path& comp)			{ add(comp.uni_string(), true);  return *this; }
+	path_builder& operator / (path_view comp)			{ add(comp.uni_string(), true);  return *this; }
+	path_builder& operator / (const char* comp)			{ add(comp ? comp : "", false);  return *this; }
+	path_builder& operator / (const std::string& comp)	{ add(comp, false);              return *this; }
+
+	path build() const;
+	operator path() const { return build(); }
+};
+
+// Functors for keying unordered containers on paths or path_views, matching the case-insensitive
+// semantics of path::operator==.
+struct path_hash_nocase {
+	size_t operator()(const path& src) const { return src.hash(); }
+	size_t operator()(path_view   src) const { return src.hash(); }
+};
+
+struct path_equal_nocase {
+	bool operator()(const path& left, const path& right) const { return left == right; }
+	bool operator()(const path& left, path_view   right) const { return left.view() == right; }
+	bool operator()(path_view   left, const path& right) const { return left == right.view(); }
+	bool operator()(path_view   left, path_view   right) const { return left == right; }
+};
+
+// --------------------------------------------------------------------------------------------------
+// path_list
+//
+// Packed collection of universal paths, intended for bulk results such as directory listings.
+// All path bytes live in a single buffer (each entry null-terminated) indexed by an offset table,
+// so populating the list costs amortized O(1) allocations and clear() or destruction is O(1)
+// regardless of entry count. Entries are accessed as path_views, which remain valid until the
+// list is next modified.
+//
+class path_list
+{
+protected:
+	std::vector<char>		strings_;		// packed universal paths, null-terminated
+	std::vector<uint32_t>	offsets_;		// start offset of each entry within strings_
+
+public:
+	class const_iterator
+	{
+	protected:
+		const path_list*	list_;
+		size_t				idx_;
+
+	public:
+		const_iterator(const path_list* list, size_t idx) : list_(list), idx_(idx) { }
+
+		path_view		operator *  ()							const { return (*list_)[idx_]; }
+		const_iterator&	operator ++ ()								  { ++idx_; return *this; }
+		bool			operator == (const const_iterator& s)	const { return idx_ == s.idx_; }
+		bool			operator != (const const_iterator& s)	const { return idx_ != s.idx_; }
+	};
+
+	size_t size		() const { return offsets_.size(); }
+	bool   empty	() const { return offsets_.empty(); }
+	size_t bytes	() const { return strings_.size(); }
+
+	void reserve	(size_t entries, size_t bytes) { offsets_.reserve(entries); strings_.reserve(bytes); }
+	void clear		() { offsets_.clear(); strings_.clear(); }
+	void release	();
+
+	void push_back		(path_view uni_path);
+	void push_back		(const path& src) { push_back(src.view()); }
+	void append			(const path_list& src);
+
+	// performs same normalization as fs::path(const char*), pushing an empty path on error.
+	path_error push_back_raw(std::string_view src);
+
+	path_view operator[](size_t idx) const {
+		auto beg = offsets_[idx];
+		auto end = (idx + 1 < offsets_.size()) ? offsets_[idx + 1] : strings_.size();
+		return std::string_view(strings_.data() + beg, end - beg - 1);
+	}
+
+	// null-terminated universal path of an entry, suitable for libc when FS_NATIVE_IS_UNIVERSAL.
+	const char* uni_c_str(size_t idx) const { return strings_.data() + offsets_[idx]; }
+
+	const_iterator begin() const { return { this, 0      }; }
+	const_iterator end  () const { return { this, size() }; }
 };
 
 } // namespace fs
+
+namespace std {
+	template<> struct hash<fs::path> {
+		size_t operator()(const fs::path& src) const { return src.hash(); }
+	};
+
+	template<> struct hash<fs::path_view> {
+		size_t operator()(fs::path_view src) const { return src.hash(); }
+	};
+}
@@ -0,0 +1,124 @@
+#pragma once
+
+#include "posix_file.h"
+
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+
+namespace fs {
+
+enum class io_op : uint8_t {
+	read,
+	write,
+};
+
+enum class io_backend : uint8_t {
+	io_uring,			// linux 5.6+, when not blocked by the sandbox/container
+	thread_pool,		// workers running posix_pread/posix_pwrite
+};
+
+struct io_request
+{
+	int			fd;
+	x_off_t		offset;
+	void*		buffer;
+	size_t		length;
+	io_op		op			= io_op::read;
+	uintptr_t	user_data	= 0;			// handed back with the completion
+};
+
+struct io_completion
+{
+	uintptr_t	user_data;
+	intmax_t	result;						// bytes transferred (possibly short), or -errno
+};
+
+struct io_engine_options
+{
+	unsigned	queue_depth		= 256;		// most requests queued and in flight at once
+	int			threads			= 0;		// thread_pool workers, 0 for a default suited to blocking I/O
+	bool		force_thread_pool	= false;
+};
+
+// --------------------------------------------------------------------------------------------------
+// io_engine
+//
+// Asynchronous positional reads and writes. Requests are queued, then issued together by submit():
+// with io_uring a whole batch costs a single syscall, and the kernel keeps as many reads in flight
+// as the device will take, instead of one posix_pread() at a time.
+//
+// Completions are collected either by polling into an array or through a callback, both on the
+// calling thread; in either case submit() is implied for anything still queued. Completion order is
+// unspecified. Buffers must stay valid until their request completes. Transfers may be short, as
+// with pread(): callers needing the full length re-queue the remainder.
+//
+// An engine is meant for a single owning thread; use one engine per loader thread.
+//
+//     fs::io_engine engine;
+//     for (auto& chunk : chunks) {
+//         while (!engine.queue({ fd, chunk.offset, chunk.dest, chunk.size, fs::io_op::read, uintptr_t(&chunk) })) {
+//             engine.drain(on_complete, 1);
+//         }
+//     }
+//     engine.drain(on_complete, engine.in_flight());
+//
+class io_engine
+{
+protected:
+	struct uring;
+	struct pool;
+
+	std::unique_ptr<uring>	uring_;
+	std::unique_ptr<pool>	pool_;
+	unsigned				depth_		= 0;
+	size_t					queued_		= 0;		// accepted by queue(), not yet submitted
+	size_t					in_flight_	= 0;		// submitted, not yet reaped
+
+public:
+	explicit io_engine(const io_engine_options& options = {});
+	~io_engine();
+
+	io_engine(const io_engine&) = delete;
+	io_engine& operator=(const io_engine&) = delete;
+
+	io_backend	backend		() const;
+
+	// false, without queueing anything, when queue_depth requests are already queued or in flight.
+	bool		queue		(const io_request& request);
+
+	// issues everything queued. Returns the number of requests issued.
+	size_t		submit		();
+
+	// copies up to max completions into dest, first waiting until at least min_complete are
+	// available (clamped to what's outstanding). Returns the number copied.
+	size_t		poll		(io_completion* dest, size_t max, size_t min_complete = 0);
+
+	// invokes func for every available completion, first waiting as for poll(). Accepts any callable
+	// taking const io_completion&, called directly rather than through a callback object.
+	template<typename Func>
+	size_t		drain		(Func&& func, size_t min_complete = 0);
+
+	size_t		queued		() const { return queued_; }
+	size_t		in_flight	() const { return in_flight_; }
+	size_t		outstanding	() const { return queued_ + in_flight_; }
+};
+
+template<typename Func>
+size_t io_engine::drain(Func&& func, size_t min_complete) {
+	io_completion batch[64];
+	size_t total = 0;
+	while (1) {
+		size_t want = (total < min_complete) ? min_complete - total : 0;
+		size_t got  = poll(batch, 64, want);
+		for (size_t i=0; i<got; ++i) {
+			func(batch[i]);
+		}
+		total += got;
+		if (got < 64 && total >= min_complete) break;
+		if (!got && !in_flight_) break;			// asked for more than was outstanding
+	}
+	return total;
+}
+
+} // namespace fs
@@ -0,0 +1,66 @@
+#pragma once
+
+#include "fs.h"
+
+#include <cstdint>
+
+namespace fs {
+
+// Ways a file's contents can be copied, in the order copy_file() tries them.
+enum class copy_method : uint8_t {
+	none,
+	reflink,				// FICLONE: the copy shares extents with the source, O(1) on btrfs/xfs
+	copy_file_range,		// in-kernel copy, offloaded server-side on NFS 4.2 and SMB3
+	sendfile,				// in-kernel copy, for kernels and filesystem pairs lacking the above
+	read_write,				// user-space buffer, works anywhere
+	platform,				// msw: CopyFileExW, which picks block cloning or server-side copy itself
+};
+
+const char* copy_method_name(copy_method method);
+
+struct copy_options
+{
+	bool			preserve_mode	= false;		// posix permission bits
+	bool			preserve_times	= false;		// modification (and access) time
+	bool			overwrite		= true;			// false to fail with EEXIST when the destination exists
+
+	// methods earlier in the chain than this are not attempted, eg. read_write to force a real copy.
+	copy_method		first_method	= copy_method::reflink;
+
+	int				threads			= 0;			// copy_tree workers, 0 for hardware_concurrency()
+};
+
+struct copy_result
+{
+	copy_method		method	= copy_method::none;	// what did the copy, none on failure
+	intmax_t		bytes	= 0;
+	int				error	= 0;					// errno (GetLastError() on msw) on failure
+
+	bool ok() const { return !error; }
+};
+
+struct copy_tree_stats
+{
+	intmax_t	files		= 0;
+	intmax_t	dirs		= 0;			// created in the destination, including its root
+	intmax_t	symlinks	= 0;
+	intmax_t	bytes		= 0;
+	intmax_t	errors		= 0;
+};
+
+// --------------------------------------------------------------------------------------------------
+// copy_file / copy_tree
+//
+// copy_file() copies without passing the data through user space whenever the kernel allows it,
+// falling back along the copy_method chain: a method that is unsupported for a given pair of files
+// (EXDEV, EOPNOTSUPP, ...) is abandoned for the next one, which carries on from where it stopped.
+//
+// copy_tree() copies the contents of src into dest (created as needed): the source is listed with a
+// parallel fs::walk, directories are created up front in one create_directories() batch, then files
+// are copied by a pool of workers. Symlinks are recreated as symlinks on posix and skipped on msw.
+// Copies continue past individual failures, which are counted in errors.
+//
+copy_result			copy_file	(const path& src, const path& dest, const copy_options& options = {});
+copy_tree_stats		copy_tree	(const path& src, const path& dest, const copy_options& options = {});
+
+} // namespace fs
@@ -0,0 +1,78 @@
+#pragma once
+
+#include "fs.h"
+#include "fs_snapshot.h"
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace fs {
+
+enum class change_type : uint8_t {
+	added,
+	removed,
+	modified,
+};
+
+const char* change_type_name(change_type type);
+
+struct diff_entry
+{
+	std::string		relative;				// universal path relative to the root
+	change_type		type;
+	CStatInfo		before;					// zeroed for added entries
+	CStatInfo		after;					// zeroed for removed entries
+};
+
+struct diff_options
+{
+	int			threads				= 0;		// 0 for hardware_concurrency()
+
+	// access times change whenever a file is read, so by default they're not a modification.
+	bool		compare_access_time	= false;
+
+	// should match the snapshot's filter, else everything it left out is reported added.
+	std::function<bool (std::string_view relative, bool is_directory)>	filter;
+};
+
+struct diff_result
+{
+	std::vector<diff_entry>	changes;			// in component_less() order of relative paths
+
+	intmax_t	checked		= 0;				// snapshot entries stat'd
+	intmax_t	dirs_listed	= 0;				// directories read to look for new entries
+	intmax_t	dirs_pruned	= 0;				// directories whose unchanged mtime spared the read
+	intmax_t	errors		= 0;				// entries or directories that couldn't be stat'd or read
+	int			error		= 0;				// errno (GetLastError() on msw) if root couldn't be read
+
+	bool ok() const { return !error; }
+};
+
+// --------------------------------------------------------------------------------------------------
+// diff
+//
+// Compares the tree at root against a snapshot of it. Every snapshot directory is a task for a pool
+// of workers, which stat its entries relative to the open directory (fstatat) and compare them to
+// the records: mode, size, modification and change times, and access time if asked.
+//
+// Entries can only appear or disappear by changing their directory's mtime, so a directory whose
+// mtime matches the snapshot isn't read at all: its known entries are stat'd and nothing else. The
+// mtime is only trusted if it's older than the snapshot (timestamps are in whole seconds, so a
+// directory changed in the second the snapshot was taken might look unchanged); for the same
+// reason a file whose recorded mtime isn't older than the snapshot is always reported modified.
+// Directories that are read report new entries as added, along with everything below new
+// subdirectories.
+//
+// Directories are reported modified only when their mode changes: entries added to or removed from
+// them are reported as such. A directory that was removed or replaced by a file is reported along
+// with each entry that was below it. Symlinks are compared as links, never followed.
+//
+diff_result			diff	(const snapshot& before, const path& root, const diff_options& options = {});
+inline diff_result	diff	(const snapshot& before, const diff_options& options = {}) {
+	return diff(before, path(path_view(before.root())), options);
+}
+
+} // namespace fs
@@ -0,0 +1,154 @@
+#pragma once
+
+#include "fs.h"
+
+#include <cstdint>
+#include <memory>
+#include <iterator>
+#include <string_view>
+#include <vector>
+
+namespace fs {
+
+enum class file_type : uint8_t {
+	unknown = 0,		// not reported by the filesystem, use directory_stream::status() to find out
+	regular,
+	directory,
+	symlink,
+	block,
+	character,
+	fifo,
+	socket,
+};
+
+// A single directory entry, as reported by the directory read itself (d_type on posix).
+struct dir_entry
+{
+	std::string_view	name;						// null-terminated, valid until the stream advances
+	file_type			type = file_type::unknown;
+
+	bool is_regular  () const { return type == file_type::regular;   }
+	bool is_directory() const { return type == file_type::directory; }
+	bool is_symlink  () const { return type == file_type::symlink;   }
+};
+
+// Orders universal paths such that '/' sorts before every other character, which places every
+// path's descendants immediately after it, eg. "a", "a/b", "a/c", "a-b" (plain byte order would put
+// "a-b" between "a" and "a/b"). The order of create_directories() work and of fs::snapshot entries.
+inline bool component_less(std::string_view a, std::string_view b) {
+	auto n = (a.length() < b.length()) ? a.length() : b.length();
+	for (size_t i=0; i<n; ++i) {
+		if (a[i] == b[i]) continue;
+		if (a[i] == '/') return true;
+		if (b[i] == '/') return false;
+		return uint8_t(a[i]) < uint8_t(b[i]);
+	}
+	return a.length() < b.length();
+}
+
+// --------------------------------------------------------------------------------------------------
+// directory_stream
+//
+// Lazy, allocation-light directory listing. Entries are read on demand in large batches straight
+// into a buffer owned by the stream (getdents64 on linux, readdir elsewhere on posix, and
+// FindFirstFileEx on msw) and yielded as name views, so there is no per-entry allocation and no
+// full path is built unless the caller builds one. "." and ".." are never reported.
+//
+//     for (const auto& entry : fs::directory_stream(dir)) {
+//         if (entry.is_directory()) ...
+//     }
+//
+// status() stats an entry relative to the open directory (fstatat), avoiding both a path join and
+// a full path lookup; on msw the data comes with the listing and costs nothing.
+//
+class directory_stream
+{
+protected:
+	struct platform_state;
+
+	std::unique_ptr<platform_state>	state_;
+	int								error_ = 0;
+
+public:
+	directory_stream();
+	explicit directory_stream(const path& dir);
+	~directory_stream();
+
+	directory_stream(directory_stream&& rvalue) noexcept;
+	directory_stream& operator=(directory_stream&& rvalue) noexcept;
+
+	bool	is_open		() const { return !!state_; }
+
+#if PLATFORM_POSIX
+	// takes ownership of an open directory fd, eg. one obtained by openat() relative to native_fd()
+	// of a parent stream, which skips resolving the full path again.
+	static directory_stream adopt_fd(int dirfd);
+
+	int		native_fd	() const;
+#endif
+
+	// errno (GetLastError() on msw) of a failed open or read, 0 otherwise.
+	int		error		() const { return error_; }
+
+	// advances to the next entry. Returns false at the end of the directory, or on error.
+	bool	next		(dir_entry& dest);
+
+	// stat of the stream's current entry, following symlinks (msw reports the link itself, as listed).
+	// Zeroed record if it can't be stat'd.
+	CStatInfo status	(const dir_entry& entry) const;
+
+	// single-pass input range over the remaining entries.
+	class iterator
+	{
+	protected:
+		directory_stream*	stream_ = nullptr;
+		dir_entry			entry_;
+
+	public:
+		using iterator_category	= std::input_iterator_tag;
+		using value_type		= dir_entry;
+		using difference_type	= std::ptrdiff_t;
+		using pointer			= const dir_entry*;
+		using reference			= const dir_entry&;
+
+		iterator() = default;
+		iterator(directory_stream* stream) : stream_(stream) { ++*this; }
+
+		const dir_entry& operator* () const { return  entry_; }
+		const dir_entry* operator->() const { return &entry_; }
+
+		iterator& operator++() {
+			if (stream_ && !stream_->next(entry_)) {
+				stream_ = nullptr;
+			}
+			return *this;
+		}
+
+		bool operator==(const iterator& s) const { return stream_ == s.stream_; }
+		bool operator!=(const iterator& s) const { return stream_ != s.stream_; }
+	};
+
+	iterator begin() { return iterator(this); }
+	iterator end  () { return iterator(); }
+};
+
+// --------------------------------------------------------------------------------------------------
+// create_directories (batch)
+//
+// Creates every directory in the batch along with any missing parents, for exporters producing
+// thousands of output directories at once. Paths are visited in component order with duplicates
+// skipped, and the chain of directories confirmed so far is remembered: a parent shared by many
+// paths is confirmed once per batch rather than once per path. On posix each directory is created
+// with mkdirat() relative to an open fd of its parent, so no full path is ever resolved twice.
+//
+// results, if given, is resized to count and receives 0 or an errno (GetLastError() on msw) per
+// path, index-aligned with the input; a file in the way fails with ENOTDIR (ERROR_DIRECTORY on msw).
+// Nothing throws. Returns the number of paths that failed.
+//
+int			create_directories	(const path* paths, size_t count, std::vector<int>* results = nullptr);
+int			create_directories	(const path_list& paths, std::vector<int>* results = nullptr);
+inline int	create_directories	(const std::vector<path>& paths, std::vector<int>* results = nullptr) {
+	return create_directories(paths.data(), paths.size(), results);
+}
+
+} // namespace fs
@@ -0,0 +1,142 @@
+#pragma once
+
+#include "fs.h"
+
+#include <cstdint>
+#include <cstddef>
+
+namespace fs {
+
+// O_DIRECT requires buffers, file offsets and transfer sizes aligned to the device's logical block
+// size. 4096 satisfies every device in use, including 512-byte sector ones.
+static const size_t direct_io_alignment = 4096;
+
+// --------------------------------------------------------------------------------------------------
+// aligned_buffer
+//
+// Heap buffer with a guaranteed alignment, as needed for O_DIRECT transfers (and handy for SIMD).
+//
+class aligned_buffer
+{
+protected:
+	uint8_t*	data_	= nullptr;
+	size_t		size_	= 0;
+
+public:
+	aligned_buffer() = default;
+	aligned_buffer(size_t size, size_t alignment = direct_io_alignment);
+	~aligned_buffer();
+
+	aligned_buffer(aligned_buffer&& rvalue) noexcept;
+	aligned_buffer& operator=(aligned_buffer&& rvalue) noexcept;
+
+	aligned_buffer(const aligned_buffer&) = delete;
+	aligned_buffer& operator=(const aligned_buffer&) = delete;
+
+	uint8_t*	data	() const { return data_; }
+	size_t		size	() const { return size_; }
+	bool		empty	() const { return !size_; }
+};
+
+struct file_io_options
+{
+	size_t		buffer_size	= 1024 * 1024;		// rounded up to direct_io_alignment
+
+	// bypass the page cache: for streaming huge files once without evicting everything else. Falls
+	// back to buffered I/O silently where the filesystem refuses it (tmpfs), or doesn't exist (msw).
+	bool		direct		= false;
+};
+
+// --------------------------------------------------------------------------------------------------
+// file_reader
+//
+// Buffered sequential reader over posix_pread, for use where FILE* or std::ifstream would be. Reads
+// larger than the buffer go straight to the caller's memory when not in direct mode. read() only
+// comes up short at end of file or on error; error() tells which.
+//
+class file_reader
+{
+protected:
+	int				fd_			= -1;
+	int				error_		= 0;
+	bool			direct_		= false;
+	x_off_t			size_		= 0;
+
+	aligned_buffer	buf_;
+	x_off_t			buf_off_	= 0;			// file offset of buf_[0]
+	size_t			buf_pos_	= 0;			// read cursor within buf_
+	size_t			buf_len_	= 0;			// valid bytes in buf_
+
+public:
+	file_reader() = default;
+	explicit file_reader(const path& file, const file_io_options& options = {});
+	~file_reader();
+
+	file_reader(const file_reader&) = delete;
+	file_reader& operator=(const file_reader&) = delete;
+
+	bool		open		(const path& file, const file_io_options& options = {});
+	void		close		();
+
+	size_t		read		(void* dest, size_t length);
+	bool		seek		(x_off_t pos);
+
+	x_off_t		tell		() const { return buf_off_ + x_off_t(buf_pos_); }
+	x_off_t		size		() const { return size_; }				// as of open()
+	bool		eof			() const { return tell() >= size_; }
+
+	bool		is_open		() const { return fd_ >= 0; }
+	bool		is_direct	() const { return direct_; }
+	int			error		() const { return error_; }				// errno of the last failure
+
+protected:
+	size_t		pread_full	(void* dest, size_t length, x_off_t pos);
+	bool		refill		();
+};
+
+// --------------------------------------------------------------------------------------------------
+// file_writer
+//
+// Buffered sequential writer over posix_write. The file is created or truncated. Short writes are
+// resumed, and any failure is sticky: further writes are refused and close() returns false, so a
+// caller may check once at the end.
+//
+// In direct mode only whole aligned blocks go out until close(), which writes the unaligned tail
+// after dropping O_DIRECT from the descriptor.
+//
+class file_writer
+{
+protected:
+	int				fd_			= -1;
+	int				error_		= 0;
+	bool			direct_		= false;
+	x_off_t			written_	= 0;			// bytes handed to the OS
+
+	aligned_buffer	buf_;
+	size_t			buf_len_	= 0;
+
+public:
+	file_writer() = default;
+	explicit file_writer(const path& file, const file_io_options& options = {});
+	~file_writer();
+
+	file_writer(const file_writer&) = delete;
+	file_writer& operator=(const file_writer&) = delete;
+
+	bool		open		(const path& file, const file_io_options& options = {});
+	bool		close		();
+
+	bool		write		(const void* src, size_t length);
+	bool		flush		();
+
+	x_off_t		tell		() const { return written_ + x_off_t(buf_len_); }
+
+	bool		is_open		() const { return fd_ >= 0; }
+	bool		is_direct	() const { return direct_; }
+	int			error		() const { return error_; }
+
+protected:
+	bool		write_full	(const void* src, size_t length);
+};
+
+} // namespace fs
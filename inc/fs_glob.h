@@ -0,0 +1,99 @@
+#pragma once
+
+#include "fs.h"
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace fs {
+
+enum class glob_case : uint8_t {
+	sensitive,
+	insensitive,		// ascii case folding, consistent with path::operator==
+};
+
+// --------------------------------------------------------------------------------------------------
+// glob_pattern
+//
+// Glob compiled once into a matcher for universal path strings. Syntax:
+//
+//     *        any run of characters within a single component (never matches '/')
+//     ?        any single character except '/'
+//     [abc]    one of a set; ranges such as [a-z] and negation [!abc] are supported
+//     **       as a whole component, zero or more components: "**/*.cfg" matches "x.cfg" and "a/b/x.cfg"
+//
+// An unterminated '[' is taken literally. Patterns and paths are matched whole, component for
+// component, so a relative pattern is meant to be matched against a path relative to the same base
+// (see walk_entry::relative).
+//
+// literal_prefix() is the leading run of wildcard-free components, and may_contain() tells whether
+// anything below a given directory could match; a walker uses the latter to prune subtrees:
+//
+//     fs::glob_pattern glob("assets/*/tex_??.png");
+//     options.descend = [&](const fs::walk_entry& entry) { return glob.may_contain(entry.relative); };
+//
+class glob_pattern
+{
+protected:
+	enum class op_kind : uint8_t {
+		literal,
+		any_char,
+		star,
+		char_class,
+	};
+
+	struct op {
+		op_kind		kind;
+		uint8_t		ch;				// literal (case-folded when insensitive)
+		uint16_t	class_idx;		// into classes_
+	};
+
+	struct segment {
+		uint32_t	first;			// into ops_
+		uint32_t	count;
+		uint16_t	min_len;		// shortest component that could match (ops other than star)
+		uint16_t	suffix_len;		// trailing literal ops, checked first as a cheap reject
+		bool		globstar;
+		bool		fixed_tail;		// no globstar from here to the end of the pattern
+	};
+
+	struct char_set {
+		uint64_t	bits[4];
+
+		bool test(uint8_t c) const { return (bits[c >> 6] >> (c & 63)) & 1; }
+		void set (uint8_t c)       { bits[c >> 6] |= uint64_t(1) << (c & 63); }
+	};
+
+	std::string				pattern_;
+	std::string				literal_prefix_;
+	std::vector<op>			ops_;
+	std::vector<segment>	segments_;
+	std::vector<char_set>	classes_;
+	glob_case				case_		= glob_case::sensitive;
+
+public:
+	glob_pattern() = default;
+	explicit glob_pattern(std::string_view pattern, glob_case cs = glob_case::sensitive) {
+		compile(pattern, cs);
+	}
+
+	void				compile			(std::string_view pattern, glob_case cs = glob_case::sensitive);
+
+	bool				match			(path_view uni_path) const;
+
+	// false if no path below the directory dir can match, true if something might.
+	bool				may_contain		(std::string_view dir) const;
+
+	std::string_view	literal_prefix	() const { return literal_prefix_; }
+	const std::string&	pattern			() const { return pattern_; }
+	bool				empty			() const { return segments_.empty(); }
+
+protected:
+	bool				match_segment	(const segment& seg, std::string_view comp) const;
+	bool				match_from		(size_t seg_idx, std::string_view path, size_t pos) const;
+	uint8_t				fold			(uint8_t c) const;
+};
+
+} // namespace fs
@@ -0,0 +1,100 @@
+#pragma once
+
+#include "fs.h"
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+namespace fs {
+
+enum class hash_algorithm : uint8_t {
+	xxh3,			// XXH3_64bits, seed 0: matches xxhsum -H3 / XXH3_64bits() output
+	crc32c,			// Castagnoli CRC, as used by iSCSI, ext4 and SSE4.2 (value in the low 32 bits)
+};
+
+const char* hash_algorithm_name(hash_algorithm algorithm);
+
+// --------------------------------------------------------------------------------------------------
+// hasher
+//
+// Incremental hash over any number of update() calls. The digest of a sequence of updates equals
+// the one-shot digest of their concatenation. xxh3 accumulates with sse2 or avx2 according to
+// fs::simd::ActiveIsa(); crc32c uses the SSE4.2 crc32 instruction where the CPU has it.
+//
+class hasher
+{
+protected:
+	hash_algorithm	algorithm_;
+	uint32_t		crc_				= 0;
+
+	// xxh3 streaming state: input is consumed a 256-byte buffer at a time, keeping the last bytes
+	// buffered until digest(), which needs the final (possibly overlapping) 64-byte stripe.
+	alignas(64) uint64_t	acc_[8];
+	alignas(64) uint8_t		buffer_[256];
+	size_t			buffered_			= 0;
+	size_t			stripes_in_block_	= 0;
+	uint64_t		total_				= 0;
+
+public:
+	explicit hasher(hash_algorithm algorithm = hash_algorithm::xxh3);
+
+	void		reset		();
+	void		update		(const void* data, size_t length);
+	uint64_t	digest		() const;			// doesn't alter the state: updates may continue
+
+	hash_algorithm algorithm() const { return algorithm_; }
+
+	static uint64_t hash	(hash_algorithm algorithm, const void* data, size_t length);
+};
+
+// A file's content hash. Digests of the same algorithm and mode compare equal when the contents
+// (and for partial digests, the sizes) do.
+struct file_digest
+{
+	uint64_t		value		= 0;
+	intmax_t		size		= 0;						// bytes in the file when hashed
+	hash_algorithm	algorithm	= hash_algorithm::xxh3;
+	bool			partial		= false;
+	int				error		= 0;						// errno (GetLastError() on msw) on failure
+
+	bool ok() const { return !error; }
+
+	bool operator==(const file_digest& r) const {
+		return ok() && r.ok() && value == r.value && size == r.size && algorithm == r.algorithm && partial == r.partial;
+	}
+	bool operator!=(const file_digest& r) const { return !(*this == r); }
+};
+
+struct hash_options
+{
+	hash_algorithm	algorithm		= hash_algorithm::xxh3;
+
+	// nonzero for a quick first-pass digest over just the first and last partial_bytes of the file
+	// plus its size. Files no larger than twice this are hashed whole (still flagged partial).
+	size_t			partial_bytes	= 0;
+
+	// files at least this large are hashed through a memory map (windowed, so address space use
+	// stays bounded); smaller ones with pread into a per-worker buffer of read_block bytes.
+	intmax_t		mmap_threshold	= 4 * 1024 * 1024;
+	size_t			read_block		= 1024 * 1024;
+
+	int				threads			= 0;					// hash_files workers, 0 for hardware_concurrency()
+};
+
+// --------------------------------------------------------------------------------------------------
+// hash_file / hash_files
+//
+// Content hashes for deciding whether a file changed when CStatInfo can't be trusted (mtimes kept
+// by copies and archive extraction, coarse timestamps). A full digest equals hasher::hash() of the
+// whole content. hash_files() hashes a batch on a pool of workers, returning digests index-aligned
+// with the input; failures are reported per file in file_digest::error.
+//
+file_digest					hash_file	(const path& file, const hash_options& options = {});
+std::vector<file_digest>	hash_files	(const path* files, size_t count, const hash_options& options = {});
+std::vector<file_digest>	hash_files	(const path_list& files, const hash_options& options = {});
+inline std::vector<file_digest> hash_files(const std::vector<path>& files, const hash_options& options = {}) {
+	return hash_files(files.data(), files.size(), options);
+}
+
+} // namespace fs
@@ -0,0 +1,126 @@
+#pragma once
+
+#include "fs.h"
+
+#include <cstdint>
+#include <string_view>
+
+namespace fs {
+
+enum class map_mode : uint8_t {
+	read_only,
+	read_write,			// writes through to the file; the file is never resized by mapping it
+};
+
+enum class map_advice : uint8_t {
+	normal,
+	sequential,			// read ahead aggressively, pages behind may be dropped early
+	random,				// no read-ahead
+	willneed,			// start paging the range in now
+};
+
+// Non-owning view of mapped bytes, valid until the window is remapped or the file closed.
+struct byte_span
+{
+	uint8_t*	data	= nullptr;
+	size_t		size	= 0;
+
+	uint8_t*	begin		() const { return data; }
+	uint8_t*	end			() const { return data + size; }
+	bool		empty		() const { return !size; }
+	uint8_t&	operator[]	(size_t idx) const { return data[idx]; }
+
+	byte_span subspan(size_t offset, size_t length = SIZE_MAX) const {
+		offset = (offset < size) ? offset : size;
+		return { data + offset, (length < size - offset) ? length : size - offset };
+	}
+
+	std::string_view view() const { return { (const char*)data, size }; }
+};
+
+// --------------------------------------------------------------------------------------------------
+// mapped_file
+//
+// RAII memory mapping of a file, as an alternative to posix_pread() into user buffers. At most one
+// window of the file is mapped at a time: the constructor maps the whole file, while map() maps any
+// byte range, so files larger than the address space (or than a caller's budget for it) can be
+// processed one window at a time:
+//
+//     fs::mapped_file file;
+//     file.open(src);
+//     for (x_off_t pos = 0; pos < file.file_size(); pos += window) {
+//         file.map(pos, window);
+//         file.advise(fs::map_advice::sequential);
+//         consume(file.span());
+//     }
+//
+// Window offsets need not be aligned: the mapping is aligned down to granularity() internally and
+// span() starts at the requested offset. Errors are reported through is_open()/is_mapped() and
+// error(), which holds errno (GetLastError() on msw) of the last failure.
+//
+class mapped_file
+{
+public:
+	static const size_t whole_file = SIZE_MAX;
+
+protected:
+#if PLATFORM_MSW
+	void*		file_		= nullptr;		// HANDLE, nullptr when closed
+	void*		mapping_	= nullptr;		// HANDLE of the file mapping object, created on first map()
+#else
+	int			fd_			= -1;
+#endif
+	map_mode	mode_		= map_mode::read_only;
+	int			error_		= 0;
+	x_off_t		file_size_	= 0;
+
+	uint8_t*	base_		= nullptr;		// start of the mapping, aligned down to granularity()
+	size_t		base_len_	= 0;
+	x_off_t		offset_		= 0;			// file offset of span()
+	size_t		length_		= 0;
+	bool		mapped_		= false;		// also true for an empty window, which has no base_
+
+public:
+	mapped_file() = default;
+	explicit mapped_file(const path& file, map_mode mode = map_mode::read_only);
+	~mapped_file();
+
+	mapped_file(mapped_file&& rvalue) noexcept;
+	mapped_file& operator=(mapped_file&& rvalue) noexcept;
+
+	mapped_file(const mapped_file&) = delete;
+	mapped_file& operator=(const mapped_file&) = delete;
+
+	// opens without mapping anything. The file must exist.
+	bool		open		(const path& file, map_mode mode = map_mode::read_only);
+	void		close		();
+
+	// maps [offset, offset+length) clamped to the end of the file, replacing the current window.
+	// Mapping an empty range succeeds with an empty span.
+	bool		map			(x_off_t offset = 0, size_t length = whole_file);
+	void		unmap		();
+
+	// hints for the paging behavior of the mapped window, or a range within it. Advice that the
+	// platform doesn't support is ignored and reported as success.
+	bool		advise		(map_advice advice) const { return advise(advice, 0, length_); }
+	bool		advise		(map_advice advice, size_t offset, size_t length) const;
+
+	// writes modified pages of a read_write window back to the file.
+	bool		flush		(bool wait = true);
+
+	bool		is_open		() const;
+	bool		is_mapped	() const { return mapped_; }
+	int			error		() const { return error_; }
+	map_mode	mode		() const { return mode_; }
+	x_off_t		file_size	() const { return file_size_; }
+
+	x_off_t		offset		() const { return offset_; }
+	size_t		size		() const { return length_; }
+	uint8_t*	data		() const { return base_ ? base_ + (base_len_ - length_) : nullptr; }
+	byte_span	span		() const { return { data(), length_ }; }
+
+	// alignment of mapping offsets: the page size, or the allocation granularity on msw.
+	static size_t granularity();
+};
+
+} // namespace fs
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "posix_file.h"
+
+#include <cstdint>
+#include <cstddef>
+
+namespace fs {
+
+// One slice requested from read_ranges(). result is filled in: the number of bytes delivered into
+// dest (short only at end of file), or -errno if the read covering the slice failed.
+struct read_range
+{
+	x_off_t		offset;
+	size_t		length;
+	void*		dest;
+	intmax_t	result		= 0;
+};
+
+struct read_batch_options
+{
+	// neighbors separated by up to this many bytes are read with one syscall; the gap is read into
+	// scratch space and discarded. Reading a gap is far cheaper than another syscall, up to a point.
+	size_t		max_gap		= 16 * 1024;
+
+	// upper bound of the bytes (slices and gaps) covered by one syscall.
+	size_t		max_span	= 8 * 1024 * 1024;
+};
+
+struct read_batch_stats
+{
+	intmax_t	syscalls	= 0;
+	intmax_t	runs		= 0;			// merged groups of ranges, each issued as one read
+	intmax_t	gap_bytes	= 0;			// read only to bridge gaps between ranges
+};
+
+// --------------------------------------------------------------------------------------------------
+// read_ranges
+//
+// Reads many ranges of one file. Ranges are sorted by offset, and neighbors within max_gap of each
+// other are merged into runs; each run is a single preadv() whose scatter list points straight at
+// the callers' buffers, so nothing is copied. On msw, which has no preadv, a run is read into a
+// scratch buffer with posix_pread() and sliced from there.
+//
+// Ranges may be given in any order and may overlap; overlapping ranges are never merged into the
+// same run since a scatter list can't deliver the same bytes twice.
+//
+read_batch_stats	read_ranges		(int fd, read_range* ranges, size_t count, const read_batch_options& options = {});
+
+} // namespace fs
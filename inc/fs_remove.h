@@ -0,0 +1,51 @@
+#pragma once
+
+#include "fs.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace fs {
+
+struct remove_options
+{
+	int			threads			= 0;			// 0 for hardware_concurrency()
+	bool		dry_run			= false;		// list and count what would be removed, removing nothing
+	bool		count_bytes		= true;			// sizes of removed files; costs a stat per file on posix
+	size_t		max_failures	= 64;			// failures kept in remove_stats::failures, all are counted
+};
+
+struct remove_failure
+{
+	std::string		path;						// universal path
+	int				error;						// errno (GetLastError() on msw)
+};
+
+struct remove_stats
+{
+	intmax_t	files		= 0;				// everything that isn't a directory, symlinks included
+	intmax_t	dirs		= 0;				// including the root
+	intmax_t	bytes		= 0;				// sizes of removed regular files
+	intmax_t	errors		= 0;
+
+	std::vector<remove_failure>	failures;		// the first max_failures errors, in no particular order
+};
+
+// --------------------------------------------------------------------------------------------------
+// remove_all
+//
+// Removes root and everything below it, bottom-up and in parallel. Each directory is a task for a
+// pool of work-stealing workers (as fs::walk): its entries are unlinked relative to its open fd as
+// they're listed (unlinkat, so no path is resolved per file) and its subdirectories queued. A
+// directory is removed by whichever worker finishes its last subdirectory. Only the root is opened
+// by path: every directory below it is reached from its parent's fd, so a component swapped for a
+// symlink mid-removal can't redirect it.
+//
+// Symlinks are removed, never followed. Failures don't stop the removal: they are counted and
+// reported, and only the ancestors of a failed entry are left in place, without further errors.
+// A root that doesn't exist is not an error; one that can't be stat'd for any other reason is. A root that isn't a directory is removed as a file.
+//
+remove_stats	remove_all	(const path& root, const remove_options& options = {});
+
+} // namespace fs
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+// --------------------------------------------------------------------------------------------------
+// fs::simd - vectorized kernels for path separator translation
+//
+// Used internally by ConvertFromMsw() and ConvertToMsw(). The best instruction set supported by the
+// host CPU is selected on first use; every kernel produces output byte-identical to the scalar one.
+// ForceIsa() exists for the sake of validation and benchmarking.
+//
+
+#if !defined(FS_SIMD_X86)
+#	if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#		define FS_SIMD_X86		1
+#	else
+#		define FS_SIMD_X86		0
+#	endif
+#endif
+
+// aarch64 only: 32-bit ARM NEON lacks the across-vector ops (vmaxvq_u8) the kernels use.
+#if !defined(FS_SIMD_NEON)
+#	if defined(__aarch64__) || defined(_M_ARM64)
+#		define FS_SIMD_NEON		1
+#	else
+#		define FS_SIMD_NEON		0
+#	endif
+#endif
+
+// GCC and clang refuse to emit instructions beyond the TU's target (-mavx2 etc.) unless the function
+// using them is tagged. MSVC emits whatever intrinsics it is given.
+// SSE2 is the x86-64 baseline but not the 32-bit x86 one.
+#if FS_SIMD_X86 && !defined(_MSC_VER)
+#	define FS_TARGET_SSE2		__attribute__((target("sse2")))
+#	define FS_TARGET_AVX2		__attribute__((target("avx2")))
+#	define FS_TARGET_SSE42		__attribute__((target("sse4.2")))
+#else
+#	define FS_TARGET_SSE2
+#	define FS_TARGET_AVX2
+#	define FS_TARGET_SSE42
+#endif
+
+namespace fs {
+namespace simd {
+
+enum class isa {
+	scalar,
+	sse2,
+	avx2,
+	neon,
+};
+
+// copies len bytes from src to dst, replacing every occurrence of 'from' with 'to'.
+// dst and src may be the same pointer but must not otherwise overlap.
+void		TranslateChar	(char* dst, const char* src, size_t len, char from, char to);
+
+// returns the offset of the first '/' or '\\' in src, or len if there is none.
+size_t		FindPathSep		(const char* src, size_t len);
+
+isa			ActiveIsa		();
+const char*	IsaName			(isa which);
+bool		IsaSupported	(isa which);
+bool		ForceIsa		(isa which);		// returns false (and changes nothing) if unsupported
+
+} // namespace simd
+} // namespace fs
@@ -0,0 +1,164 @@
+#pragma once
+
+#include "fs.h"
+#include "fs_mapped_file.h"
+
+#include <cstdint>
+#include <ctime>
+#include <functional>
+#include <string_view>
+
+namespace fs {
+
+// --------------------------------------------------------------------------------------------------
+// Snapshot file layout
+//
+// Little-endian, native struct layout, no pointers, so a loaded file is used in place:
+//
+//     snapshot_header
+//     snapshot_record[count]		at records_offset (64-byte aligned)
+//     strings						at strings_offset: the root, then each relative path, all
+//									null-terminated
+//
+// Records are in component_less() order of their relative paths, record 0 being the root itself
+// (relative path ""). Every directory's subtree is therefore a contiguous run of records, which
+// subtree_end bounds.
+//
+static const uint32_t snapshot_version = 1;
+
+struct snapshot_header
+{
+	char		magic[8];				// "ICYSNAP\0"
+	uint32_t	version;				// snapshot_version
+	uint32_t	byte_order;				// 0x01020304 as written, catches a big-endian reader
+	uint32_t	header_size;			// sizeof(snapshot_header)
+	uint32_t	record_size;			// sizeof(snapshot_record)
+	uint64_t	count;					// records, including the root
+	uint64_t	records_offset;
+	uint64_t	strings_offset;
+	uint64_t	strings_size;
+	uint64_t	root_length;			// universal root path, at strings_offset
+	int64_t		created;				// time_t at the start of the walk
+	uint64_t	checksum;				// XXH3 of records and strings
+	uint64_t	file_size;
+};
+
+struct snapshot_record
+{
+	uint32_t	path_offset;			// relative path, from strings_offset
+	uint32_t	path_length;
+	uint32_t	subtree_end;			// index past the last descendant (own index + 1 if none)
+	uint32_t	mode;					// CStatInfo fields, of the entry itself (lstat)
+	int64_t		size;
+	int64_t		time_accessed;
+	int64_t		time_modified;
+	int64_t		time_created;
+};
+
+// A record as seen through snapshot::operator[]. relative views the mapping, valid until the
+// snapshot is closed.
+struct snapshot_entry
+{
+	std::string_view	relative;		// "" for the root
+	CStatInfo			info;
+	size_t				index;
+	size_t				subtree_end;
+
+	bool is_directory() const { return info.IsDir(); }
+};
+
+struct snapshot_options
+{
+	int			threads		= 0;			// walk workers, 0 for hardware_concurrency()
+
+	// return false to leave an entry out. A rejected directory is left out along with everything
+	// below it. Called concurrently from the walk's workers.
+	std::function<bool (std::string_view relative, bool is_directory)>	filter;
+};
+
+struct snapshot_result
+{
+	size_t		entries		= 0;			// records written, including the root
+	intmax_t	errors		= 0;			// directories or entries that couldn't be read or stat'd
+	int			error		= 0;			// errno (GetLastError() on msw) if no snapshot was written
+
+	bool ok() const { return !error; }
+};
+
+// --------------------------------------------------------------------------------------------------
+// write_snapshot
+//
+// Walks root in parallel (fs::walk), lstat's every entry, and writes the tree to file. The file is
+// written under a temporary name next to it, flushed to disk and renamed over the destination, so
+// readers see either the previous snapshot or the complete new one, never a partial write. (On msw
+// the rename fails while the previous snapshot is open.)
+// Entries that vanish during the walk are left out silently; those that can't be stat'd are
+// counted in errors and left out. Symlinks are recorded as such and never followed.
+//
+snapshot_result		write_snapshot	(const path& root, const path& file, const snapshot_options& options = {});
+
+// --------------------------------------------------------------------------------------------------
+// snapshot
+//
+// A snapshot file loaded with a single read-only mapping. open() checks the header and that the
+// sections it describes fit the file, and nothing else: records and strings are used in place, so
+// loading costs the same for ten entries or ten million. Pass verify to also check the checksum,
+// which reads the whole file.
+//
+// Records are bounds-checked as they're read, so a corrupt file opened without verify can give
+// wrong results but never reads outside the mapping: a path outside the strings reads as "", and
+// subtree_end is clamped to (index, size()]. Check the checksum of files that may be corrupt.
+//
+//     fs::snapshot snap(file);
+//     for (size_t i=0; i<snap.size(); ++i) {
+//         auto entry = snap[i];
+//         ...
+//     }
+//
+// A file that isn't a snapshot, or was written by another version, fails with EINVAL; a checksum
+// mismatch fails with EILSEQ. Other errors are as reported by the mapping.
+//
+class snapshot
+{
+public:
+	static const size_t npos = SIZE_MAX;
+
+protected:
+	mapped_file				file_;
+	const snapshot_header*	header_		= nullptr;
+	const snapshot_record*	records_	= nullptr;
+	const char*				strings_	= nullptr;
+	int						error_		= 0;
+
+public:
+	snapshot() = default;
+	explicit snapshot(const path& file, bool verify = false);
+
+	snapshot(snapshot&& rvalue) noexcept;
+	snapshot& operator=(snapshot&& rvalue) noexcept;
+
+	snapshot(const snapshot&) = delete;
+	snapshot& operator=(const snapshot&) = delete;
+
+	bool	open		(const path& file, bool verify = false);
+	void	close		();
+
+	bool	is_open		() const { return !!header_; }
+	int		error		() const { return error_; }
+
+	size_t				size		() const { return header_ ? size_t(header_->count) : 0; }
+	bool				empty		() const { return !size(); }
+	std::string_view	root		() const;				// universal path, as given to write_snapshot()
+	time_t				created		() const { return header_ ? time_t(header_->created) : 0; }
+
+	// the record as stored; relative() and subtree_end() are the checked views of its fields.
+	const snapshot_record&	record		(size_t idx) const { return records_[idx]; }
+	std::string_view		relative	(size_t idx) const;
+	size_t					subtree_end	(size_t idx) const;
+	snapshot_entry			operator[]	(size_t idx) const;
+
+	// index of the record for a relative path (binary search), or npos.
+	size_t	find		(std::string_view relative) const;
+};
+
+} // namespace fs
@@ -0,0 +1,70 @@
+#pragma once
+
+#include "fs.h"
+
+#include <cstdint>
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace fs {
+
+// --------------------------------------------------------------------------------------------------
+// stat_cache
+//
+// Opt-in memoization of fs::status(), for tools that probe the same files over and over (build
+// steps, asset dependency checks). Entries are keyed on the exact universal path, so paths that
+// differ only in case never share an entry, even though fs::path compares them equal.
+//
+// invalidate() bumps the cache generation, retiring every entry in O(1); entries from an older
+// generation are re-stat'd on next lookup. invalidate(path) drops a single entry, for callers who
+// know what changed. All methods are thread-safe. Lookups are spread across shards, each with its
+// own lock, so parallel probes don't serialize on a single mutex.
+//
+class stat_cache
+{
+protected:
+	struct entry {
+		CStatInfo	info;
+		uint64_t	generation;
+	};
+
+	struct shard {
+		std::mutex								mutex;
+		std::unordered_map<std::string, entry>	entries;
+		uint64_t								erasures = 0;	// bumped by invalidate(path)
+	};
+
+	static const int shard_count = 16;
+
+	shard					shards_[shard_count];
+	std::atomic<uint64_t>	generation_	= { 1 };
+	std::atomic<intmax_t>	hits_		= { 0 };
+	std::atomic<intmax_t>	misses_		= { 0 };
+
+	shard& shard_for(const path& fspath) {
+		return shards_[fspath.hash() % shard_count];
+	}
+
+public:
+	CStatInfo	status			(const path& fspath);
+
+	bool		exists			(const path& fspath) { return status(fspath).Exists(); }
+	bool		is_directory	(const path& fspath) { return status(fspath).IsDir (); }
+	intmax_t	file_size		(const path& fspath) {
+		auto st = status(fspath);
+		return st.IsFile() ? st.st_size : 0;
+	}
+
+	void		invalidate		();
+	void		invalidate		(const path& fspath);
+	void		clear			();
+
+	size_t		size			();
+	uint64_t	generation		() const { return generation_.load(std::memory_order_relaxed); }
+	intmax_t	hits			() const { return hits_  .load(std::memory_order_relaxed); }
+	intmax_t	misses			() const { return misses_.load(std::memory_order_relaxed); }
+};
+
+} // namespace fs
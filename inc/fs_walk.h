@@ -0,0 +1,66 @@
+#pragma once
+
+#include "fs.h"
+#include "fs_directory.h"
+
+#include <cstdint>
+#include <functional>
+
+namespace fs {
+
+enum class symlink_policy : uint8_t {
+	no_follow,		// symlinks are reported as such but never descended into (default)
+	follow,			// symlinks to directories are descended into. On posix each directory is visited
+					// once, so cycles are harmless; on msw only max_depth bounds them.
+};
+
+// An entry reported by walk(). Views are valid only for the duration of the callback.
+struct walk_entry
+{
+	path_view			path;			// universal path, root joined with the relative path
+	std::string_view	relative;		// path relative to the root, eg. for matching a glob_pattern
+	std::string_view	name;			// final component of path
+	file_type			type;			// as listed: a symlink is reported as symlink under either policy
+	int					depth;			// 1 for immediate children of the root
+
+	bool is_regular  () const { return type == file_type::regular;   }
+	bool is_directory() const { return type == file_type::directory; }
+	bool is_symlink  () const { return type == file_type::symlink;   }
+};
+
+struct walk_options
+{
+	int				max_depth	= -1;						// deepest entries to report, -1 for unlimited
+	int				threads		= 0;						// 0 for hardware_concurrency()
+	symlink_policy	symlinks	= symlink_policy::no_follow;
+
+	// return false to skip reporting an entry. Rejecting a directory does not prevent descent.
+	std::function<bool (const walk_entry& entry)>	filter;
+
+	// return false to prune a directory: it is still reported, but not descended into.
+	std::function<bool (const walk_entry& entry)>	descend;
+};
+
+struct walk_stats
+{
+	intmax_t	dirs	= 0;			// directories listed, including the root
+	intmax_t	entries	= 0;			// entries reported to the visitor
+	intmax_t	errors	= 0;			// directories that couldn't be opened or read
+};
+
+// --------------------------------------------------------------------------------------------------
+// walk
+//
+// Parallel recursive directory walk. Each directory is a task: workers pop their own tasks newest
+// first (depth-first, good locality) and steal the oldest tasks of other workers when idle, which
+// hands big unexplored subtrees to idle threads. On posix, subdirectories are opened with openat()
+// relative to the fd of the directory being listed, so full paths are never resolved again.
+//
+// The visitor and filters are called concurrently from all worker threads and must be thread-safe.
+// Report order is unspecified. The path_list overload collects into per-worker lists, merged at
+// the end, so no lock is taken per entry.
+//
+walk_stats	walk	(const path& root, const std::function<void (const walk_entry& entry)>& visitor, const walk_options& options = {});
+walk_stats	walk	(const path& root, path_list& dest, const walk_options& options = {});
+
+} // namespace fs
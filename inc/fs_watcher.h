@@ -0,0 +1,90 @@
+#pragma once
+
+#include "fs.h"
+#include "ConfigFileParser.h"
+
+#include <cstdint>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace fs {
+
+class stat_cache;
+
+enum class change_kind : uint8_t {
+	created,
+	modified,
+	removed,
+};
+
+struct file_change
+{
+	fs::path		path;
+	change_kind		kind;
+};
+
+// Changes observed during one burst of activity, coalesced per path: a file created and then
+// modified is reported once as created, a file created and removed again is not reported at all.
+struct change_set
+{
+	std::vector<file_change>	changes;
+	bool						overflowed = false;		// events were lost, rescan anything of interest
+};
+
+struct watcher_options
+{
+	// a batch is delivered once no event has arrived for this long...
+	std::chrono::milliseconds	debounce	= std::chrono::milliseconds(100);
+
+	// ...or once its oldest event is this old, so that constant churn can't hold a batch back forever.
+	std::chrono::milliseconds	max_delay	= std::chrono::milliseconds(1000);
+};
+
+// --------------------------------------------------------------------------------------------------
+// watcher
+//
+// Filesystem change notification, delivered as batched change sets on a background thread.
+// Backed by inotify, and thus only functional on linux: elsewhere, or where inotify is disabled or
+// out of instances, is_supported() is false and watch() fails, so callers can fall back to
+// rescanning on a timer.
+//
+// Recursive watches also watch subdirectories created later. Besides the callback, a watcher can
+// drop changed paths from a stat_cache, and re-run ConfigParseFile() on config files that change;
+// both happen on the watcher thread before the callback is invoked.
+//
+class watcher
+{
+public:
+	using callback = std::function<void (const change_set& changes)>;
+
+protected:
+	struct impl;
+	std::unique_ptr<impl>	impl_;
+
+public:
+	watcher();
+	~watcher();
+
+	watcher(const watcher&) = delete;
+	watcher& operator=(const watcher&) = delete;
+
+	static bool	is_supported	();
+
+	// watches may be added before or after start(). Returns false if dir couldn't be watched.
+	bool		watch			(const path& dir, bool recursive = true);
+
+	bool		start			(const callback& func, const watcher_options& options = {});
+	void		stop			();
+	bool		is_running		() const;
+
+	// pass nullptr to detach. The cache must outlive the watcher or be detached first.
+	void		attach_stat_cache	(stat_cache* cache);
+
+	// parses the file now, then again on the watcher thread each time it changes. The file's
+	// directory is watched (non-recursively) so that editors which save by replacing are handled.
+	bool		reload_config		(const path& file, const ConfigParseAddFunc& push_item);
+};
+
+} // namespace fs
@@ -22,6 +22,7 @@ using x_off_t = intmax_t;
 
     // windows POSIX libs are lacking the fancy new pread() function. >_<
     extern size_t _pread(int fd, void* dest, size_t count, x_off_t pos);
+    extern size_t _pwrite(int fd, const void* src, size_t count, x_off_t pos);
 
     // Windows has this asinine non-standard notion of text mode POSIX files and, worse, makes the
     // non-standard behavior the DEFAULT behavior.  What the bloody hell, Microsoft?  Your're drunk.
@@ -30,6 +31,7 @@ using x_off_t = intmax_t;
 #	define posix_open(fn,flags,mode)   _open(fn,(flags) | _O_BINARY, mode)
 #	define posix_read   _read
 #	define posix_pread  _pread
+#	define posix_pwrite _pwrite
 #	define posix_write  _write
 #	define posix_close  _close
 #	define posix_lseek  _lseeki64
@@ -50,10 +52,14 @@ using x_off_t = intmax_t;
 #	define posix_open   open
 #	define posix_read   read
 #	define posix_pread  pread
+#	define posix_pwrite pwrite
 #	define posix_write  write
 #	define posix_close  close
 #	define posix_lseek  lseek
 #	define posix_unlink unlink
+#	if !defined(O_DIRECT)
+#		define O_DIRECT	(0)		// eg. macOS, which offers F_NOCACHE instead
+#	endif
 // Warning on linux, DEFFILEMODE is (S_IRUSR|S_IWUSR|S_IRGRP|S_IWGRP|S_IROTH|S_IWOTH)/* 0666*/
 
 #else
@@ -0,0 +1,1209 @@
+#include "fs.h"
+#include "fs_simd.h"
+#include "fs_stat_cache.h"
+#include "fs_directory.h"
+#include "fs_walk.h"
+#include "fs_glob.h"
+#include "fs_mapped_file.h"
+#include "fs_async_io.h"
+#include "fs_read_batch.h"
+#include "fs_file_io.h"
+#include "fs_copy.h"
+#include "fs_remove.h"
+#include "fs_hash.h"
+#include "fs_snapshot.h"
+#include "fs_diff.h"
+#include "StringUtil.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <filesystem>
+#include <atomic>
+#include <new>
+#include <string>
+#include <vector>
+#include <thread>
+#include <algorithm>
+
+// --------------------------------------------------------------------------------------------------
+// Benchmarks for icyStdLib, invoked via `samples bench [name]`
+//
+// Heap use is measured by replacing global operator new for the whole samples binary. Counters are
+// relaxed atomics, cheap enough that they don't skew the timings in any meaningful way.
+//
+
+static std::atomic<intmax_t> s_heap_allocs = { 0 };
+static std::atomic<intmax_t> s_heap_bytes  = { 0 };
+static volatile intmax_t     s_bench_sink;		// keeps results of timed loops observable
+
+// the replacements mustn't be inlined: GCC would then see free() paired with operator new, and
+// warn (-Wmismatched-new-delete) at every inlined call site.
+#if defined(_MSC_VER)
+#	define BENCH_NOINLINE	__declspec(noinline)
+#else
+#	define BENCH_NOINLINE	__attribute__((noinline))
+#endif
+
+BENCH_NOINLINE void* operator new(size_t size) {
+	s_heap_allocs.fetch_add(1, std::memory_order_relaxed);
+	s_heap_bytes .fetch_add(size, std::memory_order_relaxed);
+	if (void* ptr = malloc(size ? size : 1)) {
+		return ptr;
+	}
+	abort();
+}
+
+BENCH_NOINLINE void  operator delete  (void* ptr) noexcept				{ free(ptr); }
+BENCH_NOINLINE void  operator delete  (void* ptr, size_t) noexcept		{ free(ptr); }
+BENCH_NOINLINE void* operator new[]   (size_t size)						{ return operator new(size); }
+BENCH_NOINLINE void  operator delete[](void* ptr) noexcept				{ free(ptr); }
+BENCH_NOINLINE void  operator delete[](void* ptr, size_t) noexcept		{ free(ptr); }
+
+struct bench_scope
+{
+	std::string	name;
+	const char*	unit;
+	intmax_t	items;
+	intmax_t	allocs_start;
+	intmax_t	bytes_start;
+	std::chrono::steady_clock::time_point time_start;
+
+	// items are reported in millions per second, under the given unit name.
+	bench_scope(const std::string& name_, intmax_t items_, const char* unit_ = "Mitems/s") {
+		name			= name_;
+		unit			= unit_;
+		items			= items_;
+		allocs_start	= s_heap_allocs.load();
+		bytes_start		= s_heap_bytes .load();
+		time_start		= std::chrono::steady_clock::now();
+	}
+
+	~bench_scope() {
+		auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - time_start).count();
+		auto allocs  = s_heap_allocs.load() - allocs_start;
+		auto bytes   = s_heap_bytes .load() - bytes_start;
+		printf("  %-36s %9.2f ms  %8.2f %-8s  %11jd allocs  %13jd bytes\n",
+			name.c_str(), elapsed * 1000.0, (items / elapsed) / 1e6, unit, allocs, bytes
+		);
+	}
+};
+
+// Mixed DOS/universal corpus resembling an asset manifest.
+static std::vector<std::string> make_path_corpus(int count) {
+	static const char* roots[] = { "c:\\data\\", "/c/data/", "d:/assets/", "/d/assets\\", "./rel/", "" };
+	static const char* exts [] = { ".cfg", ".png", ".bin", ".txt" };
+
+	std::vector<std::string> corpus;
+	corpus.reserve(count);
+	for (int i=0; i<count; ++i) {
+		corpus.push_back(StringUtil::Format("%sdir%02d\\sub%03d/tex_%06d%s",
+			roots[i % 6], (i / 7) % 64, (i / 3) % 512, i, exts[i % 4]
+		));
+	}
+	return corpus;
+}
+
+// --------------------------------------------------------------------------------------------------
+// fs::path native materialization
+//
+// "eager" replicates the previous fs::path layout, which stored a converted native copy alongside
+// the universal path on every construction and append.
+//
+struct eager_path {
+	std::string uni_path_;
+	std::string libc_path_;
+
+	eager_path(const char* src) {
+		uni_path_  = fs::PathFromString(src);
+		libc_path_ = fs::ConvertToMsw(uni_path_);
+	}
+};
+
+static void bench_path_native(int count) {
+	auto corpus = make_path_corpus(count);
+
+	printf("fs::path native materialization (%d paths)\n", count);
+	printf("  sizeof: eager_path=%zu fs::path=%zu\n", sizeof(eager_path), sizeof(fs::path));
+
+	{
+		std::vector<eager_path> paths;
+		paths.reserve(count);
+		bench_scope scope("construct (before: eager native)", count);
+		for (const auto& item : corpus) {
+			paths.emplace_back(item.c_str());
+		}
+	}
+
+	{
+		std::vector<fs::path> paths;
+		paths.reserve(count);
+		{
+			bench_scope scope("construct (after: lazy native)", count);
+			for (const auto& item : corpus) {
+				paths.emplace_back(item.c_str());
+			}
+		}
+		{
+			intmax_t total = 0;
+			bench_scope scope("c_str() first use", count);
+			for (const auto& item : paths) {
+				total += item.c_str()[0];
+			}
+			s_bench_sink = total;
+		}
+		{
+			intmax_t total = 0;
+			bench_scope scope("c_str() cached", count);
+			for (const auto& item : paths) {
+				total += item.c_str()[0];
+			}
+			s_bench_sink = total;
+		}
+	}
+}
+
+// --------------------------------------------------------------------------------------------------
+// fs::path_list vs std::vector<fs::path>
+//
+// Mirrors the shape of a large directory scan: fill from raw strings, walk once, tear down.
+//
+static void bench_path_list(int count) {
+	auto corpus = make_path_corpus(count);
+
+	printf("fs::path_list bulk storage (%d paths)\n", count);
+
+	{
+		auto* paths = new std::vector<fs::path>;
+		{
+			bench_scope scope("fill std::vector<fs::path>", count);
+			for (const auto& item : corpus) {
+				paths->emplace_back(item.c_str());
+			}
+		}
+		{
+			intmax_t total = 0;
+			bench_scope scope("iterate filename()", count);
+			for (const auto& item : *paths) {
+				total += item.view().filename().length();
+			}
+			s_bench_sink = total;
+		}
+		bench_scope scope("teardown std::vector<fs::path>", count);
+		delete paths;
+	}
+
+	{
+		auto* list = new fs::path_list;
+		{
+			bench_scope scope("fill fs::path_list", count);
+			for (const auto& item : corpus) {
+				list->push_back_raw(item.c_str());
+			}
+		}
+		{
+			intmax_t total = 0;
+			bench_scope scope("iterate filename()", count);
+			for (const auto& view : *list) {
+				total += view.filename().length();
+			}
+			s_bench_sink = total;
+		}
+		bench_scope scope("teardown fs::path_list", count);
+		delete list;
+	}
+}
+
+// --------------------------------------------------------------------------------------------------
+// fs::simd separator kernels
+//
+// Raw kernel throughput on a large buffer, then end-to-end ConvertFromMsw/ConvertToMsw on the
+// manifest corpus where typical path lengths (~40 bytes) limit how much vector width can help.
+//
+static void bench_simd_separators(int count) {
+	using fs::simd::isa;
+
+	auto corpus = make_path_corpus(count);
+	std::string bigbuf;
+	for (const auto& item : corpus) {
+		bigbuf += item;
+	}
+	std::string dest(bigbuf.size(), 0);
+
+	// worst case for the scanner: no separator until the very end.
+	std::string nosep(bigbuf.size(), 'a');
+	nosep.back() = '/';
+
+	printf("fs::simd separator kernels (%d paths, %zu bytes)\n", count, bigbuf.size());
+
+	auto orig_isa = fs::simd::ActiveIsa();
+	for (auto which : { isa::scalar, isa::sse2, isa::avx2, isa::neon }) {
+		if (!fs::simd::ForceIsa(which)) continue;
+
+		{
+			bench_scope scope(sFmtStr("%s TranslateChar", fs::simd::IsaName(which)), bigbuf.size(), "MB/s");
+			fs::simd::TranslateChar(&dest[0], bigbuf.data(), bigbuf.size(), '\\', '/');
+		}
+		{
+			bench_scope scope(sFmtStr("%s FindPathSep", fs::simd::IsaName(which)), nosep.size(), "MB/s");
+			s_bench_sink = fs::simd::FindPathSep(nosep.data(), nosep.size());
+		}
+		{
+			intmax_t total = 0;
+			bench_scope scope(sFmtStr("%s ConvertFromMsw", fs::simd::IsaName(which)), count);
+			for (const auto& item : corpus) {
+				total += fs::ConvertFromMsw(item).length();
+			}
+			s_bench_sink = total;
+		}
+		{
+			intmax_t total = 0;
+			bench_scope scope(sFmtStr("%s ConvertToMsw", fs::simd::IsaName(which)), count);
+			for (const auto& item : corpus) {
+				total += fs::ConvertToMsw(item).length();
+			}
+			s_bench_sink = total;
+		}
+	}
+	fs::simd::ForceIsa(orig_isa);
+}
+
+// --------------------------------------------------------------------------------------------------
+// fs::PathsFromStrings batch normalization
+//
+static void bench_paths_from_strings(int count) {
+	auto corpus = make_path_corpus(count);
+	std::vector<const char*> srcs;
+	for (const auto& item : corpus) {
+		srcs.push_back(item.c_str());
+	}
+
+	printf("fs::PathsFromStrings batch normalization (%d paths)\n", count);
+	{
+		std::vector<fs::path> paths;
+		paths.reserve(count);
+		bench_scope scope("one fs::path at a time", count);
+		for (const auto* item : srcs) {
+			paths.emplace_back(item);
+		}
+	}
+	{
+		fs::path_list list;
+		bench_scope scope("PathsFromStrings", count);
+		fs::PathsFromStrings(list, srcs);
+	}
+}
+
+// --------------------------------------------------------------------------------------------------
+// fs::path_builder vs chained operator/
+//
+static void bench_path_builder(int count) {
+	fs::path root = "/c/project/assets";
+	std::vector<std::string> dirs, files;
+	for (int i=0; i<64; ++i) {
+		dirs .push_back(sFmtStr("dir%02d", i));
+		files.push_back(sFmtStr("tex_%06d.png", i * 7919));
+	}
+
+	printf("fs::path_builder fused joins (%d paths)\n", count);
+	{
+		intmax_t total = 0;
+		bench_scope scope("root / dir / sub / file", count);
+		for (int i=0; i<count; ++i) {
+			fs::path full = root / dirs[i % 64] / dirs[(i / 64) % 64] / files[i % 61];
+			total += full.uni_string().length();
+		}
+		s_bench_sink = total;
+	}
+	{
+		intmax_t total = 0;
+		bench_scope scope("path_builder(root) / dir / sub / file", count);
+		for (int i=0; i<count; ++i) {
+			fs::path full = fs::path_builder(root) / dirs[i % 64] / dirs[(i / 64) % 64] / files[i % 61];
+			total += full.uni_string().length();
+		}
+		s_bench_sink = total;
+	}
+}
+
+// --------------------------------------------------------------------------------------------------
+// fs::status and fs::stat_cache
+//
+// Shape of a build step's dependency check: the same set of files probed over several passes.
+//
+static void bench_stat_cache(int count) {
+	const int passes = 8;
+	fs::path dir = "samples_bench_stat";
+	fs::create_directory(dir);
+
+	std::vector<fs::path> files;
+	for (int i=0; i<count; ++i) {
+		files.push_back(dir / sFmtStr("file_%06d.bin", i));
+		if (i % 2) {
+			// only every other file exists, misses are just as common as hits in practice.
+			if (FILE* fp = fopen(files.back().c_str(), "wb")) fclose(fp);
+		}
+	}
+
+	printf("fs::stat_cache (%d files, %d passes)\n", count, passes);
+	{
+		intmax_t total = 0;
+		bench_scope scope("exists + is_directory + file_size", intmax_t(count) * passes);
+		for (int pass=0; pass<passes; ++pass) {
+			for (const auto& file : files) {
+				total += fs::exists(file) + fs::is_directory(file) + fs::file_size(file);
+			}
+		}
+		s_bench_sink = total;
+	}
+	{
+		intmax_t total = 0;
+		bench_scope scope("status (one stat per probe)", intmax_t(count) * passes);
+		for (int pass=0; pass<passes; ++pass) {
+			for (const auto& file : files) {
+				auto st = fs::status(file);
+				total += st.Exists() + st.IsDir() + st.st_size;
+			}
+		}
+		s_bench_sink = total;
+	}
+	{
+		fs::stat_cache cache;
+		intmax_t total = 0;
+		bench_scope scope("stat_cache", intmax_t(count) * passes);
+		for (int pass=0; pass<passes; ++pass) {
+			for (const auto& file : files) {
+				auto st = cache.status(file);
+				total += st.Exists() + st.IsDir() + st.st_size;
+			}
+		}
+		s_bench_sink = total;
+	}
+
+	for (const auto& file : files) {
+		fs::remove(file);
+	}
+	fs::remove(dir);
+}
+
+// --------------------------------------------------------------------------------------------------
+// fs::directory_stream vs std::filesystem listing
+//
+// Typical scan: list a directory and tell subdirectories from files.
+//
+static void bench_directory_stream(int count) {
+	const int passes = 8;
+	fs::path dir = "samples_bench_dir";
+	fs::create_directory(dir);
+	for (int i=0; i<count; ++i) {
+		auto item = dir / sFmtStr("entry_%06d", i);
+		if (i % 8 == 0) {
+			fs::create_directory(item);
+		}
+		else if (FILE* fp = fopen(item.c_str(), "wb")) {
+			fclose(fp);
+		}
+	}
+
+	printf("fs::directory_stream (%d entries, %d passes)\n", count, passes);
+	{
+		intmax_t total = 0;
+		bench_scope scope("std::filesystem + fs::is_directory", intmax_t(count) * passes);
+		for (int pass=0; pass<passes; ++pass) {
+			for (const std::filesystem::path& item : std::filesystem::directory_iterator(dir.c_str())) {
+				fs::path entry = item.u8string().c_str();
+				total += fs::is_directory(entry);
+			}
+		}
+		s_bench_sink = total;
+	}
+	{
+		intmax_t total = 0;
+		bench_scope scope("directory_stream + d_type", intmax_t(count) * passes);
+		for (int pass=0; pass<passes; ++pass) {
+			fs::directory_stream stream(dir);
+			for (const auto& entry : stream) {
+				total += (entry.type == fs::file_type::unknown) ? stream.status(entry).IsDir() : entry.is_directory();
+			}
+		}
+		s_bench_sink = total;
+	}
+
+	fs::path_list list;
+	fs::directory_iterator(list, dir);
+	for (auto item : list) {
+		fs::remove(fs::path(item));
+	}
+	fs::remove(dir);
+}
+
+// --------------------------------------------------------------------------------------------------
+// fs::walk vs naive recursion over fs::directory_iterator
+//
+static void naive_walk(const fs::path& dir, intmax_t& total) {
+	for (const auto& item : fs::directory_iterator(dir)) {
+		++total;
+		if (fs::is_directory(item)) {
+			naive_walk(item, total);
+		}
+	}
+}
+
+static void bench_walk(int count) {
+	// tree of 20 x 20 directories, files spread evenly across the leaves.
+	fs::path root = "samples_bench_walk";
+	int per_leaf = std::max(1, count / 400);
+	for (int a=0; a<20; ++a) {
+		for (int b=0; b<20; ++b) {
+			auto leaf = root / sFmtStr("dir%02d/sub%02d", a, b);
+			fs::create_directory(leaf);
+			for (int f=0; f<per_leaf; ++f) {
+				if (FILE* fp = fopen((leaf / sFmtStr("file_%05d.bin", f)).c_str(), "wb")) fclose(fp);
+			}
+		}
+	}
+
+	intmax_t entries = 420 + 400 * intmax_t(per_leaf);
+	printf("fs::walk (%jd entries, %u hw threads)\n", entries, std::thread::hardware_concurrency());
+	{
+		intmax_t total = 0;
+		bench_scope scope("naive directory_iterator recursion", entries);
+		naive_walk(root, total);
+		s_bench_sink = total;
+	}
+	for (int threads : { 1, 0 }) {
+		fs::walk_options options;
+		options.threads = threads;
+		std::atomic<intmax_t> total = { 0 };
+		bench_scope scope(threads ? "fs::walk, 1 thread" : "fs::walk, all threads", entries);
+		fs::walk(root, [&](const fs::walk_entry&) { total.fetch_add(1, std::memory_order_relaxed); }, options);
+		s_bench_sink = total;
+	}
+	{
+		fs::path_list list;
+		bench_scope scope("fs::walk into path_list", entries);
+		fs::walk(root, list);
+		s_bench_sink = list.size();
+	}
+
+	fs::path_list list;
+	fs::walk(root, list);
+	std::vector<std::string> doomed;
+	for (auto item : list) {
+		doomed.push_back(std::string(item.uni_string()));
+	}
+	std::sort(doomed.rbegin(), doomed.rend());
+	for (const auto& item : doomed) {
+		fs::remove(item.c_str());
+	}
+	fs::remove(root);
+}
+
+// --------------------------------------------------------------------------------------------------
+// fs::glob_pattern vs ad-hoc filtering
+//
+static void bench_glob(int count) {
+	auto corpus = make_path_corpus(count);
+	fs::path_list list;
+	for (const auto& item : corpus) {
+		list.push_back_raw(item);
+	}
+
+	printf("fs::glob_pattern (%d paths)\n", count);
+	{
+		intmax_t total = 0;
+		bench_scope scope("path::extension() == \".cfg\"", count);
+		for (auto item : list) {
+			total += fs::path(item).extension() == ".cfg";
+		}
+		s_bench_sink = total;
+	}
+	{
+		intmax_t total = 0;
+		bench_scope scope("StringUtil::EndsWith(\".cfg\")", count);
+		for (auto item : list) {
+			total += StringUtil::EndsWith(std::string(item.uni_string()), ".cfg");
+		}
+		s_bench_sink = total;
+	}
+	{
+		fs::glob_pattern glob("**/*.cfg");
+		intmax_t total = 0;
+		bench_scope scope("glob **/*.cfg", count);
+		for (auto item : list) {
+			total += glob.match(item);
+		}
+		s_bench_sink = total;
+	}
+	{
+		fs::glob_pattern glob("**/dir0?/sub1*/tex_*.png", fs::glob_case::insensitive);
+		intmax_t total = 0;
+		bench_scope scope("glob **/dir0?/sub1*/tex_*.png nocase", count);
+		for (auto item : list) {
+			total += glob.match(item);
+		}
+		s_bench_sink = total;
+	}
+}
+
+// --------------------------------------------------------------------------------------------------
+// fs::mapped_file vs posix_pread loops, reading a file of `count` MiB. The file was just written so
+// every variant reads from a warm page cache: what's measured is the syscall and copy overhead that
+// mapping avoids, not the device.
+//
+static uint64_t sum_words(const uint8_t* data, size_t size) {
+	uint64_t sum = 0;
+	for (size_t i=0; i+8 <= size; i += 8) {
+		uint64_t word;
+		memcpy(&word, data + i, 8);
+		sum += word;
+	}
+	return sum;
+}
+
+static void bench_mapped_file(int count) {
+	const size_t mib = 1024 * 1024;
+	const x_off_t total = x_off_t(count) * mib;
+	fs::path file = "samples_bench_mapped.bin";
+	{
+		std::vector<uint8_t> chunk(16 * mib);
+		for (size_t i=0; i<chunk.size(); ++i) {
+			chunk[i] = uint8_t(i * 131);
+		}
+		int fd = posix_open(file.c_str(), O_WRONLY | O_CREAT | O_TRUNC, DEFFILEMODE);
+		for (x_off_t pos=0; pos<total; pos += chunk.size()) {
+			if (posix_write(fd, chunk.data(), unsigned(chunk.size())) <= 0) break;
+		}
+		posix_close(fd);
+	}
+
+	printf("fs::mapped_file (%d MiB file, warm cache)\n", count);
+	for (size_t bufsize : { 64 * 1024, 1024 * 1024 }) {
+		std::vector<uint8_t> buf(bufsize);
+		uint64_t sum = 0;
+		bench_scope scope(sFmtStr("posix_pread, %zu KiB buffer", bufsize / 1024), total, "MB/s");
+		int fd = posix_open(file.c_str(), O_RDONLY, 0);
+		for (x_off_t pos=0; pos<total; pos += bufsize) {
+			auto got = posix_pread(fd, buf.data(), bufsize, pos);
+			if (got <= 0) break;
+			sum += sum_words(buf.data(), size_t(got));
+		}
+		posix_close(fd);
+		s_bench_sink = sum;
+	}
+	{
+		uint64_t sum = 0;
+		bench_scope scope("mapped_file, whole + sequential", total, "MB/s");
+		fs::mapped_file mapped(file);
+		mapped.advise(fs::map_advice::sequential);
+		sum += sum_words(mapped.data(), mapped.size());
+		s_bench_sink = sum;
+	}
+	for (size_t window : { 64 * mib, 256 * mib }) {
+		uint64_t sum = 0;
+		bench_scope scope(sFmtStr("mapped_file, %zu MiB windows", window / mib), total, "MB/s");
+		fs::mapped_file mapped;
+		mapped.open(file);
+		for (x_off_t pos=0; pos<mapped.file_size(); pos += window) {
+			mapped.map(pos, window);
+			mapped.advise(fs::map_advice::sequential);
+			sum += sum_words(mapped.data(), mapped.size());
+		}
+		s_bench_sink = sum;
+	}
+
+	fs::remove(file);
+}
+
+// --------------------------------------------------------------------------------------------------
+// fs::io_engine vs one posix_pread at a time: `count` random 4 KiB reads over a 256 MiB file, first
+// from the page cache (per-request overhead), then with O_DIRECT so that every read reaches the
+// device, which is where queue depth pays off. O_DIRECT is a no-op on msw, see posix_file.h.
+//
+static void print_latency(std::vector<double>& usecs, size_t count) {
+	std::sort(usecs.begin(), usecs.begin() + count);
+	auto pct = [&](double p) { return usecs[std::min(count - 1, size_t(p * count))]; };
+	printf("  %-36s p50 %7.2f us   p99 %7.2f us   p99.9 %7.2f us   max %8.2f us\n", "",
+		pct(0.50), pct(0.99), pct(0.999), usecs[count - 1]
+	);
+}
+
+static void bench_async_io(int count) {
+	using clock = std::chrono::steady_clock;
+	const size_t block = 4096;
+	const unsigned max_depth = 128;
+	const x_off_t file_size = x_off_t(256) * 1024 * 1024;
+	fs::path file = "samples_bench_async.bin";
+	{
+		std::vector<uint8_t> chunk(16 * 1024 * 1024, 0x5a);
+		int fd = posix_open(file.c_str(), O_WRONLY | O_CREAT | O_TRUNC, DEFFILEMODE);
+		for (x_off_t pos=0; pos<file_size; pos += chunk.size()) {
+			if (posix_write(fd, chunk.data(), unsigned(chunk.size())) <= 0) break;
+		}
+		posix_close(fd);
+	}
+
+	std::vector<x_off_t> offsets(count);
+	uint64_t lcg = 12345;
+	for (auto& offset : offsets) {
+		lcg = lcg * 6364136223846793005ULL + 1442695040888963407ULL;
+		offset = x_off_t((lcg >> 20) % uint64_t(file_size / block)) * block;
+	}
+
+	// O_DIRECT wants block-aligned buffers.
+	std::vector<uint8_t> buf_storage(block * (max_depth + 1));
+	auto* bufs = (uint8_t*)((uintptr_t(buf_storage.data()) + block - 1) & ~uintptr_t(block - 1));
+
+	std::vector<double>				usecs(count);
+	std::vector<unsigned>			free_slots;
+	std::vector<unsigned>			slot_of(count);
+	std::vector<clock::time_point>	started(count);
+	free_slots.reserve(max_depth);
+
+	for (bool direct : { false, true }) {
+		// device reads are orders of magnitude slower, a fraction of the requests makes the point.
+		int nreads = direct ? count / 10 : count;
+		int fd = posix_open(file.c_str(), O_RDONLY | (direct ? O_DIRECT : 0), 0);
+		printf("fs::io_engine (%d random %zu byte reads, %s)\n", nreads, block, direct ? "O_DIRECT" : "warm cache");
+		{
+			intmax_t total = 0;
+			{
+				bench_scope scope("posix_pread, one at a time", nreads, "MIOPS");
+				for (int i=0; i<nreads; ++i) {
+					auto start = clock::now();
+					total += posix_pread(fd, bufs, block, offsets[i]);
+					usecs[i] = std::chrono::duration<double, std::micro>(clock::now() - start).count();
+				}
+			}
+			s_bench_sink = total;
+			print_latency(usecs, nreads);
+		}
+
+		struct config { bool force_pool; unsigned depth; };
+		for (auto cfg : { config{ false, 1 }, config{ false, 32 }, config{ false, max_depth }, config{ true, 32 }, config{ true, max_depth } }) {
+			fs::io_engine_options options;
+			options.queue_depth       = cfg.depth;
+			options.force_thread_pool = cfg.force_pool;
+			fs::io_engine engine(options);
+			if (!cfg.force_pool && engine.backend() != fs::io_backend::io_uring) continue;
+
+			free_slots.clear();
+			for (unsigned i=0; i<cfg.depth; ++i) {
+				free_slots.push_back(i);
+			}
+
+			intmax_t total = 0;
+			{
+				bench_scope scope(sFmtStr("io_engine %s, depth %u", cfg.force_pool ? "thread_pool" : "io_uring", cfg.depth), nreads, "MIOPS");
+				int next = 0;
+				int done = 0;
+				while (done < nreads) {
+					while (next < nreads && !free_slots.empty()) {
+						auto slot = free_slots.back();
+						if (!engine.queue({ fd, offsets[next], bufs + slot * block, block, fs::io_op::read, uintptr_t(next) })) break;
+						free_slots.pop_back();
+						slot_of[next] = slot;
+						started[next] = clock::now();
+						++next;
+					}
+					done += int(engine.drain([&](const fs::io_completion& completion) {
+						auto idx = completion.user_data;
+						usecs[idx] = std::chrono::duration<double, std::micro>(clock::now() - started[idx]).count();
+						free_slots.push_back(slot_of[idx]);
+						total += completion.result;
+					}, 1));
+				}
+			}
+			s_bench_sink = total;
+			print_latency(usecs, nreads);
+		}
+		posix_close(fd);
+		if (!direct) printf("\n");
+	}
+
+	fs::remove(file);
+}
+
+// --------------------------------------------------------------------------------------------------
+// fs::read_ranges vs one posix_pread per range: a pack file of small entries, three quarters of which
+// are requested in shuffled order, as a loader resolving a manifest would. Warm cache.
+//
+static void bench_read_ranges(int count) {
+	fs::path file = "samples_bench_pack.bin";
+	uint64_t lcg = 777;
+	auto rand = [&](uint32_t range) {
+		lcg = lcg * 6364136223846793005ULL + 1442695040888963407ULL;
+		return uint32_t((lcg >> 33) % range);
+	};
+
+	std::vector<fs::read_range> ranges;
+	x_off_t pos = 0;
+	for (int i=0; i<count * 4 / 3; ++i) {
+		size_t length = 64 + rand(960);
+		if (rand(4)) {
+			ranges.push_back({ pos, length, nullptr });
+		}
+		pos += x_off_t(length) + rand(64);		// alignment padding
+	}
+	for (size_t i=ranges.size(); i>1; --i) {
+		std::swap(ranges[i-1], ranges[rand(uint32_t(i))]);
+	}
+
+	{
+		std::vector<uint8_t> chunk(1024 * 1024, 0x33);
+		int fd = posix_open(file.c_str(), O_WRONLY | O_CREAT | O_TRUNC, DEFFILEMODE);
+		for (x_off_t written=0; written<pos; written += chunk.size()) {
+			if (posix_write(fd, chunk.data(), unsigned(chunk.size())) <= 0) break;
+		}
+		posix_close(fd);
+	}
+
+	size_t total_bytes = 0;
+	for (const auto& range : ranges) {
+		total_bytes += range.length;
+	}
+	std::vector<uint8_t> dest(total_bytes);
+	size_t offset = 0;
+	for (auto& range : ranges) {
+		range.dest = &dest[offset];
+		offset += range.length;
+	}
+
+	int fd = posix_open(file.c_str(), O_RDONLY, 0);
+	printf("fs::read_ranges (%zu ranges, %.1f MiB of a %.1f MiB pack, warm cache)\n", ranges.size(),
+		total_bytes / 1048576.0, pos / 1048576.0
+	);
+	{
+		intmax_t total = 0;
+		bench_scope scope("posix_pread per range", intmax_t(ranges.size()));
+		for (const auto& range : ranges) {
+			total += posix_pread(fd, range.dest, range.length, range.offset);
+		}
+		s_bench_sink = total;
+	}
+	printf("  %-36s %jd syscalls\n", "", intmax_t(ranges.size()));
+
+	for (size_t gap : { size_t(0), size_t(4096), size_t(16 * 1024) }) {
+		fs::read_batch_options options;
+		options.max_gap = gap;
+		fs::read_batch_stats stats;
+		{
+			bench_scope scope(sFmtStr("read_ranges, max_gap %zu", gap), intmax_t(ranges.size()));
+			stats = fs::read_ranges(fd, ranges.data(), ranges.size(), options);
+		}
+		printf("  %-36s %jd syscalls, %jd runs, %.1f MiB of gaps\n", "", stats.syscalls, stats.runs, stats.gap_bytes / 1048576.0);
+	}
+	posix_close(fd);
+	fs::remove(file);
+}
+
+// --------------------------------------------------------------------------------------------------
+// fs::file_writer / fs::file_reader vs FILE*, streaming `count` MiB in 100-byte records. Direct mode
+// skips the page cache both ways: writes save the copy into it, while direct reads go to the device
+// and forgo the warm cache the buffered readers are served from.
+//
+static void bench_file_io(int count) {
+	const size_t record = 100;
+	const x_off_t total = x_off_t(count) * 1024 * 1024;
+	const intmax_t records = intmax_t(total / record);
+	fs::path file = "samples_bench_file_io.bin";
+
+	uint8_t data[record];
+	for (size_t i=0; i<record; ++i) {
+		data[i] = uint8_t(i * 3);
+	}
+
+	printf("fs::file_writer / fs::file_reader (%d MiB in %zu byte records)\n", count, record);
+	{
+		bench_scope scope("FILE* fwrite", total, "MB/s");
+		if (FILE* fp = fopen(file.c_str(), "wb")) {
+			for (intmax_t i=0; i<records; ++i) {
+				fwrite(data, 1, record, fp);
+			}
+			fclose(fp);
+		}
+	}
+	for (bool direct : { false, true }) {
+		fs::file_io_options options;
+		options.direct = direct;
+		bench_scope scope(direct ? "file_writer, direct" : "file_writer", total, "MB/s");
+		fs::file_writer writer(file, options);
+		for (intmax_t i=0; i<records; ++i) {
+			writer.write(data, record);
+		}
+		writer.close();
+	}
+
+	{
+		uint64_t sum = 0;
+		bench_scope scope("FILE* fread", total, "MB/s");
+		if (FILE* fp = fopen(file.c_str(), "rb")) {
+			while (fread(data, 1, record, fp) == record) {
+				sum += data[7];
+			}
+			fclose(fp);
+		}
+		s_bench_sink = sum;
+	}
+	for (bool direct : { false, true }) {
+		fs::file_io_options options;
+		options.direct = direct;
+		uint64_t sum = 0;
+		bench_scope scope(direct ? "file_reader, direct" : "file_reader", total, "MB/s");
+		fs::file_reader reader(file, options);
+		while (reader.read(data, record) == record) {
+			sum += data[7];
+		}
+		s_bench_sink = sum;
+	}
+	fs::remove(file);
+}
+
+// --------------------------------------------------------------------------------------------------
+// fs::copy_file / fs::copy_tree vs std::filesystem::copy
+//
+static void bench_copy(int count) {
+	const x_off_t total = x_off_t(count) * 1024 * 1024;
+	fs::path src  = "samples_bench_copy_src.bin";
+	fs::path dest = "samples_bench_copy_dest.bin";
+	{
+		fs::file_writer writer(src);
+		std::vector<uint8_t> block(1024 * 1024);
+		for (int i=0; i<count; ++i) {
+			memset(block.data(), i, block.size());
+			writer.write(block.data(), block.size());
+		}
+		writer.close();
+	}
+
+	printf("fs::copy_file (%d MiB)\n", count);
+	{
+		bench_scope scope("std::filesystem::copy_file", total, "MB/s");
+		std::filesystem::copy_file(src.c_str(), dest.c_str(), std::filesystem::copy_options::overwrite_existing);
+	}
+	for (auto first : { fs::copy_method::read_write, fs::copy_method::sendfile, fs::copy_method::copy_file_range, fs::copy_method::reflink }) {
+		fs::copy_options options;
+		options.first_method = first;
+		fs::copy_result result;
+		{
+			bench_scope scope(sFmtStr("from %s", fs::copy_method_name(first)), total, "MB/s");
+			result = fs::copy_file(src, dest, options);
+		}
+		printf("    -> copied by %s\n", fs::copy_method_name(result.method));
+	}
+	fs::remove(src);
+	fs::remove(dest);
+
+	// many small files: per-file overhead and parallelism dominate.
+	const int nfiles = 5000;
+	fs::path root = "samples_bench_copy_tree";
+	std::string content(4096, 'x');
+	for (int i=0; i<nfiles; ++i) {
+		auto dir = root / sFmtStr("dir%02d", i % 50);
+		if (i < 50) fs::create_directory(dir);
+		if (FILE* fp = fopen((dir / sFmtStr("file_%05d.bin", i)).c_str(), "wb")) {
+			fwrite(content.data(), 1, content.length(), fp);
+			fclose(fp);
+		}
+	}
+
+	printf("fs::copy_tree (%d files of %zu bytes, %u hw threads)\n", nfiles, content.length(), std::thread::hardware_concurrency());
+	{
+		bench_scope scope("std::filesystem::copy recursive", nfiles, "Mfiles/s");
+		std::filesystem::copy(root.c_str(), "samples_bench_copy_out", std::filesystem::copy_options::recursive);
+	}
+	std::filesystem::remove_all("samples_bench_copy_out");
+	for (int threads : { 1, 0 }) {
+		fs::copy_options options;
+		options.threads = threads;
+		bench_scope scope(threads ? "fs::copy_tree, 1 thread" : "fs::copy_tree, all threads", nfiles, "Mfiles/s");
+		auto stats = fs::copy_tree(root, "samples_bench_copy_out", options);
+		s_bench_sink = stats.files;
+	}
+	std::filesystem::remove_all("samples_bench_copy_out");
+	std::filesystem::remove_all(root.c_str());
+}
+
+// --------------------------------------------------------------------------------------------------
+// fs::create_directories batch vs fs::create_directory per path
+//
+static void bench_create_directories(int count) {
+	// exporter-like layout: deep shared prefixes, leaves spread over 40 x 25 parents.
+	fs::path root = "samples_bench_mkdir";
+	std::vector<fs::path> dirs;
+	for (int i=0; i<count; ++i) {
+		dirs.push_back(root / sFmtStr("export/assets/group%02d/set%02d/item%06d", i % 40, (i / 40) % 25, i));
+	}
+
+	printf("fs::create_directories (%d leaf directories)\n", count);
+	for (bool existing : { false, true }) {
+		bench_scope scope(existing ? "fs::create_directory, existing" : "fs::create_directory", count);
+		for (const auto& dir : dirs) {
+			fs::create_directory(dir);
+		}
+	}
+	std::filesystem::remove_all(root.c_str());
+	for (bool existing : { false, true }) {
+		bench_scope scope(existing ? "fs::create_directories, existing" : "fs::create_directories", count);
+		s_bench_sink = fs::create_directories(dirs);
+	}
+	std::filesystem::remove_all(root.c_str());
+}
+
+// --------------------------------------------------------------------------------------------------
+// fs::remove_all vs std::filesystem::remove_all
+//
+static void make_bench_rm_tree(const fs::path& root, int count) {
+	std::vector<fs::path> leaves;
+	for (int a=0; a<20; ++a) {
+		for (int b=0; b<20; ++b) {
+			leaves.push_back(root / sFmtStr("dir%02d/sub%02d", a, b));
+		}
+	}
+	fs::create_directories(leaves);
+	for (int i=0; i<count; ++i) {
+		if (FILE* fp = fopen((leaves[i % leaves.size()] / sFmtStr("file_%06d.bin", i)).c_str(), "wb")) {
+			fputs("payload", fp);
+			fclose(fp);
+		}
+	}
+}
+
+static void bench_remove_all(int count) {
+	fs::path root = "samples_bench_rm";
+	printf("fs::remove_all (%d files in 400 directories, %u hw threads)\n", count, std::thread::hardware_concurrency());
+
+	make_bench_rm_tree(root, count);
+	{
+		fs::remove_options options;
+		options.dry_run = true;
+		bench_scope scope("fs::remove_all, dry run", count);
+		s_bench_sink = fs::remove_all(root, options).files;
+	}
+	{
+		bench_scope scope("std::filesystem::remove_all", count);
+		s_bench_sink = std::filesystem::remove_all(root.c_str());
+	}
+	for (int threads : { 1, 0 }) {
+		make_bench_rm_tree(root, count);
+		fs::remove_options options;
+		options.threads = threads;
+		bench_scope scope(threads ? "fs::remove_all, 1 thread" : "fs::remove_all, all threads", count);
+		s_bench_sink = fs::remove_all(root, options).files;
+	}
+	{
+		make_bench_rm_tree(root, count);
+		fs::remove_options options;
+		options.count_bytes = false;
+		bench_scope scope("fs::remove_all, no byte count", count);
+		s_bench_sink = fs::remove_all(root, options).files;
+	}
+}
+
+// --------------------------------------------------------------------------------------------------
+// fs::hasher throughput per isa, and fs::hash_file via pread vs mmap
+//
+static void bench_hash(int count) {
+	const size_t mem_size = 64 * 1024 * 1024;
+	std::vector<uint8_t> data(mem_size);
+	for (size_t i=0; i<mem_size; ++i) {
+		data[i] = uint8_t(i * 131 + (i >> 11));
+	}
+	const int passes = 8;
+
+	printf("fs::hasher (%d x %zu MiB in memory)\n", passes, mem_size >> 20);
+	{
+		uint64_t sum = 0;
+		bench_scope scope("std::hash<string_view> (reference)", intmax_t(mem_size) * passes, "MB/s");
+		for (int pass=0; pass<passes; ++pass) {
+			sum += std::hash<std::string_view>()(std::string_view((const char*)data.data(), mem_size));
+		}
+		s_bench_sink = sum;
+	}
+	using fs::simd::isa;
+	auto orig_isa = fs::simd::ActiveIsa();
+	for (auto algorithm : { fs::hash_algorithm::xxh3, fs::hash_algorithm::crc32c }) {
+		for (auto which : { isa::scalar, isa::sse2, isa::avx2, isa::neon }) {
+			if (!fs::simd::ForceIsa(which)) continue;
+			if (algorithm == fs::hash_algorithm::crc32c && which == isa::avx2) continue;		// same kernel as sse2
+			uint64_t sum = 0;
+			bool crc_insn = (algorithm == fs::hash_algorithm::crc32c && which != isa::scalar);
+			auto label = sFmtStr("%s, %s", fs::hash_algorithm_name(algorithm), crc_insn ? "sse4.2 crc32" : fs::simd::IsaName(which));
+			bench_scope scope(label, intmax_t(mem_size) * passes, "MB/s");
+			for (int pass=0; pass<passes; ++pass) {
+				sum += fs::hasher::hash(algorithm, data.data(), mem_size);
+			}
+			s_bench_sink = sum;
+		}
+	}
+	fs::simd::ForceIsa(orig_isa);
+
+	fs::path file = "samples_bench_hash.bin";
+	{
+		fs::file_writer writer(file);
+		for (int i=0; i<count; ++i) {
+			writer.write(data.data() + (size_t(i) << 20) % mem_size, 1024 * 1024);
+		}
+	}
+	const intmax_t total = intmax_t(count) * 1024 * 1024;
+	printf("fs::hash_file (%d MiB, page cache warm)\n", count);
+	for (bool mapped : { false, true }) {
+		fs::hash_options options;
+		options.mmap_threshold = mapped ? 0 : INTMAX_MAX;
+		bench_scope scope(mapped ? "hash_file xxh3, mmap" : "hash_file xxh3, pread", total, "MB/s");
+		s_bench_sink = fs::hash_file(file, options).value;
+	}
+	{
+		fs::hash_options options;
+		options.partial_bytes = 64 * 1024;
+		bench_scope scope("hash_file xxh3, partial 64K", 1, "Mfiles/s");
+		s_bench_sink = fs::hash_file(file, options).value;
+	}
+	fs::remove(file);
+}
+
+// --------------------------------------------------------------------------------------------------
+// fs::snapshot load vs re-walking and re-stat'ing the tree
+//
+static void bench_snapshot(int count) {
+	fs::path root = "samples_bench_snap";
+	fs::path file = "samples_bench_snap.bin";
+	printf("fs::snapshot (%d files in 400 directories, %u hw threads)\n", count, std::thread::hardware_concurrency());
+
+	make_bench_rm_tree(root, count);
+	{
+		std::atomic<intmax_t> bytes = { 0 };
+		bench_scope scope("fs::walk + fs::status per entry", count);
+		fs::walk(root, [&](const fs::walk_entry& entry) {
+			bytes += fs::status(fs::path(entry.path)).st_size;
+		});
+		s_bench_sink = bytes;
+	}
+	{
+		bench_scope scope("fs::write_snapshot", count);
+		s_bench_sink = fs::write_snapshot(root, file).entries;
+	}
+	for (bool verify : { false, true }) {
+		bench_scope scope(verify ? "fs::snapshot open, verified" : "fs::snapshot open", count);
+		fs::snapshot snap(file, verify);
+		s_bench_sink = snap.size();
+	}
+	{
+		bench_scope scope("fs::snapshot open + read every entry", count);
+		fs::snapshot snap(file);
+		intmax_t bytes = 0;
+		for (size_t i=0; i<snap.size(); ++i) {
+			bytes += snap[i].info.st_size;
+		}
+		s_bench_sink = bytes;
+	}
+	{
+		fs::snapshot snap(file);
+		const int lookups = 100000;
+		intmax_t found = 0;
+		bench_scope scope("fs::snapshot::find", lookups);
+		for (int i=0; i<lookups; ++i) {
+			found += snap.find(sFmtStr("dir%02d/sub%02d/file_%06d.bin", (i % 400) / 20, i % 20, i % count)) != fs::snapshot::npos;
+		}
+		s_bench_sink = found;
+	}
+	printf("    snapshot file: %jd bytes\n", fs::file_size(file));
+	fs::remove(file);
+	fs::remove_all(root);
+}
+
+// --------------------------------------------------------------------------------------------------
+// fs::diff vs a serial status() loop over the snapshot
+//
+static void bench_diff(int count) {
+	fs::path root = "samples_bench_diff";
+	fs::path file = "samples_bench_diff.bin";
+	printf("fs::diff (%d files in 400 directories, %u hw threads)\n", count, std::thread::hardware_concurrency());
+
+	make_bench_rm_tree(root, count);
+#if PLATFORM_POSIX
+	// diff distrusts timestamps from the second the snapshot was taken in.
+	struct timespec past[2] = { { time(nullptr) - 100, 0 }, { time(nullptr) - 100, 0 } };
+	fs::walk(root, [&](const fs::walk_entry& entry) {
+		utimensat(AT_FDCWD, std::string(entry.path.uni_string()).c_str(), past, AT_SYMLINK_NOFOLLOW);
+	});
+	utimensat(AT_FDCWD, root.c_str(), past, 0);
+#endif
+	fs::write_snapshot(root, file);
+	fs::snapshot snap(file);
+
+	{
+		bench_scope scope("serial fs::status loop", count);
+		intmax_t changed = 0;
+		std::string fullpath;
+		for (size_t i=1; i<snap.size(); ++i) {
+			fullpath.assign(root.uni_string());
+			fullpath += '/';
+			fullpath += snap.relative(i);
+			changed += (fs::status(fs::path(fullpath.c_str())) != snap[i].info);
+		}
+		s_bench_sink = changed;
+	}
+	for (int threads : { 1, 0 }) {
+		fs::diff_options options;
+		options.threads = threads;
+		bench_scope scope(threads ? "fs::diff, 1 thread" : "fs::diff, all threads", count);
+		s_bench_sink = fs::diff(snap, options).changes.size();
+	}
+
+	// new files in a quarter of the directories, which then have to be read.
+	for (int i=0; i<100; ++i) {
+		if (FILE* fp = fopen((root / sFmtStr("dir%02d/sub%02d/added_%03d.bin", i % 20, (i / 20) % 20, i)).c_str(), "wb")) {
+			fclose(fp);
+		}
+	}
+	{
+		bench_scope scope("fs::diff, 100 files added", count);
+		auto result = fs::diff(snap);
+		s_bench_sink = result.changes.size();
+		printf("    changes=%zu listed=%jd pruned=%jd\n", result.changes.size(), result.dirs_listed, result.dirs_pruned);
+	}
+	snap.close();
+	fs::remove(file);
+	fs::remove_all(root);
+}
+
+// --------------------------------------------------------------------------------------------------
+struct bench_entry {
+	const char* name;
+	void (*func)(int count);
+	int count;
+};
+
+static const bench_entry s_benchmarks[] = {
+	{ "path_native",	bench_path_native,	1000000 },
+	{ "path_list",		bench_path_list,	1000000 },
+	{ "simd_separators",	bench_simd_separators,	1000000 },
+	{ "paths_from_strings",	bench_paths_from_strings,	1000000 },
+	{ "path_builder",	bench_path_builder,	1000000 },
+	{ "stat_cache",		bench_stat_cache,	20000 },
+	{ "directory_stream",	bench_directory_stream,	20000 },
+	{ "walk",			bench_walk,			200000 },
+	{ "glob",			bench_glob,			1000000 },
+	{ "mapped_file",	bench_mapped_file,	2048 },
+	{ "async_io",		bench_async_io,		200000 },
+	{ "read_ranges",	bench_read_ranges,	100000 },
+	{ "file_io",		bench_file_io,		1024 },
+	{ "copy",			bench_copy,			1024 },
+	{ "create_directories",	bench_create_directories,	20000 },
+	{ "remove_all",		bench_remove_all,	100000 },
+	{ "hash",			bench_hash,			1024 },
+	{ "snapshot",		bench_snapshot,		200000 },
+	{ "diff",			bench_diff,			200000 },
+};
+
+int bench_main(int argc, char** argv) {
+	const char* filter = (argc > 0) ? argv[0] : nullptr;
+	for (const auto& bench : s_benchmarks) {
+		if (filter && strcasecmp(filter, bench.name) != 0) continue;
+		bench.func(bench.count);
+		printf("\n");
+	}
+	return 0;
+}
@@ -2,10 +2,35 @@
 #include "StringUtil.h"
 #include "StringTokenizer.h"
 #include "fs.h"
+#include "fs_simd.h"
+#include "fs_stat_cache.h"
+#include "fs_directory.h"
+#include "fs_walk.h"
+#include "fs_glob.h"
+#include "fs_watcher.h"
+#include "fs_mapped_file.h"
+#include "fs_async_io.h"
+#include "fs_read_batch.h"
+#include "fs_file_io.h"
+#include "fs_copy.h"
+#include "fs_remove.h"
+#include "fs_hash.h"
+#include "fs_snapshot.h"
+#include "fs_diff.h"
 
 #include "msw_app_console_init.h"
 #include "StringUtil.h"
 
+#include <unordered_set>
+#include <algorithm>
+#include <mutex>
+#include <map>
+#include <thread>
+
+#if PLATFORM_POSIX
+#   include <sys/resource.h>
+#endif
+
 static const char* parse_inputs[] = {
     "",
     "--lvalue=rvalue1",
@@ -82,6 +107,37 @@ static const char* path_rel_inputs[] = {
     "./ex why/zee"              ,
 };
 
+static const char* path_normal_inputs[] = {
+    "."                         ,
+    "./"                        ,
+    "a/.."                      ,
+    "a/../.."                   ,
+    "../../x/./y/.."            ,
+    "a//b///c/"                 ,
+    "/c/.."                     ,
+    "/c/../../d"                ,
+    "/c/./one/./two/"           ,
+    "/c/one/../../two"          ,
+    "/dev/null/.."              ,
+    "//server/share/../x"       ,
+    "umd:/a/../../b"            ,
+    "usb0:a/./b"                ,
+};
+
+extern int bench_main(int argc, char** argv);
+
+// creates or truncates file, with the given content or with length bytes of filler.
+static void write_file(const fs::path& file, std::string_view content) {
+    if (FILE* fp = fopen(file.c_str(), "wb")) {
+        fwrite(content.data(), 1, content.length(), fp);
+        fclose(fp);
+    }
+}
+
+static void write_file(const fs::path& file, size_t length) {
+    write_file(file, std::string(length, 'x'));
+}
+
 int main(int argc, char** argv) {
 
     msw_InitAppForConsole("samples");
@@ -91,6 +147,10 @@ int main(int argc, char** argv) {
         exit(0);
     }
 
+    if (argc > 1 && strcasecmp(argv[1], "bench") == 0) {
+        return bench_main(argc-2, argv+2);
+    }
+
     printf("TEST:TOKENIZER:SINGLINE\n");
     for(const auto* item : parse_inputs) {
         auto tok = Tokenizer(item);
@@ -181,6 +241,1229 @@ int main(int argc, char** argv) {
         }
     }
     printf("--------------------------------------\n");
+    printf("TEST:FILESYSTEM:PATH_VIEW\n");
+    for(const auto* item : path_abs_inputs) {
+        auto fspath = (fs::path)item;
+        auto view   = fs::path_view(fspath);
+        printf("input    = %s\n", item);
+        printf("parent   = %s\n", std::string(view.parent_path().uni_string()).c_str());
+        printf("filename = %s\n", std::string(view.filename()).c_str());
+        printf("ext      = %s\n", std::string(view.extension()).c_str());
+        printf("abs/dev  = %d/%d\n", view.is_absolute(), view.is_device());
+        printf("equal    = %d\n", (fs::path)item == fspath && view == fs::path_view(fs::path(view)));
+        printf("\n");
+    }
+    printf("--------------------------------------\n");
+    printf("TEST:FILESYSTEM:PATH_LIST\n");
+    {
+        std::vector<const char*> inputs;
+        inputs.insert(inputs.end(), std::begin(path_abs_inputs), std::end(path_abs_inputs));
+        inputs.insert(inputs.end(), std::begin(path_rel_inputs), std::end(path_rel_inputs));
+
+        fs::path_list list;
+        for(const auto* item : inputs) {
+            list.push_back_raw(item);
+        }
+
+        // self-referencing insert must survive reallocation of the list storage.
+        list.push_back(list[1]);
+        inputs.push_back(inputs[1]);
+
+        int idx = 0;
+        for(const auto& view : list) {
+            printf("%-28s -> %-28s match=%d\n", inputs[idx], list.uni_c_str(idx), view == fs::path(inputs[idx]).view());
+            ++idx;
+        }
+    }
+    printf("--------------------------------------\n");
+    printf("TEST:FILESYSTEM:PATH_HASH\n");
+    {
+        std::unordered_set<fs::path, fs::path_hash_nocase, fs::path_equal_nocase> unique;
+        for(const auto* item : path_abs_inputs) {
+            unique.insert(item);
+            unique.insert(StringUtil::toUpper(item));
+        }
+        printf("unique = %d\n", (int)unique.size());
+        for(const auto* item : path_abs_inputs) {
+            auto fspath = (fs::path)StringUtil::toUpper(item);
+            printf("%-28s hash_match=%d found=%d\n", item,
+                fspath.hash() == fs::path(item).view().hash(),
+                unique.count(fspath) == 1
+            );
+        }
+    }
+    printf("--------------------------------------\n");
+    printf("TEST:FILESYSTEM:BATCH\n");
+    {
+        std::vector<const char*> inputs;
+        inputs.insert(inputs.end(), std::begin(path_abs_inputs), std::end(path_abs_inputs));
+        inputs.insert(inputs.end(), std::begin(path_rel_inputs), std::end(path_rel_inputs));
+        inputs.push_back("\\one\\two");
+        inputs.push_back("\\\\server\\share");
+        inputs.push_back("NUL");
+
+        fs::path_list list;
+        std::vector<fs::path_error> errors;
+        int failed = fs::PathsFromStrings(list, inputs, &errors);
+        printf("failed = %d\n", failed);
+        for (size_t i=0; i<inputs.size(); ++i) {
+            if (errors[i] != fs::path_error::none) {
+                printf("%-28s -> error: %s\n", inputs[i], fs::PathErrorString(errors[i]));
+            }
+            else {
+                printf("%-28s -> %-28s match=%d\n", inputs[i], list.uni_c_str(i), list[i] == fs::path(inputs[i]).view());
+            }
+        }
+
+        // large enough to split across threads, results must stay in input order.
+        std::vector<std::string> many;
+        for (int i=0; i<100000; ++i) {
+            many.push_back(StringUtil::Format("c:\\dir%d\\file%d.txt", i % 100, i));
+        }
+        std::vector<const char*> many_ptrs;
+        for (const auto& item : many) {
+            many_ptrs.push_back(item.c_str());
+        }
+        fs::path_list many_list;
+        fs::PathsFromStrings(many_list, many_ptrs);
+        int mismatches = 0;
+        for (size_t i=0; i<many.size(); ++i) {
+            mismatches += !(many_list[i] == fs::path(many[i]).view());
+        }
+        printf("large batch: size=%d mismatches=%d\n", (int)many_list.size(), mismatches);
+    }
+    printf("--------------------------------------\n");
+    printf("TEST:FILESYSTEM:LEXICALLY_NORMAL\n");
+    {
+        std::vector<const char*> inputs;
+        inputs.insert(inputs.end(), std::begin(path_abs_inputs), std::end(path_abs_inputs));
+        inputs.insert(inputs.end(), std::begin(path_rel_inputs), std::end(path_rel_inputs));
+        inputs.insert(inputs.end(), std::begin(path_normal_inputs), std::end(path_normal_inputs));
+        for(const auto* item : inputs) {
+            auto normal = fs::path(item).lexically_normal();
+            printf("%-28s -> %-28s abs=%s\n", item, normal.uni_string().c_str(),
+                fs::lexically_absolute(item, "/c/base/dir").uni_string().c_str()
+            );
+        }
+    }
+    printf("--------------------------------------\n");
+    printf("TEST:FILESYSTEM:COMPONENTS\n");
+    {
+        std::vector<const char*> inputs;
+        inputs.insert(inputs.end(), std::begin(path_abs_inputs), std::end(path_abs_inputs));
+        inputs.insert(inputs.end(), std::begin(path_rel_inputs), std::end(path_rel_inputs));
+        inputs.insert(inputs.end(), std::begin(path_normal_inputs), std::end(path_normal_inputs));
+        for(const auto* item : inputs) {
+            fs::path src = item;
+            std::string fwd, rev;
+            for (auto comp : src) {
+                fwd += "[" + std::string(comp) + "]";
+            }
+            for (auto it = src.rbegin(); it != src.rend(); ++it) {
+                rev = "[" + std::string(*it) + "]" + rev;
+            }
+            printf("%-28s root=%-10s %s%s\n", src.uni_string().c_str(), std::string(src.root_name()).c_str(),
+                fwd.c_str(), (fwd == rev) ? "" : "  REVERSE MISMATCH"
+            );
+        }
+    }
+    printf("--------------------------------------\n");
+    printf("TEST:FILESYSTEM:PATH_BUILDER\n");
+    {
+        // builder output must match chained operator/ for every combination.
+        const char* comps[] = { "one", "two\\three", "c:\\root", "/d/abs", "", "./rel/", "../up" };
+        fs::path base = "/c/base";
+        for(const auto* a : comps) {
+            for(const auto* b : comps) {
+                fs::path chained = base / a / b / "file.txt";
+                fs::path built   = fs::path_builder(base) / a / b / "file.txt";
+                printf("%-12s %-12s -> %-28s%s\n", a, b, built.uni_string().c_str(),
+                    (chained == built && chained.uni_string() == built.uni_string()) ? "" : "  MISMATCH"
+                );
+            }
+        }
+
+        fs::path_builder longchain(base);
+        fs::path expected = base;
+        for (int i=0; i<20; ++i) {
+            longchain / path_rel_inputs[i % std::size(path_rel_inputs)];
+            expected /= path_rel_inputs[i % std::size(path_rel_inputs)];
+        }
+        printf("long chain %s\n", (longchain.build().uni_string() == expected.uni_string()) ? "matches" : "MISMATCH");
+    }
+    printf("--------------------------------------\n");
+    printf("TEST:FILESYSTEM:PATH_LITERALS\n");
+    {
+        using namespace fs::literals;
+        static constexpr auto cfg_dir = "c:\\data\\cfg\\"_upath;
+        static_assert(cfg_dir.uni_string() == "/c/data/cfg", "_upath must normalize at compile time");
+        static_assert("NUL"_upath.uni_string() == "/dev/null", "");
+        static_assert("D:"_upath.uni_string() == "/d", "");
+        static_assert("/c/already/universal"_upath.uni_string() == "/c/already/universal", "");
+
+        fs::path cfg = cfg_dir;
+        printf("literal: %s (%s)\n", cfg.uni_string().c_str(), (cfg == "c:\\data\\cfg") ? "match" : "MISMATCH");
+
+        // the constexpr routine must agree with the runtime one on everything, errors included.
+        std::vector<const char*> inputs;
+        inputs.insert(inputs.end(), std::begin(path_abs_inputs), std::end(path_abs_inputs));
+        inputs.insert(inputs.end(), std::begin(path_rel_inputs), std::end(path_rel_inputs));
+        inputs.insert(inputs.end(), { "\\", "\\rooted", "\\\\server\\share", "c:", "c:rel", "NUL", "CON" });
+        int mismatches = 0;
+        for(const auto* item : inputs) {
+            char rt_buf[300], ce_buf[300];
+            fs::path_error rt_err, ce_err;
+            auto rt_len = fs::PathFromString(rt_buf, item, &rt_err);
+            auto ce_len = fs::PathFromStringConstexpr(ce_buf, item, &ce_err);
+            if (rt_err != ce_err || std::string_view(rt_buf, rt_len) != std::string_view(ce_buf, ce_len)) {
+                printf("MISMATCH: %s\n", item);
+                ++mismatches;
+            }
+        }
+        printf("constexpr vs runtime: %d mismatches\n", mismatches);
+    }
+    printf("--------------------------------------\n");
+    printf("TEST:FILESYSTEM:STATUS\n");
+    {
+        fs::path dir  = "samples_scratch_status";
+        fs::path file = dir / "file.bin";
+        fs::create_directory(dir);
+        if (FILE* fp = fopen(file.c_str(), "wb")) {
+            fwrite("0123456789", 1, 10, fp);
+            fclose(fp);
+        }
+
+        auto st = fs::status(file);
+        printf("file:    exists=%d file=%d dir=%d size=%jd\n", st.Exists(), st.IsFile(), st.IsDir(), st.st_size);
+        printf("dir:     exists=%d dir=%d file_size=%jd\n", fs::exists(dir), fs::is_directory(dir), fs::file_size(dir));
+        printf("missing: exists=%d size=%jd\n", fs::exists(dir / "missing"), fs::file_size(dir / "missing"));
+        printf("device:  exists=%d\n", fs::exists("NUL"));
+#if PLATFORM_POSIX
+        // file type bits overlap: a socket has S_IFREG's bit set and a block device S_IFDIR's.
+        CStatInfo sock  = { uint32_t(S_IFSOCK | 0644), 0, 0, 0, 0 };
+        CStatInfo block = { uint32_t(S_IFBLK  | 0660), 0, 0, 0, 0 };
+        printf("types:   socket file=%d dir=%d, block device file=%d dir=%d\n", sock.IsFile(), sock.IsDir(), block.IsFile(), block.IsDir());
+#endif
+
+        fs::stat_cache cache;
+        for (int i=0; i<3; ++i) {
+            cache.exists(file);
+            cache.exists(dir / "missing");
+        }
+        printf("cache:   hits=%jd misses=%jd size=%zu\n", cache.hits(), cache.misses(), cache.size());
+
+        fs::remove(file);
+        printf("removed: cached exists=%d\n", cache.exists(file));
+        cache.invalidate(file);
+        printf("removed: exists after invalidate(path)=%d\n", cache.exists(file));
+        cache.invalidate();
+        cache.exists(dir);
+        printf("cache:   hits=%jd misses=%jd generation=%ju\n", cache.hits(), cache.misses(), uintmax_t(cache.generation()));
+
+        fs::remove(dir);
+    }
+    printf("--------------------------------------\n");
+    printf("TEST:FILESYSTEM:DIRECTORY_STREAM\n");
+    {
+        fs::path dir = "samples_scratch_dir";
+        fs::create_directory(dir / "subdir");
+        for (int i=0; i<3; ++i) {
+            if (FILE* fp = fopen((dir / sFmtStr("file%d.txt", i)).c_str(), "wb")) {
+                fwrite("abcdef", 1, i * 2, fp);
+                fclose(fp);
+            }
+        }
+
+        // listing order is filesystem-defined, sort for a stable log.
+        std::vector<std::string> lines;
+        fs::directory_stream stream(dir);
+        for (const auto& entry : stream) {
+            auto st = stream.status(entry);
+            lines.push_back(sFmtStr("%-10s dir=%d regular=%d size=%jd", std::string(entry.name).c_str(),
+                (entry.type == fs::file_type::unknown) ? st.IsDir()  : entry.is_directory(),
+                (entry.type == fs::file_type::unknown) ? st.IsFile() : entry.is_regular(),
+                st.IsFile() ? st.st_size : 0
+            ));
+        }
+        std::sort(lines.begin(), lines.end());
+        for (const auto& line : lines) {
+            printf("%s\n", line.c_str());
+        }
+
+        fs::path_list list;
+        fs::directory_iterator(list, dir);
+        std::vector<std::string> listed;
+        for (auto item : list) {
+            listed.push_back(std::string(item.uni_string()));
+        }
+        std::sort(listed.begin(), listed.end());
+        for (const auto& item : listed) {
+            printf("listed: %s\n", item.c_str());
+        }
+
+        fs::directory_stream missing(dir / "missing");
+        printf("missing: open=%d error=%s\n", missing.is_open(), missing.error() ? "yes" : "no");
+
+        for (const auto& item : listed) {
+            fs::remove(item.c_str());
+        }
+        fs::remove(dir);
+    }
+    printf("--------------------------------------\n");
+    printf("TEST:FILESYSTEM:WALK\n");
+    {
+        fs::path root = "samples_scratch_walk";
+        const char* files[] = { "a/one.txt", "a/b/two.cfg", "a/b/c/three.txt", "d/four.cfg", "five.txt" };
+        fs::create_directory(root / "a/b/c");
+        fs::create_directory(root / "d");
+        for (const auto* file : files) {
+            if (FILE* fp = fopen((root / file).c_str(), "wb")) fclose(fp);
+        }
+#if PLATFORM_POSIX
+        // loops back to the root: followed once, then recognized as already visited.
+        symlink("..", (root / "d/loop").c_str());
+#endif
+
+        auto print_walk = [&](const char* label, const fs::walk_options& options) {
+            std::mutex mutex;
+            std::vector<std::string> seen;
+            auto stats = fs::walk(root, [&](const fs::walk_entry& entry) {
+                std::lock_guard<std::mutex> lock(mutex);
+                seen.push_back(sFmtStr("%d %s%s", entry.depth, std::string(entry.path.uni_string()).c_str(),
+                    entry.is_directory() ? "/" : ""
+                ));
+            }, options);
+            std::sort(seen.begin(), seen.end());
+            printf("%s: dirs=%jd entries=%jd errors=%jd\n", label, stats.dirs, stats.entries, stats.errors);
+            for (const auto& line : seen) {
+                printf("    %s\n", line.c_str());
+            }
+        };
+
+        fs::walk_options options;
+        options.threads = 4;
+        print_walk("all", options);
+
+        options.max_depth = 2;
+        print_walk("max_depth=2", options);
+
+        options.max_depth = -1;
+        options.filter  = [](const fs::walk_entry& entry) { return StringUtil::EndsWith(std::string(entry.name), ".cfg"); };
+        options.descend = [](const fs::walk_entry& entry) { return entry.name != "b"; };
+        print_walk("*.cfg, prune b", options);
+
+#if PLATFORM_POSIX
+        options = {};
+        options.symlinks = fs::symlink_policy::follow;
+        options.filter   = [](const fs::walk_entry& entry) { return StringUtil::EndsWith(std::string(entry.name), ".cfg"); };
+        print_walk("follow symlinks", options);
+
+        // a directory swapped for a symlink between being listed and being opened isn't followed.
+        {
+            std::string swap = "samples_scratch_walk_swap";
+            fs::create_directories(std::vector<fs::path> { (swap + "/dir").c_str(), (swap + "/target").c_str() });
+            if (FILE* fp = fopen((swap + "/target/secret.txt").c_str(), "wb")) fclose(fp);
+
+            fs::walk_options swap_opts;
+            swap_opts.threads = 1;
+            bool descended = false;
+            auto swapped = fs::walk(swap.c_str(), [&](const fs::walk_entry& entry) {
+                if (entry.relative == "dir") {
+                    rename((swap + "/dir").c_str(), (swap + "/moved").c_str());
+                    symlink("target", (swap + "/dir").c_str());
+                }
+                descended |= (entry.relative == "dir/secret.txt");
+            }, swap_opts);
+            printf("swapped for a symlink: descended=%d errors=%jd\n", descended, swapped.errors);
+            fs::remove_all(swap.c_str());
+        }
+#endif
+
+        fs::path_list collected;
+        auto stats = fs::walk(root, collected);
+        printf("collected: %zu paths, %jd entries\n", collected.size(), stats.entries);
+
+        std::vector<std::string> doomed;
+        for (auto item : collected) {
+            doomed.push_back(std::string(item.uni_string()));
+        }
+        std::sort(doomed.rbegin(), doomed.rend());      // children before parents
+        for (const auto& item : doomed) {
+            fs::remove(item.c_str());
+        }
+        fs::remove(root);
+    }
+    printf("--------------------------------------\n");
+    printf("TEST:FILESYSTEM:GLOB\n");
+    {
+        const char* patterns[] = {
+            "**/*.cfg", "assets/*/tex_??.png", "*.txt", "a/**/c/*", "**", "[a-c]*/[!x]*.bin", "/c/data/*", "x[*.bin",
+        };
+        const char* paths[] = {
+            "x.cfg", "a/b/x.cfg", "a/b/x.CFG", "assets/ui/tex_01.png", "assets/ui/tex_001.png", "assets/ui/sub/tex_01.png",
+            "readme.txt", "docs/readme.txt", "a/c/file", "a/b/b/c/file", "a/c", "b/y.bin", "b/x.bin", "d/y.bin",
+            "/c/data/file", "/c/data/sub/file", "x[.bin",
+        };
+
+        for (auto cs : { fs::glob_case::sensitive, fs::glob_case::insensitive }) {
+            for (const auto* pattern : patterns) {
+                fs::glob_pattern glob(pattern, cs);
+                std::string matched;
+                for (const auto* item : paths) {
+                    if (glob.match(item)) {
+                        matched += std::string(matched.empty() ? "" : ", ") + item;
+                    }
+                }
+                printf("%-20s %s prefix='%s' matches: %s\n", pattern, (cs == fs::glob_case::insensitive) ? "nocase" : "      ",
+                    std::string(glob.literal_prefix()).c_str(), matched.c_str()
+                );
+            }
+        }
+
+        fs::glob_pattern glob("assets/*/tex_??.png");
+        for (const auto* dir : { "", "assets", "assets/ui", "assets/ui/sub", "other", "assets2" }) {
+            printf("may_contain('%s') = %d\n", dir, glob.may_contain(dir));
+        }
+    }
+    printf("--------------------------------------\n");
+    printf("TEST:FILESYSTEM:WATCHER\n");
+    if (!fs::watcher::is_supported()) {
+        printf("not supported on this platform\n");
+    }
+    else {
+        fs::path root = "samples_scratch_watch";
+        fs::create_directory(root);
+        write_file(root / "app.cfg", "key=one\n");
+
+        fs::stat_cache cache;
+        printf("cached exists(new.txt) before: %d\n", cache.exists(root / "new.txt"));
+
+        std::mutex mutex;
+        std::map<std::string, fs::change_kind> merged;
+        int batches = 0;
+
+        fs::watcher watcher;
+        watcher.attach_stat_cache(&cache);
+        watcher.watch(root);
+        watcher.reload_config(root / "app.cfg", [](const std::string& key, const std::string& value) {
+            printf("config: %s=%s\n", key.c_str(), value.c_str());
+        });
+
+        fs::watcher_options options;
+        options.debounce = std::chrono::milliseconds(200);
+        watcher.start([&](const fs::change_set& changes) {
+            std::lock_guard<std::mutex> lock(mutex);
+            ++batches;
+            for (const auto& change : changes.changes) {
+                merged[std::string(change.path.uni_string())] = change.kind;
+            }
+        }, options);
+
+        write_file(root / "new.txt", "hello");
+        write_file(root / "new.txt", "hello again");
+        fs::create_directory(root / "sub");
+        write_file(root / "sub/inner.txt", "x");
+        write_file(root / "temp.txt", "x");
+        fs::remove(root / "temp.txt");
+        write_file(root / "app.cfg", "key=two\n");
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(800));
+
+        // a directory moved out of the tree must stop reporting under its old path.
+        fs::path moved = "samples_scratch_watch_moved";
+        rename((root / "sub").c_str(), moved.c_str());
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        write_file(moved / "after.txt", "x");
+        std::this_thread::sleep_for(std::chrono::milliseconds(500));
+        watcher.stop();
+
+        const char* kind_names[] = { "created", "modified", "removed" };
+        printf("batches delivered: %s\n", batches ? "yes" : "no");
+        for (const auto& item : merged) {
+            printf("    %-8s %s\n", kind_names[int(item.second)], item.first.c_str());
+        }
+        printf("cached exists(new.txt) after: %d\n", cache.exists(root / "new.txt"));
+
+        fs::remove(moved / "after.txt");
+        fs::remove(moved / "inner.txt");
+        fs::remove(moved);
+        fs::remove(root / "new.txt");
+        fs::remove(root / "app.cfg");
+        fs::remove(root);
+    }
+    printf("--------------------------------------\n");
+    printf("TEST:FILESYSTEM:MAPPED_FILE\n");
+    {
+        // spans a few granules so that windows at unaligned offsets straddle a mapping boundary.
+        fs::path file = "samples_scratch_mapped.bin";
+        auto gran = fs::mapped_file::granularity();
+        std::string content(gran * 3 + 100, 0);
+        for (size_t i=0; i<content.length(); ++i) {
+            content[i] = "abcdefghijklmnopqrstuvwxyz012345"[i % 32];     // period divides any granularity
+        }
+        if (FILE* fp = fopen(file.c_str(), "wb")) {
+            fwrite(content.data(), 1, content.length(), fp);
+            fclose(fp);
+        }
+
+        {
+            fs::mapped_file mapped(file);
+            printf("whole: mapped=%d size_ok=%d content_ok=%d\n", mapped.is_mapped(),
+                mapped.size() == content.length(), mapped.span().view() == content
+            );
+            printf("advise sequential=%d willneed=%d\n",
+                mapped.advise(fs::map_advice::sequential), mapped.advise(fs::map_advice::willneed, 100, gran)
+            );
+
+            struct { const char* label; x_off_t offset; } windows[] = {
+                { "0",          0                               },
+                { "5",          5                               },
+                { "gran-3",     x_off_t(gran) - 3               },
+                { "3*gran+90",  x_off_t(gran * 3) + 90          },
+                { "eof",        x_off_t(content.length())       },
+            };
+            for (const auto& window : windows) {
+                bool ok = mapped.map(window.offset, 16);
+                printf("window @%-10s ok=%d size=%zu bytes='%s'\n", window.label, ok, mapped.size(),
+                    std::string(mapped.span().view()).c_str()
+                );
+            }
+            printf("window past eof: ok=%d\n", mapped.map(x_off_t(content.length()) + 1));
+        }
+
+        {
+            fs::mapped_file mapped(file, fs::map_mode::read_write);
+            auto span = mapped.span();
+            memcpy(span.data + gran - 2, "XYZW", 4);
+            printf("read_write: flush=%d\n", mapped.flush());
+        }
+        if (FILE* fp = fopen(file.c_str(), "rb")) {
+            char buf[7] = {};
+            fseek(fp, long(gran) - 3, SEEK_SET);
+            fread(buf, 1, 6, fp);
+            fclose(fp);
+            printf("after write: '%s'\n", buf);
+        }
+
+        fs::remove(file);
+        if (FILE* fp = fopen(file.c_str(), "wb")) fclose(fp);
+        {
+            fs::mapped_file mapped(file);
+            printf("empty: open=%d mapped=%d size=%zu\n", mapped.is_open(), mapped.is_mapped(), mapped.size());
+        }
+        fs::remove(file);
+
+        fs::mapped_file missing(file);
+        printf("missing: open=%d mapped=%d error_set=%d\n", missing.is_open(), missing.is_mapped(), missing.error() != 0);
+    }
+    printf("--------------------------------------\n");
+    printf("TEST:FILESYSTEM:ASYNC_IO\n");
+    {
+        // the same requests through each backend; which one the default engine picks is host-dependent.
+        fs::path file = "samples_scratch_async.bin";
+        std::string content(64 * 1024, 0);
+        for (size_t i=0; i<content.length(); ++i) {
+            content[i] = char(i * 7 + (i >> 8));
+        }
+        if (FILE* fp = fopen(file.c_str(), "wb")) {
+            fwrite(content.data(), 1, content.length(), fp);
+            fclose(fp);
+        }
+
+        for (bool force_pool : { false, true }) {
+            fs::io_engine_options options;
+            options.queue_depth       = 8;
+            options.force_thread_pool = force_pool;
+            fs::io_engine engine(options);
+
+            int fd = posix_open(file.c_str(), O_RDWR, 0);
+            const int nreads = 64;
+            std::vector<std::string> bufs(nreads, std::string(300, 0));
+            std::vector<intmax_t> results(nreads, -1);
+            auto on_complete = [&](const fs::io_completion& completion) {
+                results[completion.user_data] = completion.result;
+            };
+
+            bool full_seen = false;
+            for (int i=0; i<nreads; ++i) {
+                // the last read straddles the end of the file, and completes short.
+                x_off_t offset = (i == nreads - 1) ? x_off_t(content.length()) - 100 : x_off_t(i) * 997;
+                fs::io_request req = { fd, offset, &bufs[i][0], bufs[i].length(), fs::io_op::read, uintptr_t(i) };
+                while (!engine.queue(req)) {
+                    full_seen = true;
+                    engine.drain(on_complete, 1);
+                }
+            }
+            engine.drain(on_complete, engine.outstanding());
+
+            int mismatches = 0;
+            for (int i=0; i<nreads; ++i) {
+                x_off_t offset = (i == nreads - 1) ? x_off_t(content.length()) - 100 : x_off_t(i) * 997;
+                auto expected = content.substr(size_t(offset), 300);
+                if (results[i] != intmax_t(expected.length()) || bufs[i].compare(0, expected.length(), expected) != 0) {
+                    ++mismatches;
+                }
+            }
+
+            char patch[] = "patched";
+            engine.queue({ fd, 1000, patch, 7, fs::io_op::write, 0 });
+            fs::io_completion completion = {};
+            auto got = engine.poll(&completion, 1, 1);
+            char readback[8] = {};
+            posix_pread(fd, readback, 7, 1000);
+            posix_close(fd);
+            content.replace(1000, 7, patch);
+
+            printf("%s: reads=%d mismatches=%d queue_full_seen=%d short_read=%jd write=%zu/%jd readback='%s' outstanding=%zu\n",
+                force_pool ? "thread_pool" : "default    ", nreads, mismatches, full_seen, results[nreads - 1],
+                got, completion.result, readback, engine.outstanding()
+            );
+        }
+        fs::remove(file);
+    }
+    printf("--------------------------------------\n");
+    printf("TEST:FILESYSTEM:READ_BATCH\n");
+    {
+        fs::path file = "samples_scratch_batch.bin";
+        std::string content;
+        for (int i=0; i<4000; ++i) {
+            content += char('A' + (i % 26));
+        }
+        if (FILE* fp = fopen(file.c_str(), "wb")) {
+            fwrite(content.data(), 1, content.length(), fp);
+            fclose(fp);
+        }
+
+        struct { x_off_t offset; size_t length; } requests[] = {
+            { 500, 10 }, { 0, 5 }, { 5, 5 }, { 20, 4 }, { 502, 6 }, { 500, 10 },     // out of order, adjacent, gap, overlapping, duplicate
+            { 3000, 8 }, { 3995, 10 }, { 5000, 4 }, { 100, 0 },                       // far apart, straddling eof, past eof, empty
+        };
+        const size_t count = sizeof(requests) / sizeof(requests[0]);
+        std::vector<std::string> bufs(count);
+        std::vector<fs::read_range> ranges(count);
+        for (size_t i=0; i<count; ++i) {
+            bufs[i].assign(requests[i].length, '.');
+            ranges[i] = { requests[i].offset, requests[i].length, &bufs[i][0] };
+        }
+
+        fs::read_batch_options options;
+        options.max_gap = 64;
+        int fd = posix_open(file.c_str(), O_RDONLY, 0);
+        auto stats = fs::read_ranges(fd, ranges.data(), count, options);
+        posix_close(fd);
+
+        for (size_t i=0; i<count; ++i) {
+            auto expected = (size_t(requests[i].offset) < content.length()) ? content.substr(size_t(requests[i].offset), requests[i].length) : "";
+            printf("  @%-5jd len=%-3zu result=%-3jd '%s' %s\n", intmax_t(requests[i].offset), requests[i].length, ranges[i].result,
+                bufs[i].c_str(), (bufs[i].compare(0, expected.length(), expected) == 0) ? "ok" : "MISMATCH"
+            );
+        }
+        printf("runs=%jd syscalls=%jd gap_bytes=%jd\n", stats.runs, stats.syscalls, stats.gap_bytes);
+        fs::remove(file);
+    }
+    printf("--------------------------------------\n");
+    printf("TEST:FILESYSTEM:FILE_IO\n");
+    {
+        // odd-sized writes and reads against small buffers, so every boundary case gets crossed:
+        // partial buffers, writes larger than the buffer, direct mode's unaligned tail.
+        fs::path file = "samples_scratch_file_io.bin";
+        std::string content;
+        for (int i=0; i<50000; ++i) {
+            content += char('a' + (i * 7 % 26));
+        }
+
+        for (bool direct : { false, true }) {
+            fs::file_io_options options;
+            options.buffer_size = 8192;
+            options.direct      = direct;
+
+            fs::file_writer writer(file, options);
+            size_t pos = 0;
+            for (size_t chunk : { 1, 100, 4095, 9000, 3, 20000 }) {
+                writer.write(content.data() + pos, chunk);
+                pos += chunk;
+            }
+            writer.write(content.data() + pos, content.length() - pos);
+            auto written = writer.tell();
+            bool closed = writer.close();
+
+            fs::file_reader reader(file, options);
+            std::string readback(content.length(), 0);
+            pos = 0;
+            for (size_t chunk : { 7, 8185, 1, 16384, 3000 }) {
+                pos += reader.read(&readback[pos], chunk);
+            }
+            pos += reader.read(&readback[pos], content.length());     // asks for more than remains
+            bool at_eof = reader.eof();
+
+            char mid[11] = {};
+            reader.seek(12345);
+            reader.read(mid, 10);
+            std::string expected_mid = content.substr(12345, 10);
+
+            printf("%s: written=%jd closed=%d size=%jd read=%zu match=%d eof=%d seek='%s' %s error=%d\n",
+                direct ? "direct  " : "buffered", intmax_t(written), closed, intmax_t(reader.size()), pos,
+                readback == content, at_eof, mid, (expected_mid == mid) ? "ok" : "MISMATCH", reader.error()
+            );
+        }
+        fs::remove(file);
+
+        fs::file_reader missing(file);
+        printf("missing: open=%d error_set=%d read=%zu\n", missing.is_open(), missing.error() != 0, missing.read(nullptr, 0));
+    }
+    printf("--------------------------------------\n");
+    printf("TEST:FILESYSTEM:COPY\n");
+    {
+        fs::path root = "samples_scratch_copy";
+        fs::path src  = root / "src";
+        fs::path dest = root / "dest";
+
+        auto make_content = [](size_t length, int seed) {
+            std::string content;
+            for (size_t i=0; i<length; ++i) {
+                content += char('a' + ((i * 13 + seed) % 26));
+            }
+            return content;
+        };
+        auto read_file = [](const fs::path& file) {
+            std::string content;
+            if (FILE* fp = fopen(file.c_str(), "rb")) {
+                char buf[4096];
+                size_t got;
+                while ((got = fread(buf, 1, sizeof(buf), fp)) > 0) content.append(buf, got);
+                fclose(fp);
+            }
+            return content;
+        };
+
+        struct { const char* name; size_t length; } files[] = {
+            { "a.txt", 3000 }, { "empty.txt", 0 }, { "sub/b.txt", 17 }, { "sub/deep/c.bin", 300000 },
+        };
+        fs::create_directory(src / "sub/deep");
+        fs::create_directory(src / "hollow");
+        std::map<std::string, std::string> contents;
+        int seed = 0;
+        for (const auto& file : files) {
+            contents[file.name] = make_content(file.length, seed++);
+            write_file(src / file.name, contents[file.name]);
+        }
+#if PLATFORM_POSIX
+        symlink("../a.txt", (src / "sub/link").c_str());
+#endif
+
+        // which method ends up doing the copy depends on kernel and filesystem: only check that
+        // nothing earlier than asked for was used.
+        fs::path single = root / "single.bin";
+        for (auto first : { fs::copy_method::reflink, fs::copy_method::copy_file_range, fs::copy_method::sendfile, fs::copy_method::read_write }) {
+            fs::copy_options options;
+            options.first_method = first;
+            auto result = fs::copy_file(src / "sub/deep/c.bin", single, options);
+            bool method_ok = (first == fs::copy_method::read_write) ? (result.method == first) : (result.method >= first);
+            printf("from %-15s: ok=%d bytes=%jd match=%d method_ok=%d\n", fs::copy_method_name(first),
+                result.ok(), result.bytes, read_file(single) == contents["sub/deep/c.bin"], method_ok
+            );
+        }
+
+        // overwriting a larger file must truncate it.
+        auto shrunk = fs::copy_file(src / "sub/b.txt", single);
+        printf("overwrite: ok=%d bytes=%jd match=%d\n", shrunk.ok(), shrunk.bytes, read_file(single) == contents["sub/b.txt"]);
+
+        fs::copy_options keep;
+        keep.overwrite = false;
+        auto refused = fs::copy_file(src / "a.txt", single, keep);
+        printf("no overwrite: ok=%d method=%s unchanged=%d\n", refused.ok(), fs::copy_method_name(refused.method), read_file(single) == contents["sub/b.txt"]);
+
+        auto missing = fs::copy_file(src / "nonexistent", single);
+        printf("missing source: ok=%d\n", missing.ok());
+
+        // a copy onto itself must fail without emptying the file, hard links included.
+        auto onto_self = fs::copy_file(single, single);
+        printf("onto itself: ok=%d error=%s unchanged=%d\n", onto_self.ok(), (onto_self.error == EINVAL) ? "EINVAL" : "other",
+            read_file(single) == contents["sub/b.txt"]
+        );
+#if PLATFORM_POSIX
+        fs::path linked = "samples_scratch_copy_link.txt";
+        link(single.c_str(), linked.c_str());
+        auto onto_link = fs::copy_file(single, linked);
+        printf("onto a hard link: ok=%d unchanged=%d\n", onto_link.ok(), read_file(single) == contents["sub/b.txt"]);
+        fs::remove(linked);
+#endif
+        fs::remove(single);
+
+#if PLATFORM_POSIX
+        // preserved attributes: an unusual mode and a fixed timestamp, with nanoseconds.
+        chmod((src / "sub/b.txt").c_str(), 0640);
+        struct timespec times[2] = { { 1000000000, 123456789 }, { 1200000000, 987654321 } };
+        utimensat(AT_FDCWD, (src / "sub/b.txt").c_str(), times, 0);
+        utimensat(AT_FDCWD, (src / "sub").c_str(), times, 0);
+#endif
+
+        fs::copy_options options;
+        options.threads        = 3;
+        options.preserve_mode  = true;
+        options.preserve_times = true;
+        auto stats = fs::copy_tree(src, dest, options);
+        printf("copy_tree: files=%jd dirs=%jd bytes=%jd errors=%jd\n", stats.files, stats.dirs, stats.bytes, stats.errors);
+
+        fs::path_list copied;
+        fs::walk(dest, copied);
+        std::vector<std::string> listing;
+        for (auto item : copied) {
+            listing.push_back(std::string(item.uni_string()));
+        }
+        std::sort(listing.begin(), listing.end());
+        for (const auto& item : listing) {
+            auto relative = item.substr(dest.uni_string().length() + 1);
+            auto it = contents.find(relative);
+            printf("    %s%s\n", relative.c_str(), (it == contents.end()) ? "" : (read_file(item.c_str()) == it->second) ? "  ok" : "  MISMATCH");
+        }
+
+#if PLATFORM_POSIX
+        struct stat file_st, dir_st;
+        stat((dest / "sub/b.txt").c_str(), &file_st);
+        stat((dest / "sub").c_str(), &dir_st);
+        char target[64] = {};
+        readlink((dest / "sub/link").c_str(), target, sizeof(target) - 1);
+        printf("symlinks=%jd target=%s mode=%03o mtime=%jd.%09ld dir_mtime=%jd\n", stats.symlinks, target,
+            unsigned(file_st.st_mode & 0777), intmax_t(file_st.st_mtim.tv_sec), file_st.st_mtim.tv_nsec, intmax_t(dir_st.st_mtim.tv_sec)
+        );
+#endif
+
+        // copying again over the same tree overwrites in place.
+        auto again = fs::copy_tree(src, dest, options);
+        printf("again: files=%jd errors=%jd\n", again.files, again.errors);
+
+#if PLATFORM_POSIX
+        // names that would be msw path syntax are copied as they are, and stay inside dest.
+        std::string odd_src  = "samples_scratch_copy_odd/src";
+        std::string odd_dest = "samples_scratch_copy_odd/dest";
+        fs::create_directories(std::vector<fs::path> { odd_src.c_str() });
+        for (const char* name : { "a:b", "back\\slash", "plain" }) {
+            if (FILE* fp = fopen((odd_src + '/' + name).c_str(), "wb")) {
+                fputs(name, fp);
+                fclose(fp);
+            }
+        }
+        auto odd = fs::copy_tree(odd_src.c_str(), odd_dest.c_str());
+        printf("odd names: files=%jd errors=%jd colon=%d backslash=%d plain=%d\n", odd.files, odd.errors,
+            access((odd_dest + "/a:b").c_str(), F_OK) == 0, access((odd_dest + "/back\\slash").c_str(), F_OK) == 0,
+            access((odd_dest + "/plain").c_str(), F_OK) == 0
+        );
+        fs::remove_all("samples_scratch_copy_odd");
+#endif
+
+        std::vector<std::string> doomed;
+        for (const auto& top : { src, dest }) {
+            fs::path_list items;
+            fs::walk(top, items);
+            for (auto item : items) {
+                doomed.push_back(std::string(item.uni_string()));
+            }
+            doomed.push_back(std::string(top.uni_string()));
+        }
+        std::sort(doomed.rbegin(), doomed.rend());      // children before parents
+        for (const auto& item : doomed) {
+            fs::remove(item.c_str());
+        }
+        fs::remove(root);
+    }
+    printf("--------------------------------------\n");
+    printf("TEST:FILESYSTEM:CREATE_DIRECTORIES\n");
+    {
+        fs::path root = "samples_scratch_mkdir";
+        fs::create_directory(root);
+        if (FILE* fp = fopen((root / "file.txt").c_str(), "wb")) fclose(fp);
+
+        // unsorted, with duplicates, shared parents, a sibling that sorts between parent and child
+        // ('-' < '/'), a file in the way, and an empty path.
+        const char* dirs[] = {
+            "a/b/c", "a/b", "a-x/y", "a/b/c", "a/b/d/e", "file.txt/sub", "file.txt", "", "a",
+        };
+        std::vector<fs::path> batch;
+        for (const auto* dir : dirs) {
+            batch.push_back(*dir ? root / dir : fs::path());
+        }
+
+        for (int pass=0; pass<2; ++pass) {
+            std::vector<int> results;
+            int failed = fs::create_directories(batch, &results);
+            printf("pass %d: failed=%d\n", pass, failed);
+            for (size_t i=0; i<batch.size(); ++i) {
+                printf("    %-14s %s is_directory=%d\n", *dirs[i] ? dirs[i] : "(empty)", results[i] ? "error" : "ok   ",
+                    *dirs[i] ? fs::is_directory(batch[i]) : 0
+                );
+            }
+        }
+
+        fs::path_list listed;
+        fs::path_list absolute;
+        absolute.push_back(fs::lexically_absolute(root / "abs/one"));
+        absolute.push_back(fs::lexically_absolute(root / "abs/two"));
+        int abs_failed = fs::create_directories(absolute);
+        printf("absolute: failed=%d exist=%d\n", abs_failed, fs::is_directory(root / "abs/one") && fs::is_directory(root / "abs/two"));
+
+        fs::walk(root, listed);
+        std::vector<std::string> doomed;
+        for (auto item : listed) {
+            doomed.push_back(std::string(item.uni_string()));
+        }
+        std::sort(doomed.rbegin(), doomed.rend());      // children before parents
+        for (const auto& item : doomed) {
+            fs::remove(item.c_str());
+        }
+        fs::remove(root);
+    }
+    printf("--------------------------------------\n");
+    printf("TEST:FILESYSTEM:REMOVE_ALL\n");
+    {
+        fs::path root = "samples_scratch_rm";
+        fs::path keep = "samples_scratch_rm_keep";
+        fs::create_directories(std::vector<fs::path> { root / "a/b/c", root / "d", root / "wide", keep });
+        write_file(root / "a/one.txt", 100);
+        write_file(root / "a/b/two.txt", 50);
+        write_file(root / "d/three.txt", 0);
+        for (int i=0; i<300; ++i) {
+            write_file(root / sFmtStr("wide/file%03d.bin", i), 10);
+        }
+        write_file(keep / "precious.txt", 7);
+#if PLATFORM_POSIX
+        // removing the link must leave its target alone.
+        symlink("../../samples_scratch_rm_keep", (root / "d/link").c_str());
+#endif
+
+        auto print_stats = [](const char* label, const fs::remove_stats& stats) {
+            printf("%s: files=%jd dirs=%jd bytes=%jd errors=%jd failures=%zu\n", label,
+                stats.files, stats.dirs, stats.bytes, stats.errors, stats.failures.size()
+            );
+        };
+
+        fs::remove_options options;
+        options.threads = 4;
+        options.dry_run = true;
+        print_stats("dry run", fs::remove_all(root, options));
+        printf("    root still there=%d\n", fs::is_directory(root / "wide"));
+
+        options.dry_run = false;
+        print_stats("remove", fs::remove_all(root, options));
+        printf("    root gone=%d target kept=%d\n", !fs::exists(root), fs::exists(keep / "precious.txt"));
+
+        print_stats("missing root", fs::remove_all(root, options));
+
+        write_file(keep / "single.bin", 123);
+        print_stats("file root", fs::remove_all(keep / "single.bin", options));
+        print_stats("root under a file", fs::remove_all(keep / "precious.txt/inner", options));
+
+        // deeper than the fds remove_all keeps open, so the bottom of it is removed inline, and
+        // deeper than the fds the process may open: inline removal mustn't hold one per level.
+        std::string deep = "samples_scratch_rm_deep";
+        for (int i=0; i<1500; ++i) deep += "/d";
+        fs::create_directories(std::vector<fs::path> { deep.c_str() });
+        write_file(fs::path(deep.c_str()) / "bottom.txt", 5);
+#if PLATFORM_POSIX
+        struct rlimit fd_limit;
+        getrlimit(RLIMIT_NOFILE, &fd_limit);
+        struct rlimit lowered = fd_limit;
+        lowered.rlim_cur = 512;
+        setrlimit(RLIMIT_NOFILE, &lowered);
+#endif
+        options.dry_run = true;
+        print_stats("deep dry run", fs::remove_all("samples_scratch_rm_deep", options));
+        options.dry_run = false;
+        print_stats("deep", fs::remove_all("samples_scratch_rm_deep", options));
+#if PLATFORM_POSIX
+        setrlimit(RLIMIT_NOFILE, &fd_limit);
+#endif
+        printf("    deep gone=%d\n", !fs::exists("samples_scratch_rm_deep"));
+
+        options.count_bytes = false;
+        print_stats("no byte count", fs::remove_all(keep, options));
+        printf("    keep gone=%d\n", !fs::exists(keep));
+    }
+    printf("--------------------------------------\n");
+    printf("TEST:FILESYSTEM:HASH\n");
+    {
+        // the xxHash sanity buffer, for which reference XXH3_64bits values are published.
+        std::vector<uint8_t> sanity(300000);
+        uint64_t gen = 2654435761U;
+        for (auto& byte : sanity) {
+            byte = uint8_t(gen >> 56);
+            gen *= 11400714785074694797ULL;
+        }
+
+        // every supported isa must agree with scalar, whether fed in one call or in odd pieces.
+        using fs::simd::isa;
+        auto orig_isa = fs::simd::ActiveIsa();
+        int mismatches = 0;
+        for (size_t len : { 0, 1, 3, 6, 12, 24, 48, 80, 195, 240, 241, 403, 512, 1024, 2048, 2240, 2367, 300000 }) {
+            fs::simd::ForceIsa(isa::scalar);
+            auto expected = fs::hasher::hash(fs::hash_algorithm::xxh3,   sanity.data(), len);
+            auto crc      = fs::hasher::hash(fs::hash_algorithm::crc32c, sanity.data(), len);
+            if (len <= 2367) {
+                printf("  xxh3 %-5zu %016llx  crc32c %08llx\n", len, (unsigned long long)expected, (unsigned long long)crc);
+            }
+            for (auto which : { isa::scalar, isa::sse2, isa::avx2, isa::neon }) {
+                if (!fs::simd::ForceIsa(which)) continue;
+                for (auto algorithm : { fs::hash_algorithm::xxh3, fs::hash_algorithm::crc32c }) {
+                    fs::hasher pieces(algorithm);
+                    for (size_t pos=0; pos<len; ) {
+                        auto n = std::min(len - pos, 1 + (pos * 13) % 700);
+                        pieces.update(sanity.data() + pos, n);
+                        pos += n;
+                    }
+                    auto want = (algorithm == fs::hash_algorithm::xxh3) ? expected : crc;
+                    if (fs::hasher::hash(algorithm, sanity.data(), len) != want || pieces.digest() != want) {
+                        printf("mismatch (%s, %s, %zu)\n", fs::simd::IsaName(which), fs::hash_algorithm_name(algorithm), len);
+                        ++mismatches;
+                    }
+                }
+            }
+        }
+        fs::simd::ForceIsa(orig_isa);
+        printf("mismatches = %d, crc32c(\"123456789\") = %08llx\n", mismatches,
+            (unsigned long long)fs::hasher::hash(fs::hash_algorithm::crc32c, "123456789", 9)
+        );
+
+        fs::path file_a = "samples_scratch_hash_a.bin";
+        fs::path file_b = "samples_scratch_hash_b.bin";
+        fs::path file_c = "samples_scratch_hash_c.bin";
+        write_file(file_a, std::string_view((const char*)sanity.data(), sanity.size()));
+        sanity[150000] ^= 1;                                // same size, differs mid-file only
+        write_file(file_b, std::string_view((const char*)sanity.data(), sanity.size()));
+        write_file(file_c, std::string_view((const char*)sanity.data(), sanity.size() - 1));
+        sanity[150000] ^= 1;
+
+        for (auto algorithm : { fs::hash_algorithm::xxh3, fs::hash_algorithm::crc32c }) {
+            fs::hash_options options;
+            options.algorithm  = algorithm;
+            options.read_block = 10000;
+            auto pread_digest = fs::hash_file(file_a, options);
+            options.mmap_threshold = 0;
+            auto mmap_digest = fs::hash_file(file_a, options);
+            printf("%-6s: pread=%d mmap=%d match=%d size=%jd\n", fs::hash_algorithm_name(algorithm),
+                pread_digest.value == fs::hasher::hash(algorithm, sanity.data(), sanity.size()),
+                mmap_digest.value  == pread_digest.value, mmap_digest == pread_digest, mmap_digest.size
+            );
+        }
+
+        fs::hash_options options;
+        options.threads = 2;
+        fs::path files[] = { file_a, file_b, file_c, "samples_scratch_hash_missing.bin" };
+        auto full = fs::hash_files(files, 4, options);
+        options.partial_bytes = 64 * 1024;
+        auto quick = fs::hash_files(files, 4, options);
+        printf("full:    a==b %d  a==c %d  missing ok=%d\n", full[0] == full[1], full[0] == full[2], full[3].ok());
+        printf("partial: a==b %d  a==c %d  partial==full %d\n", quick[0] == quick[1], quick[0] == quick[2], quick[0] == full[0]);
+
+        fs::remove(file_a);
+        fs::remove(file_b);
+        fs::remove(file_c);
+    }
+    printf("--------------------------------------\n");
+    printf("TEST:FILESYSTEM:SNAPSHOT\n");
+    {
+        fs::path root = "samples_scratch_snap";
+        fs::path file = "samples_scratch_snap.bin";
+        fs::create_directories(std::vector<fs::path> { root / "a/b", root / "a-b", root / "skip/deep" });
+        write_file(root / "a/one.txt", 100);
+        write_file(root / "a/b/two.txt", 50);
+        write_file(root / "a-b/three.txt", 3);
+        write_file(root / "skip/deep/four.txt", 4);
+        write_file(root / "top.txt", 7);
+
+        fs::snapshot_options options;
+        options.threads = 2;
+        options.filter  = [](std::string_view relative, bool) { return relative != "skip"; };
+        auto written = fs::write_snapshot(root, file, options);
+        printf("write: ok=%d entries=%zu errors=%jd\n", written.ok(), written.entries, written.errors);
+
+        fs::snapshot snap(file, true);
+        printf("open: ok=%d size=%zu root=%s\n", snap.is_open(), snap.size(), std::string(snap.root()).c_str());
+        for (size_t i=0; i<snap.size(); ++i) {
+            auto entry = snap[i];
+            printf("  [%zu] %-14s dir=%d size=%-4jd subtree_end=%zu\n", i, std::string(entry.relative).c_str(),
+                entry.is_directory(), entry.is_directory() ? intmax_t(0) : entry.info.st_size, entry.subtree_end
+            );
+        }
+
+        auto idx = snap.find("a/b/two.txt");
+        printf("find: a/b/two.txt=%zu matches status=%d, a/b/missing npos=%d, \"\"=%zu\n", idx,
+            idx != fs::snapshot::npos && snap[idx].info == fs::status(root / "a/b/two.txt"),
+            snap.find("a/b/missing") == fs::snapshot::npos, snap.find("")
+        );
+
+        // replacing the file leaves an open snapshot intact, and leaves no temporary behind.
+        write_file(root / "a/new.txt", 1);
+        auto rewritten = fs::write_snapshot(root, file);
+        fs::snapshot fresh(file);
+        printf("rewrite: ok=%d entries=%zu old size=%zu new size=%zu\n", rewritten.ok(), rewritten.entries, snap.size(), fresh.size());
+        snap.close();
+
+        std::vector<fs::path> strays;
+        for (const auto& item : fs::directory_iterator(fs::path("."))) {
+            if (item.uni_string().find("samples_scratch_snap.bin.") != std::string::npos) {
+                strays.push_back(item);
+            }
+        }
+        printf("temporaries left=%zu\n", strays.size());
+
+        // damage a path byte: only a verified open notices.
+        fresh.close();
+        auto size = fs::file_size(file);
+        if (FILE* fp = fopen(file.c_str(), "r+b")) {
+            fseek(fp, long(size - 2), SEEK_SET);
+            fputc('#', fp);
+            fclose(fp);
+        }
+        fs::snapshot damaged(file);
+        fs::snapshot verified(file, true);
+        printf("damaged: open=%d verified open=%d error=%s\n", damaged.is_open(), verified.is_open(),
+            (verified.error() == EILSEQ) ? "EILSEQ" : "other"
+        );
+        damaged.close();
+
+        // records pointing outside the file read as an empty path and a clamped subtree.
+        fs::write_snapshot(root, file);
+        if (FILE* fp = fopen(file.c_str(), "r+b")) {
+            fs::snapshot_header header;
+            fs::snapshot_record record;
+            auto pos = long(sizeof(header) + sizeof(record));
+            if (fread(&header, sizeof(header), 1, fp) == 1) {
+                pos = long(header.records_offset + sizeof(record));
+            }
+            fseek(fp, pos, SEEK_SET);
+            if (fread(&record, sizeof(record), 1, fp) == 1) {
+                record.path_offset = UINT32_MAX - 8;
+                record.subtree_end = UINT32_MAX;
+                fseek(fp, pos, SEEK_SET);
+                fwrite(&record, sizeof(record), 1, fp);
+            }
+            fclose(fp);
+        }
+        fs::snapshot corrupt(file);
+        auto corrupt_diff = fs::diff(corrupt, root);
+        printf("corrupt record: open=%d relative=\"%s\" subtree_end=%zu of %zu, diff errors=%d\n", corrupt.is_open(),
+            std::string(corrupt.relative(1)).c_str(), corrupt.subtree_end(1), corrupt.size(), corrupt_diff.errors > 0
+        );
+        corrupt.close();
+
+        write_file(file, 100);
+        fs::snapshot garbage(file);
+        printf("not a snapshot: open=%d error=%s\n", garbage.is_open(), (garbage.error() == EINVAL) ? "EINVAL" : "other");
+
+        auto missing = fs::write_snapshot("samples_scratch_snap_missing", file);
+        printf("missing root: ok=%d error=%s\n", missing.ok(), (missing.error == ENOENT) ? "ENOENT" : "other");
+
+        fs::remove(file);
+        fs::remove_all(root);
+    }
+    printf("--------------------------------------\n");
+    printf("TEST:FILESYSTEM:DIFF\n");
+    {
+        fs::path root = "samples_scratch_diff";
+        fs::path file = "samples_scratch_diff.bin";
+        fs::create_directories(std::vector<fs::path> { root / "a/b", root / "gone/deep", root / "same", root / "empty" });
+        write_file(root / "a/keep.txt", 10);
+        write_file(root / "a/grow.txt", 10);
+        write_file(root / "a/b/drop.txt", 5);
+        write_file(root / "gone/one.txt", 1);
+        write_file(root / "gone/deep/two.txt", 2);
+        write_file(root / "same/untouched.txt", 3);
+        write_file(root / "becomes_dir", 4);
+
+#if PLATFORM_POSIX
+        // timestamps from the snapshot's own second can't be trusted, so age everything first.
+        fs::path listed[] = {
+            root, root / "a", root / "a/b", root / "gone", root / "gone/deep", root / "same", root / "empty",
+            root / "a/keep.txt", root / "a/grow.txt", root / "a/b/drop.txt", root / "gone/one.txt",
+            root / "gone/deep/two.txt", root / "same/untouched.txt", root / "becomes_dir",
+        };
+        struct timespec past[2] = { { time(nullptr) - 100, 0 }, { time(nullptr) - 100, 0 } };
+        for (const auto& item : listed) {
+            utimensat(AT_FDCWD, item.c_str(), past, AT_SYMLINK_NOFOLLOW);
+        }
+#endif
+        fs::write_snapshot(root, file);
+        fs::snapshot snap(file);
+
+        auto print_result = [](const char* label, const fs::diff_result& result) {
+            printf("%s: ok=%d changes=%zu checked=%jd listed=%jd pruned=%jd errors=%jd\n", label, result.ok(),
+                result.changes.size(), result.checked, result.dirs_listed, result.dirs_pruned, result.errors
+            );
+            for (const auto& change : result.changes) {
+                printf("    %-8s %s\n", fs::change_type_name(change.type), change.relative.c_str());
+            }
+        };
+
+        fs::diff_options options;
+        options.threads = 3;
+        print_result("unchanged", fs::diff(snap, options));
+
+        write_file(root / "a/grow.txt", 20);
+        write_file(root / "a/new.txt", 1);
+        fs::remove(root / "a/b/drop.txt");
+        fs::remove_all(root / "gone");
+        fs::create_directories(std::vector<fs::path> { root / "fresh/inner" });
+        write_file(root / "fresh/inner/three.txt", 3);
+        fs::remove(root / "becomes_dir");
+        fs::create_directories(std::vector<fs::path> { root / "becomes_dir" });
+        write_file(root / "becomes_dir/inside.txt", 1);
+        print_result("changed", fs::diff(snap, options));
+
+        options.filter = [](std::string_view relative, bool) { return relative != "fresh"; };
+        print_result("filtered", fs::diff(snap, root, options));
+
+        fs::remove_all(root);
+        print_result("missing root", fs::diff(snap));
+
+        snap.close();
+        fs::remove(file);
+    }
+    printf("--------------------------------------\n");
+    printf("TEST:FILESYSTEM:SIMD_KERNELS\n");
+    {
+        // every supported kernel must match scalar output byte-for-byte. Lengths sweep across vector
+        // widths to exercise the tails. Output is host-agnostic: only mismatches are reported.
+        std::vector<std::string> inputs;
+        for(const auto* item : path_abs_inputs) {
+            if (!StringUtil::BeginsWith(item, "/dev/")) {     // rejected by ConvertFromMsw, by design
+                inputs.push_back(item);
+            }
+        }
+        inputs.insert(inputs.end(), std::begin(path_rel_inputs), std::end(path_rel_inputs));
+        for (int len=0; len<100; ++len) {
+            std::string mixed;
+            for (int i=0; i<len; ++i) {
+                mixed += "ab\\/c:"[(i * 7 + len) % 6];
+            }
+            inputs.push_back("c:\\" + mixed);
+            inputs.push_back("/c/" + mixed);
+        }
+
+        using fs::simd::isa;
+        auto orig_isa = fs::simd::ActiveIsa();
+        std::vector<std::string> expected;
+        fs::simd::ForceIsa(isa::scalar);
+        for (const auto& item : inputs) {
+            expected.push_back(fs::ConvertFromMsw(item) + "|" + fs::ConvertToMsw(item));
+        }
+
+        int mismatches = 0;
+        for (auto which : { isa::sse2, isa::avx2, isa::neon }) {
+            if (!fs::simd::ForceIsa(which)) continue;
+            for (size_t i=0; i<inputs.size(); ++i) {
+                auto result  = fs::ConvertFromMsw(inputs[i]) + "|" + fs::ConvertToMsw(inputs[i]);
+                auto sep     = fs::simd::FindPathSep(inputs[i].c_str(), inputs[i].length());
+                auto exp_sep = std::min(inputs[i].find_first_of("/\\"), inputs[i].length());
+                if (result != expected[i] || sep != exp_sep) {
+                    printf("mismatch (%s): %s\n", fs::simd::IsaName(which), inputs[i].c_str());
+                    ++mismatches;
+                }
+            }
+        }
+        fs::simd::ForceIsa(orig_isa);
+        printf("mismatches = %d\n", mismatches);
+    }
+    printf("--------------------------------------\n");
     printf("END OF TEST LOG\n");
 
     return 0;
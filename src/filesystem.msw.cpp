@@ -6,22 +6,50 @@
 #include <filesystem>
 
 #include "fs.h"
+#include "fs_directory.h"
 #include "icy_log.h"
 
 #include <sys/types.h>
 #include <sys/stat.h>
 
+#if PLATFORM_MSW
+#	include <direct.h>
+#else
+#	include <unistd.h>
+#endif
+
 namespace fs {
 
-bool path::operator == (const path& s) const { return strcasecmp(uni_path_.c_str(), s.uni_path_.c_str()) == 0; }
-bool path::operator != (const path& s) const { return strcasecmp(uni_path_.c_str(), s.uni_path_.c_str()) != 0; }
-bool path::operator == (const char *s) const { return strcasecmp(uni_path_.c_str(), fs::PathFromString(s).c_str()) == 0; }
-bool path::operator != (const char *s) const { return strcasecmp(uni_path_.c_str(), fs::PathFromString(s).c_str()) != 0; }
+bool path::operator == (const path& s) const {
+	if (uni_path_.length() != s.uni_path_.length()) return false;
+#if FS_PATH_CACHE_HASH
+	// only compare hashes already known, computing one costs as much as the compare itself.
+	auto lhash =   hash_.value.load(std::memory_order_relaxed);
+	auto rhash = s.hash_.value.load(std::memory_order_relaxed);
+	if (lhash && rhash && lhash != rhash) return false;
+#endif
+	return CompareNoCase(uni_path_, s.uni_path_) == 0;
+}
+
+bool path::operator == (const char *s) const {
+	if (s && s[0] == '/') {
+		// already universal, mimic PathFromString without making a copy.
+		std::string_view uni = s;
+		if (uni.back() == '/') {
+			uni.remove_suffix(1);
+		}
+		return view() == path_view(uni);
+	}
+	return view() == path_view(fs::PathFromString(s));
+}
+
+bool path::operator != (const path& s) const { return !operator==(s); }
+bool path::operator != (const char *s) const { return !operator==(s); }
 
-bool path::operator >  (const path& s) const { return strcasecmp(uni_path_.c_str(), s.uni_path_.c_str()) >  0; }
-bool path::operator >= (const path& s) const { return strcasecmp(uni_path_.c_str(), s.uni_path_.c_str()) >= 0; }
-bool path::operator <  (const path& s) const { return strcasecmp(uni_path_.c_str(), s.uni_path_.c_str()) <  0; }
-bool path::operator <= (const path& s) const { return strcasecmp(uni_path_.c_str(), s.uni_path_.c_str()) <= 0; }
+bool path::operator >  (const path& s) const { return CompareNoCase(uni_path_, s.uni_path_) >  0; }
+bool path::operator >= (const path& s) const { return CompareNoCase(uni_path_, s.uni_path_) >= 0; }
+bool path::operator <  (const path& s) const { return CompareNoCase(uni_path_, s.uni_path_) <  0; }
+bool path::operator <= (const path& s) const { return CompareNoCase(uni_path_, s.uni_path_) <= 0; }
 
 
 // create a path from an incoming user-provided string.
@@ -48,14 +76,17 @@ std::string PathFromString(const char* path)
 	return path_;
 }
 
-bool exists(const path& fspath) {
-	std::error_code nothrow_please_kthx;
-	if (fspath.is_device()) {
-		// /dev/null and /dev/tty (NUL/CON) always exist, contrary to what std::filesystem thinks... --jstine
-		return true;
+CStatInfo status(const path& fspath) {
+	auto st = posix_stat(fspath.c_str());
+	if (!st.Exists() && fspath.is_device()) {
+		// /dev/null and /dev/tty (NUL/CON) always exist, even where the CRT's stat() disagrees.
+		st.st_mode = S_IFCHR;
 	}
-	auto ret = std::filesystem::exists(fspath.asLibcStr(), nothrow_please_kthx);
-	return ret && !nothrow_please_kthx;
+	return st;
+}
+
+bool exists(const path& fspath) {
+	return status(fspath).Exists();
 }
 
 void remove(const path& fspath) {
@@ -64,23 +95,18 @@ void remove(const path& fspath) {
 }
 
 intmax_t file_size(const path& fspath) {
-	std::error_code nothrow_please_kthx;
-	auto ret = std::filesystem::file_size(fspath.asLibcStr(), nothrow_please_kthx);
-	if (nothrow_please_kthx)
-		return 0;
-
-	return ret;
+	// matches std::filesystem::file_size(), which fails (and we return 0) for anything not a file.
+	auto st = status(fspath);
+	return st.IsFile() ? st.st_size : 0;
 }
 
 bool is_directory(const path& fspath) {
-	std::error_code nothrow_please_kthx;
-	auto ret = std::filesystem::is_directory(fspath.asLibcStr(), nothrow_please_kthx);
-	return ret && !nothrow_please_kthx;
+	return status(fspath).IsDir();
 }
 
 bool create_directory(const path& fspath) {
 	// check if it's there already. On Windows, calling create_directory can be expensive, even if the dir already exists
-	if (exists(fspath) && is_directory(fspath))
+	if (is_directory(fspath))
 		return true;
 
 	std::error_code nothrow_please_kthx;
@@ -90,32 +116,89 @@ bool create_directory(const path& fspath) {
 	return 1;
 }
 
+// Calls func with the universal path of every entry in fspath. Entry names never contain separators
+// nor need normalization, so each path is a plain join into a reused buffer.
+template<typename Func>
+static void for_each_entry_path(const path& fspath, Func&& func) {
+	directory_stream stream(fspath);
+	if (!stream.is_open()) return;
+
+	std::string full = fspath.uni_string();
+	full += '/';
+	auto dirlen = full.length();
+	for (const auto& entry : stream) {
+		full.resize(dirlen);
+		full += entry.name;
+		func(path_view(full));
+	}
+}
+
 std::vector<path> directory_iterator(const path& fspath) {
-	if (!fs::exists(fspath)) return {};
 	std::vector<path> meh;
-	for (const std::filesystem::path& item : std::filesystem::directory_iterator(fspath.asLibcStr())) {
-		meh.push_back(item.u8string().c_str());
-	}
+	for_each_entry_path(fspath, [&](path_view item) {
+		meh.emplace_back(item);
+	});
 	return meh;
 }
 
 void directory_iterator(const std::function<void (const fs::path& path)>& func, const path& fspath) {
-	if (!fs::exists(fspath)) return;
-	for (const std::filesystem::path& item : std::filesystem::directory_iterator(fspath.asLibcStr())) {
-		func(item.u8string().c_str());
-	}
+	for_each_entry_path(fspath, [&](path_view item) {
+		func(path(item));
+	});
+}
+
+void directory_iterator(path_list& dest, const path& fspath) {
+	for_each_entry_path(fspath, [&](path_view item) {
+		dest.push_back(item);
+	});
 }
 
+#if FS_NATIVE_IS_UNIVERSAL
 const std::string& path::libc_path() const {
-	return libc_path_;
+	return uni_path_;
 }
 
-void path::update_native_path() {
-	libc_path_ = ConvertToMsw(uni_path_);
+std::string path::asLibcStr() const {
+	return uni_path_;
+}
+#else
+const std::string& path::libc_path() const {
+	if (auto* native = libc_path_.ptr.load(std::memory_order_acquire)) {
+		return *native;
+	}
+
+	auto* native = new std::string(ConvertToMsw(uni_path_));
+	std::string* expected = nullptr;
+	if (!libc_path_.ptr.compare_exchange_strong(expected, native, std::memory_order_acq_rel)) {
+		// another thread materialized it first, use theirs.
+		delete native;
+		return *expected;
+	}
+	return *native;
+}
+
+std::string path::asLibcStr() const {
+	if (auto* native = libc_path_.ptr.load(std::memory_order_acquire)) {
+		return *native;
+	}
+	return ConvertToMsw(uni_path_);
+}
+#endif
+
+path current_path() {
+	char cwd[4096];
+#if PLATFORM_MSW
+	if (!_getcwd(cwd, sizeof(cwd))) {
+#else
+	if (!getcwd(cwd, sizeof(cwd))) {
+#endif
+		return {};
+	}
+	return cwd;
 }
 
 std::string absolute(const path& fspath) {
-	return std::filesystem::absolute(fspath.asLibcStr()).lexically_normal().u8string();
+	return lexically_absolute(fspath).asLibcStr();
 }
 
 bool stat(const path& fspath, struct stat& st) {
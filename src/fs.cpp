@@ -1,8 +1,11 @@
 
 #include <string>
+#include <cstring>
 #include "icy_log.h"
 #include "icy_assert.h"
 #include "fs.h"
+#include "fs_simd.h"
+#include "parallel_for.h"
 
 #if !defined(elif)
 #	define elif		else if
@@ -48,15 +51,33 @@ std::string replace_extension(const std::string& path, const std::string& extens
 	return result;
 }
 
+size_t HashNoCase(std::string_view uni_path)
+{
+	// FNV-1a over case-folded bytes. Folding uses tolower() to stay consistent with CompareNoCase().
+	uint64_t hash = 0xcbf29ce484222325ULL;
+	for (char c : uni_path) {
+		hash ^= (uint8_t)tolower((uint8_t)c);
+		hash *= 0x100000001b3ULL;
+	}
+	size_t result = size_t(hash ^ (hash >> 32));
+	return result ? result : 1;
+}
+
 bool IsMswPathSep(char c)
 {
 	return (c == '\\') || (c == '/');
 }
 
+// Core of ConvertFromMsw(), writes into a caller-provided buffer and reports errors by code rather
+// than by log, so that it's usable from batch APIs. dst must have room for ConvertFromMswMaxLen()
+// bytes. No null terminator is written. Returns the output length (always 0 on error).
+//
 // intended for use on fullpaths which have already had host prefixes removed.
-std::string ConvertFromMsw(const std::string& origPath)
+size_t ConvertFromMsw(char* dst, std::string_view origPath, path_error* error)
 {
-	std::string result;
+	if (error) {
+		*error = path_error::none;
+	}
 
 	// peculiar windows: it has some hard-coded filenames which are not prefixed or post-fixed by
 	// anything. Which would make them really dangerous and invasive to filesystem behavior, but hey
@@ -70,18 +91,26 @@ std::string ConvertFromMsw(const std::string& origPath)
 	// COM1, COM2, COM3, COM4, COM5, COM6, COM7, COM8, COM9, COM0
 	// LPT1, LPT2, LPT3, LPT4, LPT5, LPT6, LPT7, LPT8, LPT9, LPT0
 
+	auto emit = [dst](std::string_view literal) {
+		memcpy(dst, literal.data(), literal.length());
+		return literal.length();
+	};
+
 	if (origPath == "NUL") {
-		return "/dev/null";
+		return emit("/dev/null");
 	}
 
 	if (origPath == "CON") {
-		return "/dev/tty";
+		return emit("/dev/tty");
 	}
 
-	// max output length is original length plus drive specifier, eg. /c  (two letters)
-	result.resize(origPath.length() + 2);
-	const char* src = origPath.c_str();
-		  char* dst = &result[0];
+	// bounds-checked peek which mimics reading the null terminator of a C string.
+	auto srcpos = size_t(0);
+	auto peek   = [&](size_t ofs) -> char {
+		return (srcpos + ofs < origPath.length()) ? origPath[srcpos + ofs] : 0;
+	};
+
+	char* dststart = dst;
 
 	// Typically a conversion from windows to unix style path has a 1:1 length match.
 	// The problem occurs when the path isn't rooted, eg.  c:some\dir  vs. c:\some\dir
@@ -95,15 +124,15 @@ std::string ConvertFromMsw(const std::string& origPath)
 	// it is very difficult to port logic that somehow relies on this feature.  In the interest
 	// of cross-platform support, we detect this and throw a hard error rather than try to support it.
 
-	if (isalnum((uint8_t)src[0]) && src[1] == ':') {
+	if (isalnum((uint8_t)peek(0)) && peek(1) == ':') {
 		dst[0] = '/';
-		dst[1] = tolower(src[0]);
+		dst[1] = tolower(peek(0));
 
 		// early-exit to to allow `c:` -> `/c`
 		// this conversion might be useful for internal path parsing and is an unlikely source of user error.
 
-		if (!src[2]) {
-			return result;
+		if (!peek(2)) {
+			return 2;
 		}
 
 		//rel_check (IsMswPathSep(src[2]),
@@ -113,8 +142,8 @@ std::string ConvertFromMsw(const std::string& origPath)
 		//	origPath.c_str()
 		//);
 
-		src  += 2;
-		dst  += 2;
+		srcpos += 2;
+		dst    += 2;
 	}
 
 	// - a path that starts with a single backslash is always rejected.
@@ -123,47 +152,247 @@ std::string ConvertFromMsw(const std::string& origPath)
 	//       /c/woombey/to  <-- OK!
 	//       /woombey/to    <-- not good.
 
-	elif (src[0] == '\\') {
-		if (src[0] == src[1]) {
+	elif (peek(0) == '\\') {
+		if (peek(0) == peek(1)) {
 			// network name URI, don't do anything (regular slash conversion is OK)
 		}
 		else {
-			fprintf( stderr, "Invalid path layout: %s\n"
-				"Rooted paths without drive specification are not allowed.\n"
-				"Please explicitly specify the drive letter in the path.",
-				origPath.c_str()
-			);
-			return {};
+			if (error) {
+				*error = path_error::rooted_without_drive;
+			}
+			return 0;
 		}
 	}
-	elif (src[0] == '/') {
-		if (src[0] == src[1]) {
+	elif (peek(0) == '/') {
+		if (peek(0) == peek(1)) {
 			// network name URI, don't do anything (regular slash conversion is OK)
 		}
 		else {
 			// allow format /c or /c/ and nothing else:
 			// note that windows itself only allows a-z and 0-9 so isalnum() works for us
 			// since it will also reject any unicode chars (which is what we want).
-			if (!isalnum((uint8_t)src[1]) || (src[2] && src[2] != '/')) {
-				fprintf( stderr, "Invalid path layout: %s\n"
-					"Rooted paths without drive specification are not allowed.\n"
-					"Please explicitly specify the drive letter in the path.",
-					origPath.c_str()
-				);
-				return {};
+			if (!isalnum((uint8_t)peek(1)) || (peek(2) && peek(2) != '/')) {
+				if (error) {
+					*error = path_error::rooted_without_drive;
+				}
+				return 0;
 			}
 		}
 	}
 
-	// copy rest of the string char for char, replacing '\\' with '/'
-	for(; src[0]; ++src, ++dst) {
-		dst[0] = (src[0] == '\\') ? '/' : src[0];
+	// copy rest of the string, replacing '\\' with '/'
+	size_t remain = origPath.length() - srcpos;
+	simd::TranslateChar(dst, origPath.data() + srcpos, remain, '\\', '/');
+	dst += remain;
+	return dst - dststart;
+}
+
+static void report_path_error(std::string_view origPath, path_error error)
+{
+	fprintf( stderr, "Invalid path layout: %.*s\n%s\n"
+		"Please explicitly specify the drive letter in the path.",
+		int(origPath.length()), origPath.data(), PathErrorString(error)
+	);
+}
+
+void UpathLiteralInvalid(std::string_view src, path_error error)
+{
+	if (error == path_error::none) {
+		rel_abort("Path literal is too long: %.*s\n", int(src.length()), src.data());
+	}
+	report_path_error(src, error);
+	rel_abort("Invalid path literal.\n");
+}
+
+// intended for use on fullpaths which have already had host prefixes removed.
+std::string ConvertFromMsw(const std::string& origPath)
+{
+	std::string result;
+	result.resize(ConvertFromMswMaxLen(origPath.length()));
+
+	path_error error;
+	auto length = ConvertFromMsw(&result[0], origPath, &error);
+	if (error != path_error::none) {
+		report_path_error(origPath, error);
+		return {};
 	}
-	dst[0] = 0;
-	result.resize(dst - &result[0]);
+	result.resize(length);
 	return result;
 }
 
+size_t PathFromString(char* dst, std::string_view src, path_error* error)
+{
+	if (error) {
+		*error = path_error::none;
+	}
+
+	size_t length;
+	if (src.empty()) {
+		return 0;
+	}
+	elif (src[0] == '/') {
+		// path starts with a forward slash, assume it's already normalized
+		memcpy(dst, src.data(), src.length());
+		length = src.length();
+	}
+	else {
+		// assume path is mixed forward/backslash, normalize to forward slash mode.
+		length = ConvertFromMsw(dst, src, error);
+	}
+
+	if (length && dst[length-1] == '/') {
+		--length;
+	}
+	return length;
+}
+
+bool HasDevicePrefix(std::string_view uni_path)
+{
+	// device prefixes are colon-terminated leading components, eg. umd:/path or usb0:/path
+	auto pos = uni_path.find_first_of("/:");
+	return (pos != std::string_view::npos) && (pos > 0) && (uni_path[pos] == ':');
+}
+
+// Lexical normalization of a universal path, in-place and in a single forward pass. Output is never
+// longer than the input. Rules:
+//   - duplicate separators and "." components are removed, as is any trailing separator.
+//   - ".." removes the preceding component. Leading ".." of a relative path are kept.
+//   - ".." never climbs above the root, which for this purpose includes a drive (/c), a network
+//     share (//server) or a device prefix (umd:). Hence "/c/.." is "/c" and not "/".
+//   - a relative path that normalizes to nothing becomes "."
+//
+// When the native layer is not universal (msw), backslashes are path separators as far as the host
+// is concerned, so they are treated as such here and rewritten as forward slashes.
+size_t LexicallyNormal(char* buf, size_t len)
+{
+	auto is_sep = [](char c) {
+		return (c == '/') || (!FS_NATIVE_IS_UNIVERSAL && c == '\\');
+	};
+
+	if (!len) return 0;
+
+	size_t rpos = 0;
+	size_t wpos = 0;
+	bool   rooted = false;
+
+	if (is_sep(buf[0])) {
+		rooted = true;
+		if (len > 1 && is_sep(buf[1])) {
+			// network share: //server
+			buf[wpos++] = '/';
+			buf[wpos++] = '/';
+			rpos = 2;
+			while (rpos < len && !is_sep(buf[rpos])) {
+				buf[wpos++] = buf[rpos++];
+			}
+		}
+		else {
+			buf[wpos++] = '/';
+			rpos = 1;
+
+			// drive spec: /c or /c/...
+			if (rpos < len && isalnum((uint8_t)buf[rpos]) && (rpos + 1 == len || is_sep(buf[rpos + 1]))) {
+				buf[wpos++] = buf[rpos++];
+			}
+		}
+	}
+	elif (HasDevicePrefix(std::string_view(buf, len))) {
+		rooted = true;
+		while (buf[rpos] != ':') {
+			++rpos;
+		}
+		wpos = ++rpos;
+		if (rpos < len && is_sep(buf[rpos])) {
+			buf[wpos++] = '/';
+			++rpos;
+		}
+	}
+
+	const size_t floor		= wpos;
+	const bool   root_sep	= (floor > 0) && (buf[floor - 1] != '/') && !(buf[floor - 1] == ':');
+	bool         need_sep	= root_sep;
+
+	while (rpos < len) {
+		while (rpos < len && is_sep(buf[rpos])) {
+			++rpos;
+		}
+		if (rpos >= len) break;
+
+		size_t beg = rpos;
+		while (rpos < len && !is_sep(buf[rpos])) {
+			++rpos;
+		}
+		size_t complen = rpos - beg;
+
+		if (complen == 1 && buf[beg] == '.') {
+			continue;
+		}
+
+		if (complen == 2 && buf[beg] == '.' && buf[beg + 1] == '.') {
+			if (wpos > floor) {
+				size_t prev = wpos;
+				while (prev > floor && buf[prev - 1] != '/') {
+					--prev;
+				}
+				bool prev_is_parent = (wpos - prev == 2) && buf[prev] == '.' && buf[prev + 1] == '.';
+				if (!prev_is_parent) {
+					wpos     = (prev > floor) ? (prev - 1) : floor;
+					need_sep = (wpos > floor) || root_sep;
+					continue;
+				}
+			}
+			if (rooted) {
+				// can't climb above the root.
+				continue;
+			}
+		}
+
+		if (need_sep) {
+			buf[wpos++] = '/';
+		}
+		memmove(buf + wpos, buf + beg, complen);
+		wpos    += complen;
+		need_sep = true;
+	}
+
+	if (!wpos) {
+		buf[wpos++] = '.';
+	}
+	return wpos;
+}
+
+path& path::normalize()
+{
+	uni_path_.resize(LexicallyNormal(&uni_path_[0], uni_path_.length()));
+	invalidate_cache();
+	return *this;
+}
+
+path lexically_absolute(const path& fspath)
+{
+	return lexically_absolute(fspath, {});
+}
+
+path lexically_absolute(const path& fspath, const path& base)
+{
+	if (fspath.is_absolute() || HasDevicePrefix(fspath.uni_string())) {
+		return fspath.lexically_normal();
+	}
+
+	path result = base.empty() ? current_path() : base;
+	result /= fspath;
+	return result.normalize();
+}
+
+const char* PathErrorString(path_error error)
+{
+	switch (error) {
+		case path_error::none:					return "No error.";
+		case path_error::rooted_without_drive:	return "Rooted paths without drive specification are not allowed.";
+	}
+	return "Unknown path error.";
+}
+
 // intended for use on fullpaths which have already had host prefixes removed.
 std::string ConvertToMsw(const std::string& unix_path)
 {
@@ -200,11 +429,10 @@ std::string ConvertToMsw(const std::string& unix_path)
 		// relative to current dir, just strip the ".\"
 		src += 2;
 	}
-	// copy rest of the string char for char, replacing '/' with '\\'
-	for(; src[0]; ++src, ++dst) {
-		dst[0] = (src[0] == '/') ? '\\' : src[0];
-	}
-	dst[0] = 0;
+	// copy rest of the string, replacing '/' with '\\'
+	size_t remain = unix_path.length() - (src - unix_path.c_str());
+	simd::TranslateChar(dst, src, remain, '/', '\\');
+	dst += remain;
 	std::ptrdiff_t newsize = dst - result.c_str();
 	rel_check(newsize <= std::ptrdiff_t(unix_path.length()));
 	result.resize(newsize);
@@ -226,10 +454,63 @@ path& path::append(const std::string& comp)
 		}
 		uni_path_ += unicomp;
 	}
-	update_native_path();
+	invalidate_cache();
 	return *this;
 }
 
+path path_builder::build() const
+{
+	// worst case: every component normalizes to its maximum length and needs a separator.
+	size_t maxlen = 0;
+	for (int i=0; i<count_; ++i) {
+		const auto& comp = at(i);
+		maxlen += 1 + (comp.universal ? comp.str.length() : ConvertFromMswMaxLen(comp.str.length()));
+	}
+
+	path result;
+	auto& out = result.uni_path_;
+	out.resize(maxlen);
+
+	size_t length = 0;
+	for (int i=0; i<count_; ++i) {
+		const auto& comp = at(i);
+		if (comp.str.empty()) continue;
+
+		// normalize in place past the current end, leaving room for a separator.
+		char*  dst = &out[length + 1];
+		size_t complen;
+		if (comp.universal) {
+			memcpy(dst, comp.str.data(), comp.str.length());
+			complen = comp.str.length();
+		}
+		else {
+			path_error error;
+			complen = PathFromString(dst, comp.str, &error);
+			if (error != path_error::none) {
+				report_path_error(comp.str, error);
+				complen = 0;
+			}
+		}
+
+		if (complen && dst[0] == '/') {
+			// rooted component overrides everything before it, same as path::append().
+			memmove(&out[0], dst, complen);
+			length = complen;
+		}
+		elif (length && out[length-1] != '/') {
+			out[length] = '/';
+			length += 1 + complen;
+		}
+		else {
+			memmove(&out[length], dst, complen);
+			length += complen;
+		}
+	}
+
+	out.resize(length);
+	return result;
+}
+
 path& path::concat(const std::string& src)
 {
 	// implementation mimics std::filesystem in that it performs no platform-specific
@@ -237,9 +518,98 @@ path& path::concat(const std::string& src)
 	// string contains backslashes they will be treated as literal backslashes (valid filename
 	// characters on a unix filesystem).
 
-	uni_path_  += src;
-	libc_path_ += src;
+	uni_path_ += src;
+	invalidate_cache();
 	return *this;
 }
 
+void path_list::release()
+{
+	// swap-to-empty is the only portable way to actually free vector storage.
+	std::vector<char>		().swap(strings_);
+	std::vector<uint32_t>	().swap(offsets_);
+}
+
+void path_list::push_back(path_view uni_path)
+{
+	auto src    = uni_path.uni_string();
+	auto offset = strings_.size();
+	rel_check(offset + src.length() + 1 <= UINT32_MAX, "path_list exceeded 4GB of path storage.");
+
+	// the source may be a view of one of our own entries, which won't survive a reallocation.
+	const char* srcdata = src.data();
+	bool aliased = !strings_.empty() && srcdata >= strings_.data() && srcdata < strings_.data() + offset;
+	auto srcpos  = aliased ? (srcdata - strings_.data()) : 0;
+
+	strings_.resize(offset + src.length() + 1);
+	if (aliased) {
+		srcdata = strings_.data() + srcpos;
+	}
+	memcpy(strings_.data() + offset, srcdata, src.length());
+	strings_.back() = 0;
+	offsets_.push_back(uint32_t(offset));
+}
+
+void path_list::append(const path_list& src)
+{
+	auto base = strings_.size();
+	rel_check(base + src.strings_.size() <= UINT32_MAX, "path_list exceeded 4GB of path storage.");
+
+	strings_.insert(strings_.end(), src.strings_.begin(), src.strings_.end());
+	offsets_.reserve(offsets_.size() + src.offsets_.size());
+	for (auto offset : src.offsets_) {
+		offsets_.push_back(uint32_t(base + offset));
+	}
+}
+
+path_error path_list::push_back_raw(std::string_view src)
+{
+	// normalize directly into our storage, no temporary string required.
+	auto offset = strings_.size();
+	auto maxlen = ConvertFromMswMaxLen(src.length());
+	rel_check(offset + maxlen + 1 <= UINT32_MAX, "path_list exceeded 4GB of path storage.");
+
+	path_error error;
+	strings_.resize(offset + maxlen + 1);
+	auto length = PathFromString(strings_.data() + offset, src, &error);
+	strings_.resize(offset + length + 1);
+	strings_.back() = 0;
+	offsets_.push_back(uint32_t(offset));
+	return error;
+}
+
+int PathsFromStrings(path_list& dest, const char* const* srcs, size_t count, std::vector<path_error>* errors)
+{
+	if (errors) {
+		errors->assign(count, path_error::none);
+	}
+
+	// sub-lists are merged in chunk order afterward, which keeps output indices matched to input.
+	const size_t min_chunk = 8192;
+	int chunks = ParallelChunkCount(count, min_chunk);
+	std::vector<path_list> partial(chunks - 1);
+	std::vector<int> failures(chunks, 0);
+
+	ParallelForChunks(count, chunks, [&](int chunk, size_t beg, size_t end) {
+		path_list& out = chunk ? partial[chunk - 1] : dest;
+		out.reserve(out.size() + (end - beg), 0);
+		for (size_t i=beg; i<end; ++i) {
+			auto error = out.push_back_raw(srcs[i] ? srcs[i] : "");
+			if (error != path_error::none) {
+				if (errors) {
+					(*errors)[i] = error;
+				}
+				failures[chunk]++;
+			}
+		}
+	});
+
+	int total = failures[0];
+	for (int i=0; i<chunks-1; ++i) {
+		dest.append(partial[i]);
+		total += failures[i + 1];
+	}
+	return total;
+}
+
 }
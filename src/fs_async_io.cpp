@@ -0,0 +1,321 @@
+#include "fs_async_io.h"
+#include "icy_assert.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#if PLATFORM_LINUX
+#	include <cstring>
+#	include <linux/io_uring.h>
+#	include <sys/mman.h>
+#	include <sys/syscall.h>
+#	include <unistd.h>
+#endif
+
+namespace fs {
+
+// --------------------------------------------------------------------------------------------------
+// thread_pool backend: the fallback everywhere io_uring isn't available.
+//
+struct io_engine::pool
+{
+	std::mutex						mutex;
+	std::condition_variable			work_cv;
+	std::condition_variable			done_cv;
+	std::deque<io_request>			work;
+	std::deque<io_completion>		done;
+	std::vector<io_request>			staged;			// queued, owner thread only
+	std::vector<std::thread>		threads;
+	bool							quit = false;
+
+	pool(int nthreads) {
+		for (int i=0; i<nthreads; ++i) {
+			threads.emplace_back([this]() { worker(); });
+		}
+	}
+
+	~pool() {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			quit = true;
+		}
+		work_cv.notify_all();
+		for (auto& thread : threads) {
+			thread.join();
+		}
+	}
+
+	void worker() {
+		std::unique_lock<std::mutex> lock(mutex);
+		while (1) {
+			work_cv.wait(lock, [&]() { return quit || !work.empty(); });
+			if (quit) return;
+
+			auto req = work.front();
+			work.pop_front();
+			lock.unlock();
+
+			auto got = (req.op == io_op::read)
+				? posix_pread (req.fd, req.buffer, req.length, req.offset)
+				: posix_pwrite(req.fd, req.buffer, req.length, req.offset);
+			io_completion result = { req.user_data, (intmax_t(got) < 0) ? -intmax_t(errno) : intmax_t(got) };
+
+			lock.lock();
+			done.push_back(result);
+			done_cv.notify_one();
+		}
+	}
+};
+
+#if PLATFORM_LINUX
+// --------------------------------------------------------------------------------------------------
+// io_uring backend, through the raw syscalls (no liburing dependency).
+//
+// The submission queue is filled directly by queue() and published by submit(), so a batch is one
+// io_uring_enter(). The completion ring is read without a syscall unless waiting is required.
+//
+struct io_engine::uring
+{
+	int					fd			= -1;
+
+	void*				sq_ring		= nullptr;
+	size_t				sq_ring_len	= 0;
+	void*				cq_ring		= nullptr;
+	size_t				cq_ring_len	= 0;
+	io_uring_sqe*		sqes		= nullptr;
+	size_t				sqes_len	= 0;
+
+	unsigned*			sq_tail		= nullptr;
+	unsigned*			sq_mask		= nullptr;
+	unsigned*			sq_array	= nullptr;
+	unsigned*			cq_head		= nullptr;
+	unsigned*			cq_tail		= nullptr;
+	unsigned*			cq_mask		= nullptr;
+	io_uring_cqe*		cqes		= nullptr;
+
+	unsigned			local_tail	= 0;			// sq tail including queued, unpublished entries
+	unsigned			published	= 0;			// sq tail as last seen by the kernel
+
+	~uring() {
+		if (sqes)							munmap(sqes, sqes_len);
+		if (cq_ring && cq_ring != sq_ring)	munmap(cq_ring, cq_ring_len);
+		if (sq_ring)						munmap(sq_ring, sq_ring_len);
+		if (fd >= 0)						close(fd);
+	}
+
+	static int enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags) {
+		return int(syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, nullptr, 0));
+	}
+
+	bool init(unsigned entries) {
+		io_uring_params params = {};
+		fd = int(syscall(__NR_io_uring_setup, entries, &params));
+		if (fd < 0) return false;
+
+		// IORING_OP_READ/WRITE arrived in 5.6, this feature flag in 5.7.
+		if (!(params.features & IORING_FEAT_FAST_POLL)) return false;
+
+		sq_ring_len = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+		cq_ring_len = params.cq_off.cqes  + params.cq_entries * sizeof(io_uring_cqe);
+		bool single = !!(params.features & IORING_FEAT_SINGLE_MMAP);
+		if (single) {
+			sq_ring_len = cq_ring_len = std::max(sq_ring_len, cq_ring_len);
+		}
+
+		sq_ring = mmap(nullptr, sq_ring_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+		if (sq_ring == MAP_FAILED) { sq_ring = nullptr; return false; }
+
+		if (single) {
+			cq_ring = sq_ring;
+		}
+		else {
+			cq_ring = mmap(nullptr, cq_ring_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+			if (cq_ring == MAP_FAILED) { cq_ring = nullptr; return false; }
+		}
+
+		sqes_len = params.sq_entries * sizeof(io_uring_sqe);
+		auto* sqe_mem = mmap(nullptr, sqes_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+		if (sqe_mem == MAP_FAILED) return false;
+		sqes = (io_uring_sqe*)sqe_mem;
+
+		auto* sq = (char*)sq_ring;
+		auto* cq = (char*)cq_ring;
+		sq_tail		= (unsigned*)(sq + params.sq_off.tail);
+		sq_mask		= (unsigned*)(sq + params.sq_off.ring_mask);
+		sq_array	= (unsigned*)(sq + params.sq_off.array);
+		cq_head		= (unsigned*)(cq + params.cq_off.head);
+		cq_tail		= (unsigned*)(cq + params.cq_off.tail);
+		cq_mask		= (unsigned*)(cq + params.cq_off.ring_mask);
+		cqes		= (io_uring_cqe*)(cq + params.cq_off.cqes);
+
+		local_tail = published = __atomic_load_n(sq_tail, __ATOMIC_ACQUIRE);
+		return true;
+	}
+
+	void push(const io_request& req) {
+		auto idx = local_tail & *sq_mask;
+		auto& sqe = sqes[idx];
+		memset(&sqe, 0, sizeof(sqe));
+		sqe.opcode		= (req.op == io_op::read) ? IORING_OP_READ : IORING_OP_WRITE;
+		sqe.fd			= req.fd;
+		sqe.off			= uint64_t(req.offset);
+		sqe.addr		= uint64_t(uintptr_t(req.buffer));
+		sqe.len			= unsigned(std::min<size_t>(req.length, 0x7fff'f000));		// longer requests complete short
+		sqe.user_data	= uint64_t(req.user_data);
+		sq_array[idx]	= idx;
+		++local_tail;
+	}
+
+	// returns the number of entries the kernel accepted.
+	size_t publish() {
+		__atomic_store_n(sq_tail, local_tail, __ATOMIC_RELEASE);
+
+		size_t accepted = 0;
+		while (published != local_tail) {
+			int got = enter(fd, local_tail - published, 0, 0);
+			if (got < 0) {
+				if (errno == EINTR) continue;
+				if ((errno == EAGAIN || errno == EBUSY) && accepted) break;		// retried by the next submit()
+				rel_check(errno == EAGAIN || errno == EBUSY, "io_uring_enter failed, errno=%d", errno);
+				break;
+			}
+			published += unsigned(got);
+			accepted  += unsigned(got);
+		}
+		return accepted;
+	}
+
+	size_t reap(io_completion* dest, size_t max) {
+		auto head = *cq_head;
+		auto tail = __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE);
+		size_t got = 0;
+		while (head != tail && got < max) {
+			const auto& cqe = cqes[head & *cq_mask];
+			dest[got++] = { uintptr_t(cqe.user_data), intmax_t(cqe.res) };
+			++head;
+		}
+		__atomic_store_n(cq_head, head, __ATOMIC_RELEASE);
+		return got;
+	}
+
+	void wait(unsigned min_complete) {
+		if (enter(fd, 0, min_complete, IORING_ENTER_GETEVENTS) < 0) {
+			rel_check(errno == EINTR || errno == EAGAIN || errno == EBUSY, "io_uring_enter failed, errno=%d", errno);
+		}
+	}
+};
+#else
+struct io_engine::uring { };
+#endif
+
+io_engine::io_engine(const io_engine_options& options) {
+	depth_ = std::max(1u, options.queue_depth);
+
+#if PLATFORM_LINUX
+	if (!options.force_thread_pool) {
+		std::unique_ptr<uring> ring(new uring);
+		if (ring->init(depth_)) {
+			uring_ = std::move(ring);
+			return;
+		}
+	}
+#endif
+
+	// workers spend their time blocked in the kernel, so more of them than cores pays off.
+	int nthreads = options.threads;
+	if (nthreads <= 0) {
+		nthreads = std::clamp(int(std::thread::hardware_concurrency()) * 2, 4, 32);
+	}
+	pool_.reset(new pool(std::min(nthreads, int(depth_))));
+}
+
+io_engine::~io_engine() {
+	// requests still in flight reference caller buffers: wait them out before tearing down.
+	while (outstanding()) {
+		io_completion scratch[64];
+		poll(scratch, 64, 1);
+	}
+}
+
+io_backend io_engine::backend() const {
+	return uring_ ? io_backend::io_uring : io_backend::thread_pool;
+}
+
+bool io_engine::queue(const io_request& request) {
+	if (outstanding() >= depth_) return false;
+
+#if PLATFORM_LINUX
+	if (uring_) {
+		uring_->push(request);
+		++queued_;
+		return true;
+	}
+#endif
+	pool_->staged.push_back(request);
+	++queued_;
+	return true;
+}
+
+size_t io_engine::submit() {
+	if (!queued_) return 0;
+
+	size_t issued = 0;
+#if PLATFORM_LINUX
+	if (uring_) {
+		issued = uring_->publish();
+	}
+	else
+#endif
+	{
+		{
+			std::lock_guard<std::mutex> lock(pool_->mutex);
+			pool_->work.insert(pool_->work.end(), pool_->staged.begin(), pool_->staged.end());
+		}
+		issued = pool_->staged.size();
+		pool_->staged.clear();
+		if (issued == 1) {
+			pool_->work_cv.notify_one();
+		}
+		else {
+			pool_->work_cv.notify_all();
+		}
+	}
+
+	queued_    -= issued;
+	in_flight_ += issued;
+	return issued;
+}
+
+size_t io_engine::poll(io_completion* dest, size_t max, size_t min_complete) {
+	submit();
+	min_complete = std::min({ min_complete, max, in_flight_ });
+
+	size_t got = 0;
+#if PLATFORM_LINUX
+	if (uring_) {
+		while (1) {
+			got += uring_->reap(dest + got, max - got);
+			if (got >= min_complete) break;
+			uring_->wait(unsigned(min_complete - got));
+		}
+	}
+	else
+#endif
+	{
+		std::unique_lock<std::mutex> lock(pool_->mutex);
+		pool_->done_cv.wait(lock, [&]() { return pool_->done.size() >= min_complete; });
+		got = std::min(max, pool_->done.size());
+		std::copy_n(pool_->done.begin(), got, dest);
+		pool_->done.erase(pool_->done.begin(), pool_->done.begin() + got);
+	}
+
+	in_flight_ -= got;
+	return got;
+}
+
+} // namespace fs
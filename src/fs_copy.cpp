@@ -0,0 +1,403 @@
+#include "fs_copy.h"
+#include "fs_walk.h"
+#include "parallel_for.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if PLATFORM_MSW
+#	define NOMINMAX
+#	define NO_STRICT
+#	define WIN32_LEAN_AND_MEAN
+#	include <Windows.h>
+#elif PLATFORM_POSIX
+#	include <fcntl.h>
+#	include <unistd.h>
+#	include <sys/stat.h>
+#	if PLATFORM_LINUX
+#		include <linux/fs.h>
+#		include <sys/ioctl.h>
+#		include <sys/sendfile.h>
+#	endif
+#endif
+
+namespace fs {
+
+const char* copy_method_name(copy_method method) {
+	switch (method) {
+		case copy_method::none:				return "none";
+		case copy_method::reflink:			return "reflink";
+		case copy_method::copy_file_range:	return "copy_file_range";
+		case copy_method::sendfile:			return "sendfile";
+		case copy_method::read_write:		return "read_write";
+		case copy_method::platform:			return "platform";
+	}
+	return "unknown";
+}
+
+enum class step_result {
+	done,				// reached the end of the source
+	unsupported,		// method doesn't apply to this pair of files, try the next
+	failed,
+};
+
+// errors which mean a method isn't available for these files, rather than that the copy failed.
+static bool is_unsupported(int err) {
+	return err == EXDEV || err == EINVAL || err == ENOSYS || err == EOPNOTSUPP || err == ENOTTY;
+}
+
+// All methods copy from offset `copied` onward and advance it, so a method abandoned midway leaves
+// the next one to carry on where it stopped.
+static step_result copy_read_write(int in, int out, x_off_t size_hint, x_off_t& copied, int& err) {
+	// small files get a small buffer: a megabyte per file adds up over a tree of thousands.
+	auto bufsize = size_t(std::clamp<x_off_t>(size_hint - copied, 4096, 1024 * 1024));
+	std::unique_ptr<uint8_t[]> buf(new uint8_t[bufsize]);
+
+	while (1) {
+		auto got = intmax_t(posix_pread(in, buf.get(), bufsize, copied));
+		if (got < 0) {
+			if (errno == EINTR) continue;
+			err = errno;
+			return step_result::failed;
+		}
+		if (!got) return step_result::done;
+
+		intmax_t put = 0;
+		while (put < got) {
+			auto wrote = intmax_t(posix_pwrite(out, buf.get() + put, size_t(got - put), copied + put));
+			if (wrote < 0) {
+				if (errno == EINTR) continue;
+				err = errno;
+				return step_result::failed;
+			}
+			put += wrote;
+		}
+		copied += got;
+	}
+}
+
+#if PLATFORM_LINUX
+static const size_t max_kernel_chunk = 1024 * 1024 * 1024;
+
+static step_result copy_reflink(int in, int out, x_off_t& copied, int& err) {
+#if defined(FICLONE)
+	if (copied == 0 && ioctl(out, FICLONE, in) == 0) {
+		copied = posix_fstat(in).st_size;
+		return step_result::done;
+	}
+	err = errno;
+	return is_unsupported(err) ? step_result::unsupported : step_result::failed;
+#else
+	return step_result::unsupported;
+#endif
+}
+
+static step_result copy_kernel_range(int in, int out, x_off_t& copied, int& err) {
+	while (1) {
+		loff_t off_in  = loff_t(copied);
+		loff_t off_out = loff_t(copied);
+		auto got = copy_file_range(in, &off_in, out, &off_out, max_kernel_chunk, 0);
+		if (got < 0) {
+			if (errno == EINTR) continue;
+			err = errno;
+			return is_unsupported(err) ? step_result::unsupported : step_result::failed;
+		}
+		if (!got) return step_result::done;
+		copied += got;
+	}
+}
+
+static step_result copy_sendfile(int in, int out, x_off_t& copied, int& err) {
+	// sendfile writes at the output's file position rather than taking an offset.
+	if (lseek(out, off_t(copied), SEEK_SET) < 0) {
+		err = errno;
+		return step_result::failed;
+	}
+	while (1) {
+		off_t offset = off_t(copied);
+		auto got = sendfile(out, in, &offset, max_kernel_chunk);
+		if (got < 0) {
+			if (errno == EINTR) continue;
+			err = errno;
+			return is_unsupported(err) ? step_result::unsupported : step_result::failed;
+		}
+		if (!got) return step_result::done;
+		copied += got;
+	}
+}
+#endif
+
+// whether two open files are one and the same, eg. a path and a hard link to it.
+static bool same_file(int a, int b) {
+#if PLATFORM_MSW
+	BY_HANDLE_FILE_INFORMATION ia, ib;
+	if (!GetFileInformationByHandle((HANDLE)_get_osfhandle(a), &ia)) return false;
+	if (!GetFileInformationByHandle((HANDLE)_get_osfhandle(b), &ib)) return false;
+	return ia.dwVolumeSerialNumber == ib.dwVolumeSerialNumber
+		&& ia.nFileIndexHigh == ib.nFileIndexHigh && ia.nFileIndexLow == ib.nFileIndexLow;
+#else
+	struct stat sa, sb;
+	return fstat(a, &sa) == 0 && fstat(b, &sb) == 0 && sa.st_dev == sb.st_dev && sa.st_ino == sb.st_ino;
+#endif
+}
+
+#if PLATFORM_MSW
+static std::wstring to_wide(const path& src) {
+	std::string native = src.asLibcStr();
+	int wlen = MultiByteToWideChar(CP_UTF8, 0, native.c_str(), -1, nullptr, 0);
+	std::wstring result(wlen, 0);
+	MultiByteToWideChar(CP_UTF8, 0, native.c_str(), -1, &result[0], wlen);
+	return result;
+}
+#endif
+
+copy_result copy_file(const path& src, const path& dest, const copy_options& options)
+{
+	copy_result result;
+
+#if PLATFORM_MSW
+	if (options.first_method != copy_method::read_write) {
+		// CopyFileExW always carries over attributes and timestamps.
+		DWORD flags = options.overwrite ? 0 : COPY_FILE_FAIL_IF_EXISTS;
+		if (!CopyFileExW(to_wide(src).c_str(), to_wide(dest).c_str(), nullptr, nullptr, nullptr, flags)) {
+			result.error = int(GetLastError());
+			return result;
+		}
+		result.method = copy_method::platform;
+		result.bytes  = status(dest).st_size;
+		return result;
+	}
+#endif
+
+	int in = posix_open(src.c_str(), O_RDONLY, 0);
+	if (in < 0) {
+		result.error = errno;
+		return result;
+	}
+
+	auto st = posix_fstat(in);
+	// not O_TRUNC: copying a file onto itself would empty it before the check below could tell.
+	int flags = O_WRONLY | O_CREAT | (options.overwrite ? 0 : O_EXCL);
+	int out = posix_open(dest.c_str(), flags, options.preserve_mode ? int(st.st_mode & 07777) : DEFFILEMODE);
+	if (out < 0) {
+		result.error = errno;
+		posix_close(in);
+		return result;
+	}
+	if (same_file(in, out)) {
+		result.error = EINVAL;			// as std::filesystem::copy_file
+		posix_close(in);
+		posix_close(out);
+		return result;
+	}
+#if PLATFORM_MSW
+	int truncated = int(_chsize_s(out, 0));
+#else
+	int truncated = (ftruncate(out, 0) < 0) ? errno : 0;
+#endif
+	if (truncated) {
+		result.error = truncated;
+		posix_close(in);
+		posix_close(out);
+		return result;
+	}
+
+	x_off_t copied = 0;
+	int err = 0;
+	auto step = step_result::unsupported;
+	auto method = options.first_method;
+
+#if PLATFORM_LINUX
+	if (method <= copy_method::reflink) {
+		method = copy_method::reflink;
+		step = copy_reflink(in, out, copied, err);
+	}
+	if (step == step_result::unsupported && method <= copy_method::copy_file_range) {
+		method = copy_method::copy_file_range;
+		step = copy_kernel_range(in, out, copied, err);
+	}
+	if (step == step_result::unsupported && method <= copy_method::sendfile) {
+		method = copy_method::sendfile;
+		step = copy_sendfile(in, out, copied, err);
+	}
+#endif
+	if (step == step_result::unsupported) {
+		method = copy_method::read_write;
+		step = copy_read_write(in, out, st.st_size, copied, err);
+	}
+	if (step == step_result::done) {
+		err = 0;			// left over from methods that were skipped
+	}
+
+#if PLATFORM_POSIX
+	if (step == step_result::done && options.preserve_mode) {
+		// the mode given to open() is subject to umask, and ignored for existing files.
+		if (fchmod(out, mode_t(st.st_mode & 07777)) < 0) err = errno;
+	}
+	if (step == step_result::done && options.preserve_times) {
+		struct stat native;
+		if (fstat(in, &native) < 0) {
+			err = errno;
+		}
+		else {
+#	if defined(__APPLE__)
+			struct timespec times[2] = { native.st_atimespec, native.st_mtimespec };
+#	else
+			struct timespec times[2] = { native.st_atim, native.st_mtim };
+#	endif
+			if (futimens(out, times) < 0) err = errno;
+		}
+	}
+#endif
+
+	posix_close(in);
+	if (posix_close(out) < 0 && !err) {
+		err = errno;
+	}
+
+	if (step != step_result::done || err) {
+		result.error = err ? err : EIO;
+		return result;
+	}
+	result.method = method;
+	result.bytes  = copied;
+	return result;
+}
+
+// entry names never contain separators nor need normalization: operator/ would take a ':' or '\'
+// in one for msw path syntax.
+static path join(const path& root, std::string_view relative) {
+	std::string joined = root.uni_string();
+	joined += '/';
+	joined += relative;
+	return path(path_view(joined));
+}
+
+copy_tree_stats copy_tree(const path& src, const path& dest, const copy_options& options)
+{
+	struct item {
+		std::string		relative;
+		file_type		type;
+		int				depth;
+	};
+
+	copy_tree_stats stats;
+	std::mutex mutex;
+	std::vector<item> dirs;
+	std::vector<item> files;
+
+	walk_options walk_opts;
+	walk_opts.threads = options.threads;
+	auto listed = walk(src, [&](const walk_entry& entry) {
+		std::lock_guard<std::mutex> lock(mutex);
+		auto& list = entry.is_directory() ? dirs : files;
+		list.push_back({ std::string(entry.relative), entry.type, entry.depth });
+	}, walk_opts);
+	stats.errors += listed.errors;
+
+	// parents before children, which is also the order directory attributes are applied in reverse.
+	std::sort(dirs.begin(), dirs.end(), [](const item& a, const item& b) { return a.depth < b.depth; });
+
+	std::vector<path> dest_dirs;
+	dest_dirs.reserve(dirs.size() + 1);
+	dest_dirs.push_back(dest);
+	for (const auto& dir : dirs) {
+		dest_dirs.push_back(join(dest, dir.relative));
+	}
+	std::vector<int> created;
+	auto failed = create_directories(dest_dirs, &created);
+	if (created[0]) {
+		stats.errors += failed;
+		return stats;
+	}
+	stats.dirs	  = intmax_t(dest_dirs.size()) - failed;
+	stats.errors += failed;
+
+	// workers pull files off a shared index, so one slow file doesn't hold up a whole chunk.
+	int nthreads = (options.threads > 0) ? options.threads : std::max(1, int(std::thread::hardware_concurrency()));
+	nthreads = std::max(1, std::min(nthreads, int(files.size())));
+
+	std::atomic<size_t>		next	= { 0 };
+	std::atomic<intmax_t>	copied	= { 0 };
+	std::atomic<intmax_t>	bytes	= { 0 };
+	std::atomic<intmax_t>	links	= { 0 };
+	std::atomic<intmax_t>	errors	= { 0 };
+
+	ParallelForChunks(size_t(nthreads), nthreads, [&](int, size_t, size_t) {
+		size_t idx;
+		while ((idx = next++) < files.size()) {
+			const auto& file = files[idx];
+			auto from = join(src,  file.relative);
+			auto to   = join(dest, file.relative);
+
+			if (file.type == file_type::symlink) {
+#if PLATFORM_POSIX
+				char target[4096];
+				auto len = readlink(from.c_str(), target, sizeof(target) - 1);
+				if (len >= 0) {
+					target[len] = 0;
+					if (!options.overwrite || unlink(to.c_str()) == 0 || errno == ENOENT) {
+						if (symlink(target, to.c_str()) == 0) {
+							++links;
+							continue;
+						}
+					}
+				}
+				++errors;
+#endif
+				continue;
+			}
+			if (file.type != file_type::regular && file.type != file_type::unknown) {
+				continue;			// devices, fifos and sockets aren't copied
+			}
+
+			auto result = copy_file(from, to, options);
+			if (result.ok()) {
+				++copied;
+				bytes += result.bytes;
+			}
+			else {
+				++errors;
+			}
+		}
+	});
+
+	stats.files		 = copied;
+	stats.bytes		 = bytes;
+	stats.symlinks	 = links;
+	stats.errors	+= errors;
+
+#if PLATFORM_POSIX
+	// directory times change as entries are created in them, so they're applied last, deepest first.
+	if (options.preserve_mode || options.preserve_times) {
+		auto apply = [&](const path& from, const path& to) {
+			struct stat native;
+			if (stat(from.c_str(), &native) < 0) return;
+			if (options.preserve_mode) {
+				chmod(to.c_str(), mode_t(native.st_mode & 07777));
+			}
+			if (options.preserve_times) {
+#	if defined(__APPLE__)
+				struct timespec times[2] = { native.st_atimespec, native.st_mtimespec };
+#	else
+				struct timespec times[2] = { native.st_atim, native.st_mtim };
+#	endif
+				utimensat(AT_FDCWD, to.c_str(), times, 0);
+			}
+		};
+		for (auto it = dirs.rbegin(); it != dirs.rend(); ++it) {
+			apply(join(src, it->relative), join(dest, it->relative));
+		}
+		apply(src, dest);
+	}
+#endif
+	return stats;
+}
+
+} // namespace fs
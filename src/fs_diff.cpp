@@ -0,0 +1,350 @@
+#include "fs_diff.h"
+#include "fs_directory.h"
+#include "fs_walk.h"
+#include "parallel_for.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <iterator>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if PLATFORM_MSW
+#	define NOMINMAX
+#	define NO_STRICT
+#	define WIN32_LEAN_AND_MEAN
+#	include <Windows.h>
+#elif PLATFORM_POSIX
+#	include <fcntl.h>
+#	include <unistd.h>
+#	include <sys/stat.h>
+#endif
+
+namespace fs {
+
+const char* change_type_name(change_type type) {
+	switch (type) {
+		case change_type::added:		return "added";
+		case change_type::removed:		return "removed";
+		case change_type::modified:		return "modified";
+	}
+	return "unknown";
+}
+
+// the directory (or whatever took its place) is gone, along with everything that was in it.
+static bool is_gone(int err) {
+#if PLATFORM_MSW
+	return err == ERROR_FILE_NOT_FOUND || err == ERROR_PATH_NOT_FOUND || err == ERROR_DIRECTORY;
+#else
+	return err == ENOENT || err == ENOTDIR || err == ELOOP;
+#endif
+}
+
+#if PLATFORM_POSIX
+static CStatInfo stat_info(const struct stat& sinfo) {
+	return { uint32_t(sinfo.st_mode), intmax_t(sinfo.st_size), sinfo.st_atime, sinfo.st_mtime, sinfo.st_ctime };
+}
+#endif
+
+// A snapshot directory, open for stat'ing its entries by name.
+class diff_directory
+{
+protected:
+#if PLATFORM_POSIX
+	int				fd_		= -1;
+#endif
+	std::string		dir_;					// universal path, with a trailing '/'
+	std::string		fullpath_;
+
+public:
+	~diff_directory() { close(); }
+
+	// returns 0 or an error code, and the directory's own stat on success.
+	int open(const std::string& dir, bool follow, CStatInfo& info) {
+		dir_ = dir;
+		dir_ += '/';
+#if PLATFORM_POSIX
+		fd_ = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC | (follow ? 0 : O_NOFOLLOW));
+		if (fd_ < 0) {
+			return errno;
+		}
+		struct stat sinfo;
+		if (fstat(fd_, &sinfo) < 0) {
+			return errno;
+		}
+		info = stat_info(sinfo);
+#else
+		info = status(path(path_view(dir)));
+		if (!info.Exists()) return ERROR_PATH_NOT_FOUND;
+		if (!info.IsDir())  return ERROR_DIRECTORY;
+#endif
+		return 0;
+	}
+
+	void close() {
+#if PLATFORM_POSIX
+		if (fd_ >= 0) {
+			::close(fd_);
+			fd_ = -1;
+		}
+#endif
+	}
+
+	// name must be null-terminated. Returns 0 or an error code.
+	int stat(std::string_view name, CStatInfo& dest) {
+#if PLATFORM_POSIX
+		struct stat sinfo;
+		if (fstatat(fd_, name.data(), &sinfo, AT_SYMLINK_NOFOLLOW) < 0) {
+			return errno;
+		}
+		dest = stat_info(sinfo);
+		return 0;
+#else
+		dest = status(path(path_view(join(name))));
+		return dest.Exists() ? 0 : ERROR_FILE_NOT_FOUND;
+#endif
+	}
+
+	directory_stream list() const {
+#if PLATFORM_POSIX
+		int fd = fcntl(fd_, F_DUPFD_CLOEXEC, 0);
+		return (fd < 0) ? directory_stream() : directory_stream::adopt_fd(fd);
+#else
+		return directory_stream(path(path_view(dir_)));
+#endif
+	}
+
+	const std::string& join(std::string_view name) {
+		fullpath_  = dir_;
+		fullpath_ += name;
+		return fullpath_;
+	}
+};
+
+class differ
+{
+protected:
+	const snapshot&			snap_;
+	const diff_options&		options_;
+	std::string				root_;
+
+	std::atomic<intmax_t>	checked_	= { 0 };
+	std::atomic<intmax_t>	listed_		= { 0 };
+	std::atomic<intmax_t>	pruned_		= { 0 };
+	std::atomic<intmax_t>	errors_		= { 0 };
+
+public:
+	differ(const snapshot& snap, const path& root, const diff_options& options)
+		: snap_(snap), options_(options), root_(root.uni_string()) { }
+
+	diff_result run() {
+		diff_result result;
+
+		std::vector<size_t> dirs;
+		for (size_t idx=0; idx<snap_.size(); ++idx) {
+			if (snap_[idx].is_directory()) dirs.push_back(idx);
+		}
+
+		int nthreads = (options_.threads > 0) ? options_.threads : std::max(1, int(std::thread::hardware_concurrency()));
+		nthreads = std::max(1, std::min(nthreads, int(dirs.size())));
+		std::vector<std::vector<diff_entry>> partial(nthreads);
+		std::atomic<int> root_error = { 0 };
+
+		// directories vary from empty to huge, so workers pull them one at a time.
+		std::atomic<size_t> next = { 0 };
+		ParallelForChunks(size_t(nthreads), nthreads, [&](int worker, size_t, size_t) {
+			diff_directory dir;
+			size_t idx;
+			while ((idx = next++) < dirs.size()) {
+				int err = compare_directory(dirs[idx], dir, partial[worker]);
+				if (dirs[idx] == 0) root_error = err;
+				dir.close();
+			}
+		});
+
+		if (root_error) {
+			result.error = root_error;
+			return result;
+		}
+
+		size_t total = 0;
+		for (const auto& list : partial) total += list.size();
+		result.changes.reserve(total);
+		for (auto& list : partial) {
+			std::move(list.begin(), list.end(), std::back_inserter(result.changes));
+		}
+		std::sort(result.changes.begin(), result.changes.end(), [](const diff_entry& a, const diff_entry& b) {
+			return component_less(a.relative, b.relative);
+		});
+
+		result.checked		= checked_;
+		result.dirs_listed	= listed_;
+		result.dirs_pruned	= pruned_;
+		result.errors		= errors_;
+		return result;
+	}
+
+protected:
+	bool accepts(std::string_view relative, bool is_directory) const {
+		return !options_.filter || options_.filter(relative, is_directory);
+	}
+
+	bool differs(const CStatInfo& before, const CStatInfo& after) const {
+		if (before.st_mode != after.st_mode) return true;
+		if (after.IsDir()) return false;
+		return before.st_size		!= after.st_size
+			|| before.time_modified	!= after.time_modified
+			|| before.time_created	!= after.time_created
+			|| (options_.compare_access_time && before.time_accessed != after.time_accessed);
+	}
+
+	// checks the direct children of snapshot directory dir_idx, and looks for new ones if the
+	// directory may have changed. Returns 0, or an error code if the directory couldn't be opened.
+	int compare_directory(size_t dir_idx, diff_directory& dir, std::vector<diff_entry>& out) {
+		auto dir_rel  = snap_.relative(dir_idx);
+		auto name_pos = dir_rel.empty() ? 0 : dir_rel.length() + 1;
+		auto end      = snap_.subtree_end(dir_idx);
+
+		std::string fullpath = root_;
+		if (!dir_rel.empty()) {
+			fullpath += '/';
+			fullpath += dir_rel;
+		}
+
+		// the root is followed if it's a symlink, as it was by write_snapshot().
+		CStatInfo now = {};
+		int err = dir.open(fullpath, dir_idx == 0, now);
+		if (err) {
+			if (dir_idx == 0) return err;
+			if (!is_gone(err)) {
+				errors_.fetch_add(1, std::memory_order_relaxed);
+				return err;
+			}
+			// the parent reports the directory itself; each subdirectory's task reports its own.
+			for (size_t child = dir_idx + 1; child < end; child = snap_.subtree_end(child)) {
+				out.push_back({ std::string(snap_.relative(child)), change_type::removed, snap_[child].info, {} });
+			}
+			return 0;
+		}
+
+		std::vector<std::string_view> known;
+		for (size_t child = dir_idx + 1; child < end; child = snap_.subtree_end(child)) {
+			auto rel  = snap_.relative(child);
+			if (rel.length() <= name_pos) {			// not below the directory: a corrupt record
+				errors_.fetch_add(1, std::memory_order_relaxed);
+				continue;
+			}
+			auto name = rel.substr(name_pos);		// null-terminated, as all snapshot strings
+			known.push_back(name);
+
+			auto before = snap_[child].info;
+			CStatInfo after;
+			int stat_err = dir.stat(name, after);
+			checked_.fetch_add(1, std::memory_order_relaxed);
+			if (stat_err) {
+				if (is_gone(stat_err)) {
+					out.push_back({ std::string(rel), change_type::removed, before, {} });
+				}
+				else {
+					errors_.fetch_add(1, std::memory_order_relaxed);
+				}
+				continue;
+			}
+			// a file written in the second the snapshot was taken may have been written again since,
+			// leaving the same timestamps: it's reported modified rather than risk missing a change.
+			bool racy = !before.IsDir() && before.time_modified >= snap_.created();
+			if (racy || differs(before, after)) {
+				out.push_back({ std::string(rel), change_type::modified, before, after });
+				if (!before.IsDir() && after.IsDir()) {
+					add_subtree(std::string(rel), dir.join(name), out);
+				}
+			}
+		}
+
+		// entries come and go only by changing the directory's mtime, which is trusted once it's
+		// older than the second the snapshot was started in.
+		const auto& recorded = snap_.record(dir_idx);
+		if (now.time_modified == time_t(recorded.time_modified) && time_t(recorded.time_modified) < snap_.created()) {
+			pruned_.fetch_add(1, std::memory_order_relaxed);
+			return 0;
+		}
+
+		listed_.fetch_add(1, std::memory_order_relaxed);
+		std::sort(known.begin(), known.end());
+		auto stream = dir.list();
+		std::string rel;
+		for (const auto& entry : stream) {
+			if (std::binary_search(known.begin(), known.end(), entry.name)) continue;
+
+			rel.assign(dir_rel);
+			if (!rel.empty()) rel += '/';
+			rel += entry.name;
+
+			CStatInfo after;
+			if (int stat_err = dir.stat(entry.name, after)) {
+				if (!is_gone(stat_err)) errors_.fetch_add(1, std::memory_order_relaxed);
+				continue;
+			}
+			if (!accepts(rel, after.IsDir())) continue;
+
+			out.push_back({ rel, change_type::added, {}, after });
+			if (after.IsDir()) {
+				add_subtree(rel, dir.join(entry.name), out);
+			}
+		}
+		if (stream.error()) {
+			errors_.fetch_add(1, std::memory_order_relaxed);
+		}
+		return 0;
+	}
+
+	// everything below a directory that isn't in the snapshot is new.
+	void add_subtree(const std::string& dir_rel, const std::string& fullpath, std::vector<diff_entry>& out) {
+		std::string rel;
+		auto relative_of = [&](const walk_entry& entry) -> const std::string& {
+			rel  = dir_rel;
+			rel += '/';
+			rel += entry.relative;
+			return rel;
+		};
+
+		walk_options walk_opts;
+		walk_opts.threads = 1;				// already on one of the diff workers
+		if (options_.filter) {
+			walk_opts.filter  = [&](const walk_entry& entry) { return accepts(relative_of(entry), entry.is_directory()); };
+			walk_opts.descend = walk_opts.filter;
+		}
+
+		auto listed = walk(path(path_view(fullpath)), [&](const walk_entry& entry) {
+#if PLATFORM_POSIX
+			std::string native(entry.path.uni_string());
+			struct stat sinfo;
+			if (lstat(native.c_str(), &sinfo) < 0) {
+				if (!is_gone(errno)) errors_.fetch_add(1, std::memory_order_relaxed);
+				return;
+			}
+			auto after = stat_info(sinfo);
+#else
+			auto after = status(path(entry.path));
+			if (!after.Exists()) return;
+#endif
+			out.push_back({ relative_of(entry), change_type::added, {}, after });
+		}, walk_opts);
+		errors_.fetch_add(listed.errors, std::memory_order_relaxed);
+	}
+};
+
+diff_result diff(const snapshot& before, const path& root, const diff_options& options)
+{
+	if (!before.is_open()) {
+		diff_result result;
+		result.error = EINVAL;
+		return result;
+	}
+	differ d(before, root, options);
+	return d.run();
+}
+
+} // namespace fs
@@ -0,0 +1,449 @@
+#include "fs_directory.h"
+#include "icy_assert.h"
+
+#include <algorithm>
+#include <numeric>
+
+#if PLATFORM_MSW
+#	define NOMINMAX
+#	define NO_STRICT
+#	define WIN32_LEAN_AND_MEAN
+#	include <Windows.h>
+#	include <sys/stat.h>
+#	include <string>
+#elif PLATFORM_POSIX
+#	include <dirent.h>
+#	include <fcntl.h>
+#	include <unistd.h>
+#	include <cerrno>
+#	include <sys/stat.h>
+#	if PLATFORM_LINUX
+#		include <sys/syscall.h>
+#	endif
+#endif
+
+namespace fs {
+
+static bool is_dot_or_dotdot(const char* name) {
+	return name[0] == '.' && (!name[1] || (name[1] == '.' && !name[2]));
+}
+
+#if PLATFORM_POSIX
+static file_type file_type_from_dtype(unsigned char d_type) {
+	switch (d_type) {
+		case DT_REG:	return file_type::regular;
+		case DT_DIR:	return file_type::directory;
+		case DT_LNK:	return file_type::symlink;
+		case DT_BLK:	return file_type::block;
+		case DT_CHR:	return file_type::character;
+		case DT_FIFO:	return file_type::fifo;
+		case DT_SOCK:	return file_type::socket;
+	}
+	return file_type::unknown;
+}
+
+static CStatInfo stat_at(int dirfd, const char* name) {
+	struct stat sinfo;
+	if (fstatat(dirfd, name, &sinfo, 0) == -1) {
+		return {};
+	}
+
+	return {
+		sinfo.st_mode,
+		sinfo.st_size,
+
+		sinfo.st_atime,
+		sinfo.st_mtime,
+		sinfo.st_ctime
+	};
+}
+#endif
+
+#if PLATFORM_LINUX
+// --------------------------------------------------------------------------------------------------
+// linux: getdents64 directly, which lets us pick a batch size far larger than readdir's.
+//
+struct linux_dirent64 {
+	uint64_t		d_ino;
+	int64_t			d_off;
+	unsigned short	d_reclen;
+	unsigned char	d_type;
+	char			d_name[];
+};
+
+struct directory_stream::platform_state {
+	int		fd		= -1;
+	int		pos		= 0;
+	int		len		= 0;
+	alignas(linux_dirent64) char buf[32 * 1024];
+
+	~platform_state() {
+		if (fd >= 0) close(fd);
+	}
+};
+
+directory_stream::directory_stream(const path& dir) {
+	int fd = open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if (fd < 0) {
+		error_ = errno;
+		return;
+	}
+	state_.reset(new platform_state);
+	state_->fd = fd;
+}
+
+directory_stream directory_stream::adopt_fd(int dirfd) {
+	directory_stream result;
+	if (dirfd < 0) {
+		result.error_ = EBADF;
+		return result;
+	}
+	result.state_.reset(new platform_state);
+	result.state_->fd = dirfd;
+	return result;
+}
+
+int directory_stream::native_fd() const {
+	return state_ ? state_->fd : -1;
+}
+
+bool directory_stream::next(dir_entry& dest) {
+	if (!state_) return false;
+	auto& st = *state_;
+
+	while (1) {
+		if (st.pos >= st.len) {
+			auto got = syscall(SYS_getdents64, st.fd, st.buf, sizeof(st.buf));
+			if (got <= 0) {
+				error_ = (got < 0) ? errno : 0;
+				return false;
+			}
+			st.pos = 0;
+			st.len = int(got);
+		}
+
+		auto* ent = (const linux_dirent64*)(st.buf + st.pos);
+		st.pos += ent->d_reclen;
+		if (is_dot_or_dotdot(ent->d_name)) continue;
+
+		dest.name = ent->d_name;
+		dest.type = file_type_from_dtype(ent->d_type);
+		return true;
+	}
+}
+
+CStatInfo directory_stream::status(const dir_entry& entry) const {
+	if (!state_) return {};
+	return stat_at(state_->fd, entry.name.data());
+}
+
+#elif PLATFORM_POSIX
+// --------------------------------------------------------------------------------------------------
+// other posix: readdir already reads in batches, into storage owned by the DIR.
+//
+struct directory_stream::platform_state {
+	DIR*	dir = nullptr;
+
+	~platform_state() {
+		if (dir) closedir(dir);
+	}
+};
+
+directory_stream::directory_stream(const path& dir) {
+	DIR* handle = opendir(dir.c_str());
+	if (!handle) {
+		error_ = errno;
+		return;
+	}
+	state_.reset(new platform_state);
+	state_->dir = handle;
+}
+
+directory_stream directory_stream::adopt_fd(int dirfd) {
+	directory_stream result;
+	DIR* handle = (dirfd >= 0) ? fdopendir(dirfd) : nullptr;
+	if (!handle) {
+		result.error_ = (dirfd >= 0) ? errno : EBADF;
+		if (dirfd >= 0) close(dirfd);
+		return result;
+	}
+	result.state_.reset(new platform_state);
+	result.state_->dir = handle;
+	return result;
+}
+
+int directory_stream::native_fd() const {
+	return state_ ? dirfd(state_->dir) : -1;
+}
+
+bool directory_stream::next(dir_entry& dest) {
+	if (!state_) return false;
+
+	while (1) {
+		errno = 0;
+		auto* ent = readdir(state_->dir);
+		if (!ent) {
+			error_ = errno;
+			return false;
+		}
+		if (is_dot_or_dotdot(ent->d_name)) continue;
+
+		dest.name = ent->d_name;
+		dest.type = file_type_from_dtype(ent->d_type);
+		return true;
+	}
+}
+
+CStatInfo directory_stream::status(const dir_entry& entry) const {
+	if (!state_) return {};
+	return stat_at(dirfd(state_->dir), entry.name.data());
+}
+
+#elif PLATFORM_MSW
+// --------------------------------------------------------------------------------------------------
+// msw: FindFirstFileEx in large-fetch mode. Names are converted to utf8 into a buffer owned by the
+// stream, and the find data doubles as stat data for status().
+//
+struct directory_stream::platform_state {
+	HANDLE				handle	= INVALID_HANDLE_VALUE;
+	bool				primed	= true;			// find data holds an entry not yet yielded
+	WIN32_FIND_DATAW	data;
+	char				name[MAX_PATH * 3 + 1];
+
+	~platform_state() {
+		if (handle != INVALID_HANDLE_VALUE) FindClose(handle);
+	}
+};
+
+static time_t time_from_filetime(const FILETIME& ft) {
+	auto ticks = (uint64_t(ft.dwHighDateTime) << 32) | ft.dwLowDateTime;
+	return time_t((ticks - 116444736000000000ULL) / 10000000ULL);
+}
+
+directory_stream::directory_stream(const path& dir) {
+	std::string native = dir.asLibcStr() + "\\*";
+	int wlen = MultiByteToWideChar(CP_UTF8, 0, native.c_str(), -1, nullptr, 0);
+	std::wstring pattern(wlen, 0);
+	MultiByteToWideChar(CP_UTF8, 0, native.c_str(), -1, &pattern[0], wlen);
+
+	std::unique_ptr<platform_state> st(new platform_state);
+	st->handle = FindFirstFileExW(pattern.c_str(), FindExInfoBasic, &st->data,
+		FindExSearchNameMatch, nullptr, FIND_FIRST_EX_LARGE_FETCH
+	);
+	if (st->handle == INVALID_HANDLE_VALUE) {
+		error_ = int(GetLastError());
+		return;
+	}
+	state_ = std::move(st);
+}
+
+bool directory_stream::next(dir_entry& dest) {
+	if (!state_) return false;
+	auto& st = *state_;
+
+	while (1) {
+		if (!st.primed) {
+			if (!FindNextFileW(st.handle, &st.data)) {
+				auto err = GetLastError();
+				error_ = (err == ERROR_NO_MORE_FILES) ? 0 : int(err);
+				return false;
+			}
+		}
+		st.primed = false;
+
+		if (!WideCharToMultiByte(CP_UTF8, 0, st.data.cFileName, -1, st.name, sizeof(st.name), nullptr, nullptr)) continue;
+		if (is_dot_or_dotdot(st.name)) continue;
+
+		auto attrib = st.data.dwFileAttributes;
+		dest.name = st.name;
+		dest.type =
+			(attrib & FILE_ATTRIBUTE_REPARSE_POINT) ? file_type::symlink	:
+			(attrib & FILE_ATTRIBUTE_DIRECTORY)		? file_type::directory	:
+													  file_type::regular	;
+		return true;
+	}
+}
+
+CStatInfo directory_stream::status(const dir_entry& entry) const {
+	if (!state_) return {};
+	const auto& data = state_->data;
+	return {
+		uint32_t((data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) ? _S_IFDIR : _S_IFREG),
+		intmax_t((uint64_t(data.nFileSizeHigh) << 32) | data.nFileSizeLow),
+
+		time_from_filetime(data.ftLastAccessTime),
+		time_from_filetime(data.ftLastWriteTime),
+		time_from_filetime(data.ftCreationTime)
+	};
+}
+#endif
+
+// --------------------------------------------------------------------------------------------------
+// create_directories
+//
+// Paths are created in component_less() order: a parent stays on the chain for as long as paths
+// below it keep coming.
+
+// Directories known to exist, each a prefix of the last path created. Successive paths pop back to
+// their common ancestor and only create (or confirm) the components below it.
+class directory_chain
+{
+protected:
+	struct node {
+		size_t	length;			// prefix of current_ naming this directory
+		int		fd;				// posix: opened on first use as a parent, -1 until then
+	};
+
+	std::string			current_;
+	std::vector<node>	nodes_;
+	bool				expect_existing_ = false;		// whether the last directory was already there
+
+public:
+	~directory_chain() {
+		while (!nodes_.empty()) pop();
+	}
+
+	int create(std::string_view dir) {
+		if (dir.empty()) return ENOENT;
+
+		while (!nodes_.empty()) {
+			auto len = nodes_.back().length;
+			bool ancestor = dir.length() >= len && dir.compare(0, len, current_, 0, len) == 0 &&
+				(dir.length() == len || dir[len] == '/' || current_[len - 1] == '/');
+			if (ancestor) break;
+			pop();
+		}
+		current_.assign(dir.data(), dir.length());
+
+		size_t pos = nodes_.empty() ? 0 : nodes_.back().length;
+		if (!pos && dir[0] == '/') {
+			nodes_.push_back({ 1, -1 });				// the root exists
+			pos = 1;
+		}
+
+		while (pos < dir.length()) {
+			if (dir[pos] == '/') {
+				++pos;
+				continue;
+			}
+			auto end = std::min(dir.find('/', pos), dir.length());
+			if (int err = make(pos, end)) return err;
+			nodes_.push_back({ end, -1 });
+			pos = end;
+		}
+		return 0;
+	}
+
+protected:
+#if PLATFORM_POSIX
+	void pop() {
+		if (nodes_.back().fd >= 0) close(nodes_.back().fd);
+		nodes_.pop_back();
+	}
+
+	int parent_fd() {
+		if (nodes_.empty()) return AT_FDCWD;
+
+		auto& parent = nodes_.back();
+		if (parent.fd < 0) {
+			if (parent.length == 1 && current_[0] == '/') {
+				parent.fd = open("/", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+			}
+			else {
+				// opened relative to its own parent, which is opened first if need be.
+				auto self = nodes_.back();
+				nodes_.pop_back();
+				auto beg = nodes_.empty() ? 0 : nodes_.back().length;
+				if (beg < self.length && current_[beg] == '/') ++beg;
+				std::string name = current_.substr(beg, self.length - beg);
+				self.fd = openat(parent_fd(), name.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+				nodes_.push_back(self);
+			}
+		}
+		return nodes_.back().fd;
+	}
+
+	// one syscall per directory in the common cases: batches tend to be either mostly new, where
+	// mkdirat() goes first, or mostly existing, where a stat settles it without trying to create.
+	int make(size_t beg, size_t end) {
+		int dirfd = parent_fd();
+		if (dirfd < 0 && dirfd != AT_FDCWD) return errno;
+
+		std::string name = current_.substr(beg, end - beg);
+		struct stat st;
+		if (expect_existing_) {
+			if (fstatat(dirfd, name.c_str(), &st, 0) == 0) return S_ISDIR(st.st_mode) ? 0 : ENOTDIR;
+			if (errno != ENOENT) return errno;
+		}
+
+		expect_existing_ = false;
+		if (mkdirat(dirfd, name.c_str(), 0777) == 0) return 0;
+		if (errno != EEXIST) return errno;
+
+		expect_existing_ = true;
+		if (fstatat(dirfd, name.c_str(), &st, 0) < 0) return errno;
+		return S_ISDIR(st.st_mode) ? 0 : ENOTDIR;
+	}
+#elif PLATFORM_MSW
+	void pop() {
+		nodes_.pop_back();
+	}
+
+	// no fds here: each directory is created by full path, but still only once per batch.
+	int make(size_t, size_t end) {
+		std::string native = path(path_view(std::string_view(current_).substr(0, end))).asLibcStr();
+		int wlen = MultiByteToWideChar(CP_UTF8, 0, native.c_str(), -1, nullptr, 0);
+		std::wstring wpath(wlen, 0);
+		MultiByteToWideChar(CP_UTF8, 0, native.c_str(), -1, &wpath[0], wlen);
+
+		if (CreateDirectoryW(wpath.c_str(), nullptr)) return 0;
+		auto err = GetLastError();
+
+		// drive roots refuse creation with a variety of errors; anything that is a directory will do.
+		auto attrib = GetFileAttributesW(wpath.c_str());
+		if (attrib == INVALID_FILE_ATTRIBUTES) return int(err);
+		return (attrib & FILE_ATTRIBUTE_DIRECTORY) ? 0 : int(ERROR_DIRECTORY);
+	}
+#endif
+};
+
+template<typename GetPath>
+static int create_directories_batch(size_t count, GetPath&& get, std::vector<int>* results) {
+	std::vector<size_t> order(count);
+	std::iota(order.begin(), order.end(), size_t(0));
+	std::sort(order.begin(), order.end(), [&](size_t a, size_t b) { return component_less(get(a), get(b)); });
+
+	if (results) {
+		results->assign(count, 0);
+	}
+
+	directory_chain chain;
+	int failures = 0;
+	int err = 0;
+	for (size_t i=0; i<count; ++i) {
+		auto dir = get(order[i]);
+		if (!i || dir != get(order[i - 1])) {
+			err = chain.create(dir);
+		}
+		if (err) {
+			++failures;
+			if (results) (*results)[order[i]] = err;
+		}
+	}
+	return failures;
+}
+
+int create_directories(const path* paths, size_t count, std::vector<int>* results) {
+	return create_directories_batch(count, [&](size_t idx) -> std::string_view { return paths[idx].uni_string(); }, results);
+}
+
+int create_directories(const path_list& paths, std::vector<int>* results) {
+	return create_directories_batch(paths.size(), [&](size_t idx) -> std::string_view { return paths[idx].uni_string(); }, results);
+}
+
+directory_stream::directory_stream() = default;
+directory_stream::~directory_stream() = default;
+directory_stream::directory_stream(directory_stream&& rvalue) noexcept = default;
+directory_stream& directory_stream::operator=(directory_stream&& rvalue) noexcept = default;
+
+} // namespace fs
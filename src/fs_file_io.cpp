@@ -0,0 +1,286 @@
+#include "fs_file_io.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <utility>
+
+#if PLATFORM_MSW
+#	include <malloc.h>
+#elif PLATFORM_POSIX
+#	include <fcntl.h>
+#endif
+
+namespace fs {
+
+// _write and friends take an unsigned count on msw.
+static const size_t max_transfer = 1024 * 1024 * 1024;
+
+static size_t round_up(size_t size, size_t alignment) {
+	return (size + alignment - 1) & ~(alignment - 1);
+}
+
+// --------------------------------------------------------------------------------------------------
+aligned_buffer::aligned_buffer(size_t size, size_t alignment) {
+	if (!size) return;
+#if PLATFORM_MSW
+	data_ = (uint8_t*)_aligned_malloc(size, alignment);
+#else
+	void* mem = nullptr;
+	data_ = (posix_memalign(&mem, alignment, size) == 0) ? (uint8_t*)mem : nullptr;
+#endif
+	size_ = data_ ? size : 0;
+}
+
+aligned_buffer::~aligned_buffer() {
+#if PLATFORM_MSW
+	_aligned_free(data_);
+#else
+	free(data_);
+#endif
+}
+
+aligned_buffer::aligned_buffer(aligned_buffer&& rvalue) noexcept {
+	data_ = std::exchange(rvalue.data_, nullptr);
+	size_ = std::exchange(rvalue.size_, 0);
+}
+
+aligned_buffer& aligned_buffer::operator=(aligned_buffer&& rvalue) noexcept {
+	std::swap(data_, rvalue.data_);
+	std::swap(size_, rvalue.size_);
+	return *this;
+}
+
+// Opens with O_DIRECT when asked, retrying without it if the filesystem refuses (EINVAL).
+static int open_maybe_direct(const path& file, int flags, bool& direct) {
+	direct = direct && (O_DIRECT != 0);
+	if (direct) {
+		int fd = posix_open(file.c_str(), flags | O_DIRECT, DEFFILEMODE);
+		if (fd >= 0 || errno != EINVAL) return fd;
+		direct = false;
+	}
+	return posix_open(file.c_str(), flags, DEFFILEMODE);
+}
+
+// --------------------------------------------------------------------------------------------------
+file_reader::file_reader(const path& file, const file_io_options& options) {
+	open(file, options);
+}
+
+file_reader::~file_reader() {
+	close();
+}
+
+bool file_reader::open(const path& file, const file_io_options& options) {
+	close();
+	error_  = 0;
+	direct_ = options.direct;
+
+	fd_ = open_maybe_direct(file, O_RDONLY, direct_);
+	if (fd_ < 0) {
+		error_ = errno;
+		return false;
+	}
+
+	size_    = posix_fstat(fd_).st_size;
+	buf_     = aligned_buffer(round_up(std::max<size_t>(options.buffer_size, 1), direct_io_alignment));
+	if (buf_.empty()) {
+		error_ = ENOMEM;
+		close();
+		return false;
+	}
+	buf_off_ = 0;
+	buf_pos_ = 0;
+	buf_len_ = 0;
+	return true;
+}
+
+void file_reader::close() {
+	if (fd_ >= 0) {
+		::posix_close(fd_);
+	}
+	fd_ = -1;
+}
+
+// reads until length or end of file, resuming short reads.
+size_t file_reader::pread_full(void* dest, size_t length, x_off_t pos) {
+	size_t done = 0;
+	while (done < length) {
+		auto got = intmax_t(::posix_pread(fd_, (uint8_t*)dest + done, std::min(length - done, max_transfer), pos + x_off_t(done)));
+		if (got < 0) {
+			if (errno == EINTR) continue;
+			error_ = errno;
+			break;
+		}
+		if (!got) break;
+		done += size_t(got);
+
+		// direct reads past a short one would be unaligned; a short direct read means end of file.
+		if (direct_ && (done % direct_io_alignment)) break;
+	}
+	return done;
+}
+
+bool file_reader::refill() {
+	auto pos     = tell();
+	auto aligned = direct_ ? (pos & ~x_off_t(direct_io_alignment - 1)) : pos;
+
+	buf_off_ = aligned;
+	buf_pos_ = size_t(pos - aligned);
+	buf_len_ = pread_full(buf_.data(), buf_.size(), aligned);
+	if (buf_len_ < buf_pos_) {
+		buf_len_ = buf_pos_;			// at or past end of file
+	}
+	return buf_pos_ < buf_len_;
+}
+
+size_t file_reader::read(void* dest, size_t length) {
+	if (fd_ < 0) return 0;
+
+	size_t done = 0;
+	while (done < length) {
+		if (buf_pos_ < buf_len_) {
+			auto n = std::min(length - done, buf_len_ - buf_pos_);
+			memcpy((uint8_t*)dest + done, buf_.data() + buf_pos_, n);
+			buf_pos_ += n;
+			done     += n;
+			continue;
+		}
+
+		auto remaining = length - done;
+		if (!direct_ && remaining >= buf_.size()) {
+			auto pos = tell();
+			auto got = pread_full((uint8_t*)dest + done, remaining, pos);
+			buf_off_ = pos + x_off_t(got);
+			buf_pos_ = 0;
+			buf_len_ = 0;
+			done    += got;
+			break;
+		}
+
+		if (!refill()) break;
+	}
+	return done;
+}
+
+bool file_reader::seek(x_off_t pos) {
+	if (fd_ < 0 || pos < 0) return false;
+	if (pos >= buf_off_ && pos <= buf_off_ + x_off_t(buf_len_)) {
+		buf_pos_ = size_t(pos - buf_off_);
+	}
+	else {
+		buf_off_ = pos;
+		buf_pos_ = 0;
+		buf_len_ = 0;
+	}
+	return true;
+}
+
+// --------------------------------------------------------------------------------------------------
+file_writer::file_writer(const path& file, const file_io_options& options) {
+	open(file, options);
+}
+
+file_writer::~file_writer() {
+	close();
+}
+
+bool file_writer::open(const path& file, const file_io_options& options) {
+	close();
+	error_   = 0;
+	direct_  = options.direct;
+	written_ = 0;
+	buf_len_ = 0;
+
+	fd_ = open_maybe_direct(file, O_WRONLY | O_CREAT | O_TRUNC, direct_);
+	if (fd_ < 0) {
+		error_ = errno;
+		return false;
+	}
+
+	buf_ = aligned_buffer(round_up(std::max<size_t>(options.buffer_size, 1), direct_io_alignment));
+	if (buf_.empty()) {
+		error_ = ENOMEM;
+		::posix_close(fd_);
+		fd_ = -1;
+		return false;
+	}
+	return true;
+}
+
+bool file_writer::write_full(const void* src, size_t length) {
+	size_t done = 0;
+	while (done < length) {
+		auto got = intmax_t(::posix_write(fd_, (const uint8_t*)src + done, unsigned(std::min(length - done, max_transfer))));
+		if (got < 0) {
+			if (errno == EINTR) continue;
+			error_ = errno;
+			return false;
+		}
+		if (!got) {
+			error_ = EIO;
+			return false;
+		}
+		done     += size_t(got);
+		written_ += got;
+	}
+	return true;
+}
+
+bool file_writer::flush() {
+	if (fd_ < 0 || error_) return false;
+
+	// direct mode holds back the unaligned tail, which only close() may write.
+	auto len = direct_ ? (buf_len_ & ~(direct_io_alignment - 1)) : buf_len_;
+	if (!len) return true;
+	if (!write_full(buf_.data(), len)) return false;
+
+	memmove(buf_.data(), buf_.data() + len, buf_len_ - len);
+	buf_len_ -= len;
+	return true;
+}
+
+bool file_writer::write(const void* src, size_t length) {
+	if (fd_ < 0 || error_) return false;
+
+	if (!direct_ && !buf_len_ && length >= buf_.size()) {
+		return write_full(src, length);
+	}
+
+	auto* bytes = (const uint8_t*)src;
+	while (length) {
+		auto n = std::min(length, buf_.size() - buf_len_);
+		memcpy(buf_.data() + buf_len_, bytes, n);
+		buf_len_ += n;
+		bytes    += n;
+		length   -= n;
+		if (buf_len_ == buf_.size() && !flush()) return false;
+	}
+	return true;
+}
+
+bool file_writer::close() {
+	if (fd_ < 0) return !error_;
+
+	flush();
+	if (buf_len_ && !error_) {
+#if PLATFORM_POSIX
+		if (direct_) {
+			fcntl(fd_, F_SETFL, fcntl(fd_, F_GETFL) & ~O_DIRECT);
+			direct_ = false;
+		}
+#endif
+		if (write_full(buf_.data(), buf_len_)) {
+			buf_len_ = 0;
+		}
+	}
+
+	if (::posix_close(fd_) < 0 && !error_) {
+		error_ = errno;
+	}
+	fd_ = -1;
+	return !error_;
+}
+
+} // namespace fs
@@ -0,0 +1,250 @@
+#include "fs_glob.h"
+
+#include <cctype>
+
+namespace fs {
+
+uint8_t glob_pattern::fold(uint8_t c) const {
+	return (case_ == glob_case::insensitive) ? uint8_t(tolower(c)) : c;
+}
+
+void glob_pattern::compile(std::string_view pattern, glob_case cs)
+{
+	pattern_ = pattern;
+	case_    = cs;
+	literal_prefix_.clear();
+	ops_     .clear();
+	segments_.clear();
+	classes_ .clear();
+
+	if (pattern.empty()) return;
+
+	bool in_prefix = true;
+	size_t pos = 0;
+	while (1) {
+		auto slash = pattern.find('/', pos);
+		auto comp  = pattern.substr(pos, (slash == std::string_view::npos) ? std::string_view::npos : slash - pos);
+
+		segment seg = {};
+		seg.first = uint32_t(ops_.size());
+		bool all_literal = true;
+
+		if (comp == "**") {
+			seg.globstar = true;
+			all_literal  = false;
+		}
+		else for (size_t i=0; i<comp.length(); ++i) {
+			auto c = uint8_t(comp[i]);
+			if (c == '*') {
+				// consecutive stars are redundant, and collapsing them keeps backtracking linear.
+				if (ops_.size() == seg.first || ops_.back().kind != op_kind::star) {
+					ops_.push_back({ op_kind::star, 0, 0 });
+				}
+				all_literal = false;
+				continue;
+			}
+			if (c == '?') {
+				ops_.push_back({ op_kind::any_char, 0, 0 });
+				all_literal = false;
+				continue;
+			}
+			if (c == '[') {
+				// a ']' right after the opening (or after '!') is a member, not the terminator.
+				auto j = i + 1;
+				bool negate = (j < comp.length() && (comp[j] == '!' || comp[j] == '^'));
+				if (negate) ++j;
+				auto first = j;
+				if (j < comp.length() && comp[j] == ']') ++j;
+				while (j < comp.length() && comp[j] != ']') ++j;
+
+				if (j < comp.length()) {
+					char_set set = {};
+					for (auto k = first; k < j; ++k) {
+						auto lo = uint8_t(comp[k]);
+						auto hi = lo;
+						if (k + 2 < j && comp[k+1] == '-') {
+							hi = uint8_t(comp[k+2]);
+							k += 2;
+						}
+						for (int ch = lo; ch <= hi; ++ch) {
+							set.set(uint8_t(ch));
+							if (case_ == glob_case::insensitive) {
+								set.set(uint8_t(tolower(ch)));
+								set.set(uint8_t(toupper(ch)));
+							}
+						}
+					}
+					if (negate) {
+						for (auto& bits : set.bits) bits = ~bits;
+					}
+					set.bits['/' >> 6] &= ~(uint64_t(1) << ('/' & 63));
+
+					ops_.push_back({ op_kind::char_class, 0, uint16_t(classes_.size()) });
+					classes_.push_back(set);
+					all_literal = false;
+					i = j;
+					continue;
+				}
+				// unterminated, falls through as a literal '['
+			}
+			ops_.push_back({ op_kind::literal, fold(c), 0 });
+		}
+
+		seg.count = uint32_t(ops_.size() - seg.first);
+		for (auto i = seg.first; i < ops_.size(); ++i) {
+			seg.min_len += (ops_[i].kind != op_kind::star);
+		}
+		for (auto i = ops_.size(); i > seg.first && ops_[i-1].kind == op_kind::literal; --i) {
+			++seg.suffix_len;
+		}
+		segments_.push_back(seg);
+
+		in_prefix = in_prefix && all_literal;
+		if (in_prefix) {
+			if (pos) literal_prefix_ += '/';
+			literal_prefix_ += comp;
+		}
+
+		if (slash == std::string_view::npos) break;
+		pos = slash + 1;
+	}
+
+	bool fixed = true;
+	for (auto i = segments_.size(); i > 0; --i) {
+		fixed = fixed && !segments_[i-1].globstar;
+		segments_[i-1].fixed_tail = fixed;
+	}
+}
+
+// Single component against a single segment: the usual wildcard match, backtracking to the most
+// recent star only, which is sufficient since star is the only variable-width op within a segment.
+bool glob_pattern::match_segment(const segment& seg, std::string_view comp) const
+{
+	const op* ops = ops_.data() + seg.first;
+	size_t opcount = seg.count;
+
+	if (comp.length() < seg.min_len) return false;
+	for (size_t i=1; i<=seg.suffix_len; ++i) {
+		if (ops[opcount - i].ch != fold(uint8_t(comp[comp.length() - i]))) return false;
+	}
+
+	size_t oi = 0, ci = 0;
+	size_t star_oi = SIZE_MAX, star_ci = 0;
+
+	while (ci < comp.length()) {
+		if (oi < opcount) {
+			const auto& o = ops[oi];
+			auto c = uint8_t(comp[ci]);
+			if (o.kind == op_kind::star) {
+				star_oi = oi++;
+				star_ci = ci;
+				continue;
+			}
+
+			bool hit =
+				(o.kind == op_kind::any_char)	? true :
+				(o.kind == op_kind::literal)	? (o.ch == fold(c)) :
+												  classes_[o.class_idx].test(c);
+			if (hit) {
+				++oi;
+				++ci;
+				continue;
+			}
+		}
+		if (star_oi == SIZE_MAX) return false;
+		oi = star_oi + 1;
+		ci = ++star_ci;
+	}
+
+	while (oi < opcount && ops[oi].kind == op_kind::star) {
+		++oi;
+	}
+	return oi == opcount;
+}
+
+// pos is the start of the next path component, or npos once every component has been consumed.
+bool glob_pattern::match_from(size_t seg_idx, std::string_view path, size_t pos) const
+{
+	const auto npos = std::string_view::npos;
+
+	for (; seg_idx < segments_.size(); ++seg_idx) {
+		const auto& seg = segments_[seg_idx];
+
+		if (seg.globstar) {
+			if (seg_idx + 1 == segments_.size()) {
+				return true;
+			}
+			// with no further globstar, the rest of the pattern can only align with the last components.
+			if (segments_[seg_idx + 1].fixed_tail) {
+				if (pos == npos) return false;
+
+				size_t need  = segments_.size() - seg_idx - 1;
+				size_t found = 0;
+				size_t start = npos;
+				for (size_t i = path.length(); i > pos; --i) {
+					if (path[i-1] == '/' && ++found == need) {
+						start = i;
+						break;
+					}
+				}
+				if (start == npos) {
+					if (found + 1 != need) return false;		// fewer components left than the tail needs
+					start = pos;
+				}
+				return match_from(seg_idx + 1, path, start);
+			}
+
+			// zero components first, then one more each time.
+			while (1) {
+				if (match_from(seg_idx + 1, path, pos)) return true;
+				if (pos == npos) return false;
+				auto slash = path.find('/', pos);
+				pos = (slash == npos) ? npos : slash + 1;
+			}
+		}
+
+		if (pos == npos) return false;
+		auto slash = path.find('/', pos);
+		auto comp  = path.substr(pos, (slash == npos) ? npos : slash - pos);
+		if (!match_segment(seg, comp)) return false;
+		pos = (slash == npos) ? npos : slash + 1;
+	}
+	return pos == npos;
+}
+
+bool glob_pattern::match(path_view uni_path) const
+{
+	if (segments_.empty()) {
+		return uni_path.empty();
+	}
+	return match_from(0, uni_path.uni_string(), 0);
+}
+
+bool glob_pattern::may_contain(std::string_view dir) const
+{
+	const auto npos = std::string_view::npos;
+	if (dir.empty()) {
+		return !segments_.empty();
+	}
+
+	size_t seg_idx = 0;
+	size_t pos     = 0;
+	while (pos != npos) {
+		if (seg_idx == segments_.size()) return false;
+
+		const auto& seg = segments_[seg_idx];
+		if (seg.globstar) return true;
+
+		auto slash = dir.find('/', pos);
+		auto comp  = dir.substr(pos, (slash == npos) ? npos : slash - pos);
+		if (!match_segment(seg, comp)) return false;
+
+		pos = (slash == npos) ? npos : slash + 1;
+		++seg_idx;
+	}
+
+	// dir itself is matched by the leading segments, something below it needs another segment.
+	return seg_idx < segments_.size();
+}
+
+} // namespace fs
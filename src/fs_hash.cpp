@@ -0,0 +1,635 @@
+#include "fs_hash.h"
+#include "fs_simd.h"
+#include "fs_mapped_file.h"
+#include "parallel_for.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <memory>
+#include <thread>
+
+#if FS_SIMD_X86
+#	include <emmintrin.h>
+#	include <immintrin.h>
+#	include <nmmintrin.h>
+#	if defined(_MSC_VER)
+#		include <intrin.h>
+#	endif
+#endif
+
+#if PLATFORM_POSIX
+#	include <fcntl.h>
+#endif
+
+namespace fs {
+
+const char* hash_algorithm_name(hash_algorithm algorithm) {
+	switch (algorithm) {
+		case hash_algorithm::xxh3:		return "xxh3";
+		case hash_algorithm::crc32c:	return "crc32c";
+	}
+	return "unknown";
+}
+
+// --------------------------------------------------------------------------------------------------
+// XXH3 (64-bit, seed 0, default secret), following the xxHash specification.
+
+static const uint32_t PRIME32_1 = 0x9E3779B1U;
+static const uint32_t PRIME32_2 = 0x85EBCA77U;
+static const uint32_t PRIME32_3 = 0xC2B2AE3DU;
+static const uint64_t PRIME64_1 = 0x9E3779B185EBCA87ULL;
+static const uint64_t PRIME64_2 = 0xC2B2AE3D27D4EB4FULL;
+static const uint64_t PRIME64_3 = 0x165667B19E3779F9ULL;
+static const uint64_t PRIME64_4 = 0x85EBCA77C2B2AE63ULL;
+static const uint64_t PRIME64_5 = 0x27D4EB2F165667C5ULL;
+
+static const size_t xxh3_stripe_len			= 64;
+static const size_t xxh3_secret_size		= 192;
+static const size_t xxh3_secret_limit		= xxh3_secret_size - xxh3_stripe_len;
+static const size_t xxh3_stripes_per_block	= xxh3_secret_limit / 8;
+static const size_t xxh3_buffer_stripes		= 256 / xxh3_stripe_len;
+static const size_t xxh3_midsize_max		= 240;
+
+alignas(64) static const uint8_t xxh3_secret[xxh3_secret_size] = {
+	0xb8, 0xfe, 0x6c, 0x39, 0x23, 0xa4, 0x4b, 0xbe, 0x7c, 0x01, 0x81, 0x2c, 0xf7, 0x21, 0xad, 0x1c,
+	0xde, 0xd4, 0x6d, 0xe9, 0x83, 0x90, 0x97, 0xdb, 0x72, 0x40, 0xa4, 0xa4, 0xb7, 0xb3, 0x67, 0x1f,
+	0xcb, 0x79, 0xe6, 0x4e, 0xcc, 0xc0, 0xe5, 0x78, 0x82, 0x5a, 0xd0, 0x7d, 0xcc, 0xff, 0x72, 0x21,
+	0xb8, 0x08, 0x46, 0x74, 0xf7, 0x43, 0x24, 0x8e, 0xe0, 0x35, 0x90, 0xe6, 0x81, 0x3a, 0x26, 0x4c,
+	0x3c, 0x28, 0x52, 0xbb, 0x91, 0xc3, 0x00, 0xcb, 0x88, 0xd0, 0x65, 0x8b, 0x1b, 0x53, 0x2e, 0xa3,
+	0x71, 0x64, 0x48, 0x97, 0xa2, 0x0d, 0xf9, 0x4e, 0x38, 0x19, 0xef, 0x46, 0xa9, 0xde, 0xac, 0xd8,
+	0xa8, 0xfa, 0x76, 0x3f, 0xe3, 0x9c, 0x34, 0x3f, 0xf9, 0xdc, 0xbb, 0xc7, 0xc7, 0x0b, 0x4f, 0x1d,
+	0x8a, 0x51, 0xe0, 0x4b, 0xcd, 0xb4, 0x59, 0x31, 0xc8, 0x9f, 0x7e, 0xc9, 0xd9, 0x78, 0x73, 0x64,
+	0xea, 0xc5, 0xac, 0x83, 0x34, 0xd3, 0xeb, 0xc3, 0xc5, 0x81, 0xa0, 0xff, 0xfa, 0x13, 0x63, 0xeb,
+	0x17, 0x0d, 0xdd, 0x51, 0xb7, 0xf0, 0xda, 0x49, 0xd3, 0x16, 0x55, 0x26, 0x29, 0xd4, 0x68, 0x9e,
+	0x2b, 0x16, 0xbe, 0x58, 0x7d, 0x47, 0xa1, 0xfc, 0x8f, 0xf8, 0xb8, 0xd1, 0x7a, 0xd0, 0x31, 0xce,
+	0x45, 0xcb, 0x3a, 0x8f, 0x95, 0x16, 0x04, 0x28, 0xaf, 0xd7, 0xfb, 0xca, 0xbb, 0x4b, 0x40, 0x7e,
+};
+
+// all supported targets are little-endian, which the format is defined in.
+static inline uint32_t read32(const uint8_t* src) { uint32_t v; memcpy(&v, src, 4); return v; }
+static inline uint64_t read64(const uint8_t* src) { uint64_t v; memcpy(&v, src, 8); return v; }
+
+static inline uint64_t rotl64(uint64_t v, int r) { return (v << r) | (v >> (64 - r)); }
+static inline uint64_t xorshift64(uint64_t v, int shift) { return v ^ (v >> shift); }
+
+static inline uint32_t swap32(uint32_t v) {
+	return ((v << 24) & 0xff000000) | ((v << 8) & 0x00ff0000) | ((v >> 8) & 0x0000ff00) | ((v >> 24) & 0x000000ff);
+}
+
+static inline uint64_t swap64(uint64_t v) {
+	return (uint64_t(swap32(uint32_t(v))) << 32) | swap32(uint32_t(v >> 32));
+}
+
+static inline uint64_t mul128_fold64(uint64_t lhs, uint64_t rhs) {
+#if defined(__SIZEOF_INT128__)
+	auto product = (unsigned __int128)lhs * rhs;
+	return uint64_t(product) ^ uint64_t(product >> 64);
+#elif defined(_MSC_VER) && defined(_M_X64)
+	uint64_t hi;
+	uint64_t lo = _umul128(lhs, rhs, &hi);
+	return lo ^ hi;
+#else
+	// portable 64x64->128 via 32-bit halves.
+	uint64_t lo_lo = (lhs & 0xFFFFFFFF) * (rhs & 0xFFFFFFFF);
+	uint64_t hi_lo = (lhs >> 32)        * (rhs & 0xFFFFFFFF);
+	uint64_t lo_hi = (lhs & 0xFFFFFFFF) * (rhs >> 32);
+	uint64_t hi_hi = (lhs >> 32)        * (rhs >> 32);
+	uint64_t cross = (lo_lo >> 32) + (hi_lo & 0xFFFFFFFF) + lo_hi;
+	uint64_t upper = (hi_lo >> 32) + (cross >> 32) + hi_hi;
+	uint64_t lower = (cross << 32) | (lo_lo & 0xFFFFFFFF);
+	return lower ^ upper;
+#endif
+}
+
+static inline uint64_t xxh64_avalanche(uint64_t h) {
+	h ^= h >> 33;
+	h *= PRIME64_2;
+	h ^= h >> 29;
+	h *= PRIME64_3;
+	h ^= h >> 32;
+	return h;
+}
+
+static inline uint64_t xxh3_avalanche(uint64_t h) {
+	h  = xorshift64(h, 37);
+	h *= 0x165667919E3779F9ULL;
+	return xorshift64(h, 32);
+}
+
+static inline uint64_t xxh3_rrmxmx(uint64_t h, uint64_t len) {
+	h ^= rotl64(h, 49) ^ rotl64(h, 24);
+	h *= 0x9FB21C651E98DF25ULL;
+	h ^= (h >> 35) + len;
+	h *= 0x9FB21C651E98DF25ULL;
+	return xorshift64(h, 28);
+}
+
+static inline uint64_t xxh3_mix16(const uint8_t* input, const uint8_t* secret) {
+	return mul128_fold64(read64(input) ^ read64(secret), read64(input + 8) ^ read64(secret + 8));
+}
+
+static uint64_t xxh3_short(const uint8_t* input, size_t len) {
+	const uint8_t* secret = xxh3_secret;
+
+	if (len > 16) {
+		uint64_t acc = len * PRIME64_1;
+		if (len > 128) {
+			for (size_t i=0; i<8; ++i) {
+				acc += xxh3_mix16(input + 16 * i, secret + 16 * i);
+			}
+			acc = xxh3_avalanche(acc);
+			for (size_t i=8; i<len / 16; ++i) {
+				acc += xxh3_mix16(input + 16 * i, secret + 16 * (i - 8) + 3);
+			}
+			acc += xxh3_mix16(input + len - 16, secret + 136 - 17);
+			return xxh3_avalanche(acc);
+		}
+		if (len > 32) {
+			if (len > 64) {
+				if (len > 96) {
+					acc += xxh3_mix16(input + 48, secret + 96);
+					acc += xxh3_mix16(input + len - 64, secret + 112);
+				}
+				acc += xxh3_mix16(input + 32, secret + 64);
+				acc += xxh3_mix16(input + len - 48, secret + 80);
+			}
+			acc += xxh3_mix16(input + 16, secret + 32);
+			acc += xxh3_mix16(input + len - 32, secret + 48);
+		}
+		acc += xxh3_mix16(input, secret);
+		acc += xxh3_mix16(input + len - 16, secret + 16);
+		return xxh3_avalanche(acc);
+	}
+
+	if (len > 8) {
+		uint64_t lo = read64(input)           ^ (read64(secret + 24) ^ read64(secret + 32));
+		uint64_t hi = read64(input + len - 8) ^ (read64(secret + 40) ^ read64(secret + 48));
+		uint64_t acc = len + swap64(lo) + hi + mul128_fold64(lo, hi);
+		return xxh3_avalanche(acc);
+	}
+	if (len >= 4) {
+		uint64_t combined = read32(input + len - 4) + (uint64_t(read32(input)) << 32);
+		return xxh3_rrmxmx(combined ^ (read64(secret + 8) ^ read64(secret + 16)), len);
+	}
+	if (len > 0) {
+		uint32_t combined = (uint32_t(input[0]) << 16) | (uint32_t(input[len >> 1]) << 24) | input[len - 1] | (uint32_t(len) << 8);
+		return xxh64_avalanche(uint64_t(combined) ^ (read32(secret) ^ read32(secret + 4)));
+	}
+	return xxh64_avalanche(read64(secret + 56) ^ read64(secret + 64));
+}
+
+// stripe kernels: accumulate nb_stripes consecutive stripes, each against the secret advanced by 8
+// bytes per stripe; scramble at the end of each block.
+using xxh3_accumulate_fn	= void (uint64_t* acc, const uint8_t* input, const uint8_t* secret, size_t nb_stripes);
+using xxh3_scramble_fn		= void (uint64_t* acc, const uint8_t* secret);
+
+static void xxh3_accumulate_scalar(uint64_t* acc, const uint8_t* input, const uint8_t* secret, size_t nb_stripes) {
+	for (size_t n=0; n<nb_stripes; ++n) {
+		const uint8_t* in  = input  + n * xxh3_stripe_len;
+		const uint8_t* key = secret + n * 8;
+		for (size_t i=0; i<8; ++i) {
+			uint64_t data_val = read64(in + 8 * i);
+			uint64_t data_key = data_val ^ read64(key + 8 * i);
+			acc[i ^ 1] += data_val;
+			acc[i]     += uint64_t(uint32_t(data_key)) * (data_key >> 32);
+		}
+	}
+}
+
+static void xxh3_scramble_scalar(uint64_t* acc, const uint8_t* secret) {
+	for (size_t i=0; i<8; ++i) {
+		uint64_t v = xorshift64(acc[i], 47) ^ read64(secret + 8 * i);
+		acc[i] = v * PRIME32_1;
+	}
+}
+
+#if FS_SIMD_X86
+FS_TARGET_SSE2
+static void xxh3_accumulate_sse2(uint64_t* acc, const uint8_t* input, const uint8_t* secret, size_t nb_stripes) {
+	__m128i* xacc = (__m128i*)acc;
+	for (size_t n=0; n<nb_stripes; ++n) {
+		const uint8_t* in  = input  + n * xxh3_stripe_len;
+		const uint8_t* key = secret + n * 8;
+		for (size_t i=0; i<4; ++i) {
+			__m128i data_vec	= _mm_loadu_si128((const __m128i*)(in  + 16 * i));
+			__m128i key_vec		= _mm_loadu_si128((const __m128i*)(key + 16 * i));
+			__m128i data_key	= _mm_xor_si128(data_vec, key_vec);
+			__m128i data_key_lo	= _mm_shuffle_epi32(data_key, _MM_SHUFFLE(0, 3, 0, 1));
+			__m128i product		= _mm_mul_epu32(data_key, data_key_lo);
+			__m128i data_swap	= _mm_shuffle_epi32(data_vec, _MM_SHUFFLE(1, 0, 3, 2));
+			xacc[i] = _mm_add_epi64(product, _mm_add_epi64(xacc[i], data_swap));
+		}
+	}
+}
+
+FS_TARGET_SSE2
+static void xxh3_scramble_sse2(uint64_t* acc, const uint8_t* secret) {
+	__m128i* xacc = (__m128i*)acc;
+	const __m128i prime32 = _mm_set1_epi32(int(PRIME32_1));
+	for (size_t i=0; i<4; ++i) {
+		__m128i acc_vec		= xacc[i];
+		__m128i data_vec	= _mm_xor_si128(acc_vec, _mm_srli_epi64(acc_vec, 47));
+		__m128i data_key	= _mm_xor_si128(data_vec, _mm_loadu_si128((const __m128i*)(secret + 16 * i)));
+		__m128i data_key_hi	= _mm_shuffle_epi32(data_key, _MM_SHUFFLE(0, 3, 0, 1));
+		__m128i prod_lo		= _mm_mul_epu32(data_key, prime32);
+		__m128i prod_hi		= _mm_mul_epu32(data_key_hi, prime32);
+		xacc[i] = _mm_add_epi64(prod_lo, _mm_slli_epi64(prod_hi, 32));
+	}
+}
+
+FS_TARGET_AVX2
+static void xxh3_accumulate_avx2(uint64_t* acc, const uint8_t* input, const uint8_t* secret, size_t nb_stripes) {
+	__m256i* xacc = (__m256i*)acc;
+	for (size_t n=0; n<nb_stripes; ++n) {
+		const uint8_t* in  = input  + n * xxh3_stripe_len;
+		const uint8_t* key = secret + n * 8;
+		for (size_t i=0; i<2; ++i) {
+			__m256i data_vec	= _mm256_loadu_si256((const __m256i*)(in  + 32 * i));
+			__m256i key_vec		= _mm256_loadu_si256((const __m256i*)(key + 32 * i));
+			__m256i data_key	= _mm256_xor_si256(data_vec, key_vec);
+			__m256i data_key_lo	= _mm256_shuffle_epi32(data_key, _MM_SHUFFLE(0, 3, 0, 1));
+			__m256i product		= _mm256_mul_epu32(data_key, data_key_lo);
+			__m256i data_swap	= _mm256_shuffle_epi32(data_vec, _MM_SHUFFLE(1, 0, 3, 2));
+			xacc[i] = _mm256_add_epi64(product, _mm256_add_epi64(xacc[i], data_swap));
+		}
+	}
+	_mm256_zeroupper();
+}
+
+FS_TARGET_AVX2
+static void xxh3_scramble_avx2(uint64_t* acc, const uint8_t* secret) {
+	__m256i* xacc = (__m256i*)acc;
+	const __m256i prime32 = _mm256_set1_epi32(int(PRIME32_1));
+	for (size_t i=0; i<2; ++i) {
+		__m256i acc_vec		= xacc[i];
+		__m256i data_vec	= _mm256_xor_si256(acc_vec, _mm256_srli_epi64(acc_vec, 47));
+		__m256i data_key	= _mm256_xor_si256(data_vec, _mm256_loadu_si256((const __m256i*)(secret + 32 * i)));
+		__m256i data_key_hi	= _mm256_shuffle_epi32(data_key, _MM_SHUFFLE(0, 3, 0, 1));
+		__m256i prod_lo		= _mm256_mul_epu32(data_key, prime32);
+		__m256i prod_hi		= _mm256_mul_epu32(data_key_hi, prime32);
+		xacc[i] = _mm256_add_epi64(prod_lo, _mm256_slli_epi64(prod_hi, 32));
+	}
+	_mm256_zeroupper();
+}
+#endif
+
+struct xxh3_kernels {
+	xxh3_accumulate_fn*		accumulate;
+	xxh3_scramble_fn*		scramble;
+};
+
+static xxh3_kernels get_xxh3_kernels() {
+	switch (simd::ActiveIsa()) {
+#if FS_SIMD_X86
+		case simd::isa::sse2: return { xxh3_accumulate_sse2, xxh3_scramble_sse2 };
+		case simd::isa::avx2: return { xxh3_accumulate_avx2, xxh3_scramble_avx2 };
+#endif
+		default: break;
+	}
+	return { xxh3_accumulate_scalar, xxh3_scramble_scalar };
+}
+
+// consumes nb_stripes (at most one block's worth) starting stripes_in_block into the current block.
+static void xxh3_consume_stripes(const xxh3_kernels& k, uint64_t* acc, size_t& stripes_in_block, const uint8_t* input, size_t nb_stripes) {
+	if (xxh3_stripes_per_block - stripes_in_block <= nb_stripes) {
+		size_t to_block_end = xxh3_stripes_per_block - stripes_in_block;
+		size_t after_block	= nb_stripes - to_block_end;
+		k.accumulate(acc, input, xxh3_secret + stripes_in_block * 8, to_block_end);
+		k.scramble(acc, xxh3_secret + xxh3_secret_limit);
+		k.accumulate(acc, input + to_block_end * xxh3_stripe_len, xxh3_secret, after_block);
+		stripes_in_block = after_block;
+	}
+	else {
+		k.accumulate(acc, input, xxh3_secret + stripes_in_block * 8, nb_stripes);
+		stripes_in_block += nb_stripes;
+	}
+}
+
+static uint64_t xxh3_merge_accs(const uint64_t* acc, uint64_t total) {
+	uint64_t result = total * PRIME64_1;
+	const uint8_t* secret = xxh3_secret + 11;
+	for (size_t i=0; i<4; ++i) {
+		result += mul128_fold64(acc[2 * i] ^ read64(secret + 16 * i), acc[2 * i + 1] ^ read64(secret + 16 * i + 8));
+	}
+	return xxh3_avalanche(result);
+}
+
+// --------------------------------------------------------------------------------------------------
+// CRC32C: slicing-by-8 tables, or the SSE4.2 crc32 instruction.
+
+struct crc32c_tables {
+	uint32_t t[8][256];
+
+	crc32c_tables() {
+		for (uint32_t i=0; i<256; ++i) {
+			uint32_t crc = i;
+			for (int bit=0; bit<8; ++bit) {
+				crc = (crc >> 1) ^ ((crc & 1) ? 0x82F63B78U : 0);
+			}
+			t[0][i] = crc;
+		}
+		for (uint32_t i=0; i<256; ++i) {
+			for (int k=1; k<8; ++k) {
+				t[k][i] = (t[k - 1][i] >> 8) ^ t[0][t[k - 1][i] & 0xff];
+			}
+		}
+	}
+};
+
+static uint32_t crc32c_scalar(uint32_t crc, const uint8_t* data, size_t len) {
+	static const crc32c_tables s_tables;
+	const auto& t = s_tables.t;
+
+	crc = ~crc;
+	for (; len >= 8; data += 8, len -= 8) {
+		uint32_t lo = read32(data) ^ crc;
+		uint32_t hi = read32(data + 4);
+		crc = t[7][lo & 0xff] ^ t[6][(lo >> 8) & 0xff] ^ t[5][(lo >> 16) & 0xff] ^ t[4][lo >> 24] ^
+			  t[3][hi & 0xff] ^ t[2][(hi >> 8) & 0xff] ^ t[1][(hi >> 16) & 0xff] ^ t[0][hi >> 24];
+	}
+	for (; len; ++data, --len) {
+		crc = (crc >> 8) ^ t[0][(crc ^ *data) & 0xff];
+	}
+	return ~crc;
+}
+
+#if FS_SIMD_X86
+FS_TARGET_SSE42
+static uint32_t crc32c_sse42(uint32_t crc, const uint8_t* data, size_t len) {
+	crc = ~crc;
+#if defined(__x86_64__) || defined(_M_X64)
+	uint64_t crc64 = crc;
+	for (; len >= 8; data += 8, len -= 8) {
+		crc64 = _mm_crc32_u64(crc64, read64(data));
+	}
+	crc = uint32_t(crc64);
+#endif
+	for (; len >= 4; data += 4, len -= 4) {
+		crc = _mm_crc32_u32(crc, read32(data));
+	}
+	for (; len; ++data, --len) {
+		crc = _mm_crc32_u8(crc, *data);
+	}
+	return ~crc;
+}
+
+static bool cpu_has_sse42() {
+#if defined(_MSC_VER)
+	int regs[4];
+	__cpuid(regs, 1);
+	return (regs[2] & (1 << 20)) != 0;
+#else
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("sse4.2");
+#endif
+}
+#endif
+
+static uint32_t crc32c_update(uint32_t crc, const uint8_t* data, size_t len) {
+#if FS_SIMD_X86
+	// follows the simd isa override, so ForceIsa(scalar) validates the table path.
+	static const bool s_has_sse42 = cpu_has_sse42();
+	if (s_has_sse42 && simd::ActiveIsa() != simd::isa::scalar) {
+		return crc32c_sse42(crc, data, len);
+	}
+#endif
+	return crc32c_scalar(crc, data, len);
+}
+
+// --------------------------------------------------------------------------------------------------
+// hasher
+
+hasher::hasher(hash_algorithm algorithm) : algorithm_(algorithm) {
+	reset();
+}
+
+void hasher::reset() {
+	crc_				= 0;
+	buffered_			= 0;
+	stripes_in_block_	= 0;
+	total_				= 0;
+
+	acc_[0] = PRIME32_3;
+	acc_[1] = PRIME64_1;
+	acc_[2] = PRIME64_2;
+	acc_[3] = PRIME64_3;
+	acc_[4] = PRIME64_4;
+	acc_[5] = PRIME32_2;
+	acc_[6] = PRIME64_5;
+	acc_[7] = PRIME32_1;
+}
+
+void hasher::update(const void* data, size_t length) {
+	auto* input = (const uint8_t*)data;
+	if (algorithm_ == hash_algorithm::crc32c) {
+		crc_ = crc32c_update(crc_, input, length);
+		return;
+	}
+
+	total_ += length;
+	if (length <= sizeof(buffer_) - buffered_) {
+		memcpy(buffer_ + buffered_, input, length);
+		buffered_ += length;
+		return;
+	}
+
+	auto k = get_xxh3_kernels();
+	const uint8_t* end = input + length;
+	if (buffered_) {
+		auto fill = sizeof(buffer_) - buffered_;
+		memcpy(buffer_ + buffered_, input, fill);
+		input += fill;
+		xxh3_consume_stripes(k, acc_, stripes_in_block_, buffer_, xxh3_buffer_stripes);
+		buffered_ = 0;
+	}
+
+	// straight from the input, always leaving some bytes to buffer: the final stripe is special.
+	if (input + sizeof(buffer_) < end) {
+		do {
+			xxh3_consume_stripes(k, acc_, stripes_in_block_, input, xxh3_buffer_stripes);
+			input += sizeof(buffer_);
+		} while (input + sizeof(buffer_) < end);
+
+		// digest() may need the bytes before the buffered ones to complete the last stripe.
+		memcpy(buffer_ + sizeof(buffer_) - xxh3_stripe_len, input - xxh3_stripe_len, xxh3_stripe_len);
+	}
+	memcpy(buffer_, input, size_t(end - input));
+	buffered_ = size_t(end - input);
+}
+
+uint64_t hasher::digest() const {
+	if (algorithm_ == hash_algorithm::crc32c) {
+		return crc_;
+	}
+	if (total_ <= xxh3_midsize_max) {
+		return xxh3_short(buffer_, size_t(total_));
+	}
+
+	auto k = get_xxh3_kernels();
+	alignas(64) uint64_t acc[8];
+	memcpy(acc, acc_, sizeof(acc));
+	auto stripes_in_block = stripes_in_block_;
+
+	const uint8_t* last_stripe;
+	uint8_t catchup[xxh3_stripe_len];
+	if (buffered_ >= xxh3_stripe_len) {
+		xxh3_consume_stripes(k, acc, stripes_in_block, buffer_, (buffered_ - 1) / xxh3_stripe_len);
+		last_stripe = buffer_ + buffered_ - xxh3_stripe_len;
+	}
+	else {
+		auto before = xxh3_stripe_len - buffered_;
+		memcpy(catchup, buffer_ + sizeof(buffer_) - before, before);
+		memcpy(catchup + before, buffer_, buffered_);
+		last_stripe = catchup;
+	}
+	k.accumulate(acc, last_stripe, xxh3_secret + xxh3_secret_limit - 7, 1);
+	return xxh3_merge_accs(acc, total_);
+}
+
+uint64_t hasher::hash(hash_algorithm algorithm, const void* data, size_t length) {
+	if (algorithm == hash_algorithm::crc32c) {
+		return crc32c_update(0, (const uint8_t*)data, length);
+	}
+	if (length <= xxh3_midsize_max) {
+		return xxh3_short((const uint8_t*)data, length);
+	}
+	hasher h(algorithm);
+	h.update(data, length);
+	return h.digest();
+}
+
+// --------------------------------------------------------------------------------------------------
+// hash_file
+
+// per-worker state, so a batch allocates its read buffer once per thread.
+struct file_hash_context
+{
+	const hash_options&		options;
+	std::unique_ptr<uint8_t[]>	buffer;
+	hasher					h;
+	mapped_file				map;
+
+	file_hash_context(const hash_options& opts)
+		: options(opts), buffer(new uint8_t[std::max<size_t>(opts.read_block, 4096)]), h(opts.algorithm) { }
+
+	// hashes [offset, offset + length), with pread or through windows of the map. Returns 0 or errno.
+	int hash_range(int fd, x_off_t offset, x_off_t length, bool mapped) {
+		const size_t block = std::max<size_t>(options.read_block, 4096);
+
+		if (mapped) {
+			static const size_t window = 64 * 1024 * 1024;
+			while (length > 0) {
+				auto n = size_t(std::min<x_off_t>(length, window));
+				if (!map.map(offset, n)) return map.error() ? map.error() : EIO;
+				if (map.size() != n) return EIO;		// truncated since it was opened
+				map.advise(map_advice::sequential);
+				h.update(map.data(), map.size());
+				offset += x_off_t(n);
+				length -= x_off_t(n);
+			}
+			map.unmap();
+			return 0;
+		}
+
+		while (length > 0) {
+			auto want = size_t(std::min<x_off_t>(length, x_off_t(block)));
+			auto got  = intmax_t(posix_pread(fd, buffer.get(), want, offset));
+			if (got < 0) {
+				if (errno == EINTR) continue;
+				return errno;
+			}
+			if (!got) return EIO;			// truncated while being hashed
+			h.update(buffer.get(), size_t(got));
+			offset += got;
+			length -= got;
+		}
+		return 0;
+	}
+
+	file_digest run(const path& file) {
+		file_digest result;
+		result.algorithm = options.algorithm;
+		result.partial	 = options.partial_bytes != 0;
+		h.reset();
+
+		// one handle per file: the map's for large files, an fd for pread otherwise (or if the
+		// map can't be opened).
+		bool mapped = !result.partial && status(file).st_size >= options.mmap_threshold && map.open(file);
+		int fd = -1;
+		x_off_t size = 0;
+		if (mapped) {
+			size = map.file_size();
+		}
+		else {
+			fd = posix_open(file.c_str(), O_RDONLY, 0);
+			if (fd < 0) {
+				result.error = errno;
+				return result;
+			}
+			size = posix_fstat(fd).st_size;
+		}
+
+		int err = 0;
+		auto head = x_off_t(options.partial_bytes);
+		if (result.partial && size > 2 * head) {
+			err = hash_range(fd, 0, head, false);
+			if (!err) err = hash_range(fd, size - head, head, false);
+		}
+		else {
+			err = hash_range(fd, 0, size, mapped);
+		}
+		if (result.partial && !err) {
+			uint64_t size_le = uint64_t(size);
+			h.update(&size_le, sizeof(size_le));
+		}
+
+		map.close();
+		if (fd >= 0) posix_close(fd);
+
+		result.size = size;
+		if (err) {
+			result.error = err;
+			return result;
+		}
+		result.value = h.digest();
+		return result;
+	}
+};
+
+file_digest hash_file(const path& file, const hash_options& options)
+{
+	file_hash_context context(options);
+	return context.run(file);
+}
+
+template<typename GetPath>
+static std::vector<file_digest> hash_files_batch(size_t count, GetPath&& get, const hash_options& options) {
+	std::vector<file_digest> results(count);
+	if (!count) return results;
+
+	int nthreads = (options.threads > 0) ? options.threads : std::max(1, int(std::thread::hardware_concurrency()));
+	nthreads = std::max(1, std::min(nthreads, int(count)));
+
+	// files vary wildly in size, so workers pull them one at a time rather than in fixed chunks.
+	std::atomic<size_t> next = { 0 };
+	ParallelForChunks(size_t(nthreads), nthreads, [&](int, size_t, size_t) {
+		file_hash_context context(options);
+		size_t idx;
+		while ((idx = next++) < count) {
+			results[idx] = context.run(get(idx));
+		}
+	});
+	return results;
+}
+
+std::vector<file_digest> hash_files(const path* files, size_t count, const hash_options& options) {
+	return hash_files_batch(count, [&](size_t idx) -> const path& { return files[idx]; }, options);
+}
+
+std::vector<file_digest> hash_files(const path_list& files, const hash_options& options) {
+	return hash_files_batch(files.size(), [&](size_t idx) { return path(files[idx]); }, options);
+}
+
+} // namespace fs
@@ -0,0 +1,300 @@
+#include "fs_mapped_file.h"
+
+#if PLATFORM_MSW
+#	define NOMINMAX
+#	define NO_STRICT
+#	define WIN32_LEAN_AND_MEAN
+#	include <Windows.h>
+#	include <string>
+#elif PLATFORM_POSIX
+#	include <fcntl.h>
+#	include <unistd.h>
+#	include <sys/mman.h>
+#	include <sys/stat.h>
+#endif
+
+#include <cerrno>
+#include <utility>
+
+namespace fs {
+
+mapped_file::mapped_file(const path& file, map_mode mode) {
+	if (open(file, mode)) {
+		map();
+	}
+}
+
+mapped_file::~mapped_file() {
+	close();
+}
+
+mapped_file::mapped_file(mapped_file&& rvalue) noexcept {
+	*this = std::move(rvalue);
+}
+
+mapped_file& mapped_file::operator=(mapped_file&& rvalue) noexcept {
+	if (this != &rvalue) {
+		close();
+#if PLATFORM_MSW
+		file_		= std::exchange(rvalue.file_,	 nullptr);
+		mapping_	= std::exchange(rvalue.mapping_, nullptr);
+#else
+		fd_			= std::exchange(rvalue.fd_,		 -1);
+#endif
+		mode_		= rvalue.mode_;
+		error_		= rvalue.error_;
+		file_size_	= std::exchange(rvalue.file_size_, 0);
+		base_		= std::exchange(rvalue.base_,		nullptr);
+		base_len_	= std::exchange(rvalue.base_len_,	0);
+		offset_		= std::exchange(rvalue.offset_,		0);
+		length_		= std::exchange(rvalue.length_,		0);
+		mapped_		= std::exchange(rvalue.mapped_,		false);
+	}
+	return *this;
+}
+
+// Validates and clamps a requested window, as common to all platforms. Returns false for a range
+// that can't be addressed, in which case errcode is set.
+static bool clamp_window(x_off_t file_size, x_off_t offset, size_t& length, int& errcode) {
+	if (offset < 0 || offset > file_size) {
+		errcode = EINVAL;
+		return false;
+	}
+	auto avail = uintmax_t(file_size - offset);
+	if (avail > SIZE_MAX && length == mapped_file::whole_file) {
+		errcode = EFBIG;		// won't fit the address space, map it in windows instead
+		return false;
+	}
+	if (length > avail) {
+		length = size_t(avail);
+	}
+	return true;
+}
+
+#if PLATFORM_MSW
+// --------------------------------------------------------------------------------------------------
+// msw: CreateFileMapping / MapViewOfFile
+//
+size_t mapped_file::granularity() {
+	static const size_t result = [] {
+		SYSTEM_INFO info;
+		GetSystemInfo(&info);
+		return size_t(info.dwAllocationGranularity);
+	}();
+	return result;
+}
+
+bool mapped_file::is_open() const {
+	return !!file_;
+}
+
+bool mapped_file::open(const path& file, map_mode mode) {
+	close();
+	mode_  = mode;
+	error_ = 0;
+
+	std::string native = file.asLibcStr();
+	int wlen = MultiByteToWideChar(CP_UTF8, 0, native.c_str(), -1, nullptr, 0);
+	std::wstring wpath(wlen, 0);
+	MultiByteToWideChar(CP_UTF8, 0, native.c_str(), -1, &wpath[0], wlen);
+
+	auto access = (mode == map_mode::read_write) ? (GENERIC_READ | GENERIC_WRITE) : GENERIC_READ;
+	auto handle = CreateFileW(wpath.c_str(), access, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+		nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr
+	);
+	if (handle == INVALID_HANDLE_VALUE) {
+		error_ = int(GetLastError());
+		return false;
+	}
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(handle, &size)) {
+		error_ = int(GetLastError());
+		CloseHandle(handle);
+		return false;
+	}
+
+	file_		= handle;
+	file_size_	= x_off_t(size.QuadPart);
+	return true;
+}
+
+void mapped_file::unmap() {
+	if (base_) {
+		UnmapViewOfFile(base_);
+	}
+	base_		= nullptr;
+	base_len_	= 0;
+	offset_		= 0;
+	length_		= 0;
+	mapped_		= false;
+}
+
+void mapped_file::close() {
+	unmap();
+	if (mapping_)	CloseHandle(mapping_);
+	if (file_)		CloseHandle(file_);
+	mapping_	= nullptr;
+	file_		= nullptr;
+	file_size_	= 0;
+}
+
+bool mapped_file::map(x_off_t offset, size_t length) {
+	unmap();
+	if (!file_) return false;
+	if (!clamp_window(file_size_, offset, length, error_)) return false;
+
+	if (length) {
+		// mapping objects can't be created for empty files, hence created lazily.
+		if (!mapping_) {
+			auto protect = (mode_ == map_mode::read_write) ? PAGE_READWRITE : PAGE_READONLY;
+			mapping_ = CreateFileMappingW(file_, nullptr, protect, 0, 0, nullptr);
+			if (!mapping_) {
+				error_ = int(GetLastError());
+				return false;
+			}
+		}
+
+		auto aligned = offset - x_off_t(offset % granularity());
+		auto lead    = size_t(offset - aligned);
+		auto access  = (mode_ == map_mode::read_write) ? FILE_MAP_WRITE : FILE_MAP_READ;
+		auto* view   = MapViewOfFile(mapping_, access, DWORD(uint64_t(aligned) >> 32), DWORD(aligned), lead + length);
+		if (!view) {
+			error_ = int(GetLastError());
+			return false;
+		}
+		base_		= (uint8_t*)view;
+		base_len_	= lead + length;
+	}
+
+	offset_	= offset;
+	length_	= length;
+	mapped_	= true;
+	return true;
+}
+
+bool mapped_file::advise(map_advice advice, size_t offset, size_t length) const {
+	if (!base_ || offset >= length_) return true;
+	if (advice != map_advice::willneed) return true;		// no equivalent for views of files
+
+	WIN32_MEMORY_RANGE_ENTRY range = { data() + offset, (length < length_ - offset) ? length : length_ - offset };
+	return !!PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+}
+
+bool mapped_file::flush(bool wait) {
+	if (!base_ || mode_ != map_mode::read_write) return true;
+	if (!FlushViewOfFile(base_, base_len_) || (wait && !FlushFileBuffers(file_))) {
+		error_ = int(GetLastError());
+		return false;
+	}
+	return true;
+}
+
+#elif PLATFORM_POSIX
+// --------------------------------------------------------------------------------------------------
+// posix: mmap / madvise
+//
+size_t mapped_file::granularity() {
+	static const size_t result = size_t(sysconf(_SC_PAGESIZE));
+	return result;
+}
+
+bool mapped_file::is_open() const {
+	return fd_ >= 0;
+}
+
+bool mapped_file::open(const path& file, map_mode mode) {
+	close();
+	mode_  = mode;
+	error_ = 0;
+
+	int flags = ((mode == map_mode::read_write) ? O_RDWR : O_RDONLY) | O_CLOEXEC;
+	int fd = ::posix_open(file.c_str(), flags, 0);
+	if (fd < 0) {
+		error_ = errno;
+		return false;
+	}
+
+	struct stat st;
+	if (fstat(fd, &st) < 0) {
+		error_ = errno;
+		::posix_close(fd);
+		return false;
+	}
+
+	fd_			= fd;
+	file_size_	= x_off_t(st.st_size);
+	return true;
+}
+
+void mapped_file::unmap() {
+	if (base_) {
+		munmap(base_, base_len_);
+	}
+	base_		= nullptr;
+	base_len_	= 0;
+	offset_		= 0;
+	length_		= 0;
+	mapped_		= false;
+}
+
+void mapped_file::close() {
+	unmap();
+	if (fd_ >= 0) {
+		::posix_close(fd_);
+	}
+	fd_			= -1;
+	file_size_	= 0;
+}
+
+bool mapped_file::map(x_off_t offset, size_t length) {
+	unmap();
+	if (fd_ < 0) return false;
+	if (!clamp_window(file_size_, offset, length, error_)) return false;
+
+	if (length) {
+		auto aligned = offset - x_off_t(offset % granularity());
+		auto lead    = size_t(offset - aligned);
+		auto prot    = (mode_ == map_mode::read_write) ? (PROT_READ | PROT_WRITE) : PROT_READ;
+		auto* view   = mmap(nullptr, lead + length, prot, MAP_SHARED, fd_, off_t(aligned));
+		if (view == MAP_FAILED) {
+			error_ = errno;
+			return false;
+		}
+		base_		= (uint8_t*)view;
+		base_len_	= lead + length;
+	}
+
+	offset_	= offset;
+	length_	= length;
+	mapped_	= true;
+	return true;
+}
+
+bool mapped_file::advise(map_advice advice, size_t offset, size_t length) const {
+	if (!base_ || offset >= length_) return true;
+
+	int native =
+		(advice == map_advice::sequential)	? POSIX_MADV_SEQUENTIAL	:
+		(advice == map_advice::random)		? POSIX_MADV_RANDOM		:
+		(advice == map_advice::willneed)	? POSIX_MADV_WILLNEED	:
+											  POSIX_MADV_NORMAL		;
+
+	// madvise wants a page-aligned start: widen the range down to the page holding offset.
+	auto* start = data() + offset;
+	auto* end   = start + ((length < length_ - offset) ? length : length_ - offset);
+	auto  align = size_t(start - base_) % granularity();
+	return posix_madvise(start - align, size_t(end - start) + align, native) == 0;
+}
+
+bool mapped_file::flush(bool wait) {
+	if (!base_ || mode_ != map_mode::read_write) return true;
+	if (msync(base_, base_len_, wait ? MS_SYNC : MS_ASYNC) < 0) {
+		error_ = errno;
+		return false;
+	}
+	return true;
+}
+#endif
+
+} // namespace fs
@@ -0,0 +1,185 @@
+#include "fs_read_batch.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <vector>
+
+#if PLATFORM_POSIX
+#	include <climits>
+#	include <sys/uio.h>
+#endif
+
+namespace fs {
+
+#if PLATFORM_POSIX && defined(IOV_MAX)
+static const size_t iov_max = IOV_MAX;
+#else
+static const size_t iov_max = 1024;
+#endif
+
+struct run_reader
+{
+	int						fd;
+	read_range*				ranges;
+	const size_t*			order;
+	read_batch_stats&		stats;
+	std::vector<uint8_t>	scratch;
+#if PLATFORM_POSIX
+	std::vector<iovec>		iov;
+#endif
+
+	run_reader(int fd, read_range* ranges, const size_t* order, read_batch_stats& stats)
+		: fd(fd), ranges(ranges), order(order), stats(stats) { }
+
+	// total is the number of bytes read from the start of the run, err the errno that cut it short.
+	void finish(size_t first, size_t last, x_off_t run_start, intmax_t total, int err) {
+		for (auto i = first; i < last; ++i) {
+			auto& r = ranges[order[i]];
+			auto delivered = std::clamp<intmax_t>(total - intmax_t(r.offset - run_start), 0, intmax_t(r.length));
+			r.result = (err && delivered < intmax_t(r.length)) ? -intmax_t(err) : delivered;
+		}
+	}
+
+	// a lone range goes straight into its own buffer.
+	void read_single(read_range& r) {
+		intmax_t total = 0;
+		int err = 0;
+		while (total < intmax_t(r.length)) {
+			auto got = intmax_t(posix_pread(fd, (uint8_t*)r.dest + total, r.length - size_t(total), r.offset + total));
+			++stats.syscalls;
+			if (got < 0) {
+				if (errno == EINTR) continue;
+				err = errno;
+				break;
+			}
+			if (!got) break;
+			total += got;
+		}
+		r.result = (err && !total) ? -intmax_t(err) : total;
+	}
+
+	void read_run(size_t first, size_t last, x_off_t run_start, x_off_t run_end) {
+		++stats.runs;
+		if (last - first == 1) {
+			read_single(ranges[order[first]]);
+			return;
+		}
+
+		intmax_t total = 0;
+		int err = 0;
+		auto want = intmax_t(run_end - run_start);
+
+#if PLATFORM_POSIX
+		// gaps all land in the same scratch space: their contents are discarded anyway.
+		iov.clear();
+		auto pos = run_start;
+		for (auto i = first; i < last; ++i) {
+			auto& r = ranges[order[i]];
+			if (r.offset > pos) {
+				iov.push_back({ scratch.data(), size_t(r.offset - pos) });
+			}
+			iov.push_back({ r.dest, r.length });
+			pos = r.offset + x_off_t(r.length);
+		}
+
+		size_t vi = 0;
+		while (total < want) {
+			auto got = intmax_t(preadv(fd, &iov[vi], int(std::min(iov.size() - vi, iov_max)), off_t(run_start + total)));
+			++stats.syscalls;
+			if (got < 0) {
+				if (errno == EINTR) continue;
+				err = errno;
+				break;
+			}
+			if (!got) break;
+			total += got;
+
+			// short read: skip what was filled and resume mid-list.
+			while (got && vi < iov.size()) {
+				if (size_t(got) >= iov[vi].iov_len) {
+					got -= intmax_t(iov[vi].iov_len);
+					++vi;
+				}
+				else {
+					iov[vi].iov_base = (uint8_t*)iov[vi].iov_base + got;
+					iov[vi].iov_len -= size_t(got);
+					got = 0;
+				}
+			}
+		}
+#else
+		// no preadv: read the run whole and slice it.
+		scratch.resize(std::max(scratch.size(), size_t(want)));
+		auto got = intmax_t(posix_pread(fd, scratch.data(), size_t(want), run_start));
+		++stats.syscalls;
+		if (got < 0) {
+			err = errno;
+		}
+		else {
+			total = got;
+			for (auto i = first; i < last; ++i) {
+				auto& r = ranges[order[i]];
+				auto avail = std::clamp<intmax_t>(total - intmax_t(r.offset - run_start), 0, intmax_t(r.length));
+				memcpy(r.dest, scratch.data() + (r.offset - run_start), size_t(avail));
+			}
+		}
+#endif
+		finish(first, last, run_start, total, err);
+	}
+};
+
+read_batch_stats read_ranges(int fd, read_range* ranges, size_t count, const read_batch_options& options)
+{
+	read_batch_stats stats;
+
+	std::vector<size_t> order;
+	order.reserve(count);
+	for (size_t i=0; i<count; ++i) {
+		ranges[i].result = 0;
+		if (ranges[i].length) {
+			order.push_back(i);
+		}
+	}
+	auto by_offset = [&](size_t a, size_t b) { return ranges[a].offset < ranges[b].offset; };
+	if (!std::is_sorted(order.begin(), order.end(), by_offset)) {
+		std::sort(order.begin(), order.end(), by_offset);
+	}
+
+	run_reader reader(fd, ranges, order.data(), stats);
+#if PLATFORM_POSIX
+	reader.scratch.resize(options.max_gap);
+#endif
+
+	size_t i = 0;
+	while (i < order.size()) {
+		const auto& head = ranges[order[i]];
+		auto run_start	= head.offset;
+		auto run_end	= head.offset + x_off_t(head.length);
+		size_t iovs		= 1;
+		size_t gaps		= 0;
+
+		auto j = i + 1;
+		for (; j < order.size(); ++j) {
+			const auto& r = ranges[order[j]];
+			if (r.offset < run_end) break;											// overlaps
+			auto gap = size_t(r.offset - run_end);
+			if (gap > options.max_gap) break;
+			if (size_t(r.offset - run_start) + r.length > options.max_span) break;
+			if (iovs + (gap ? 2 : 1) > iov_max) break;
+
+			iovs	+= gap ? 2 : 1;
+			gaps	+= gap;
+			run_end  = r.offset + x_off_t(r.length);
+		}
+
+		reader.read_run(i, j, run_start, run_end);
+		if (j - i > 1) {
+			stats.gap_bytes += intmax_t(gaps);
+		}
+		i = j;
+	}
+	return stats;
+}
+
+} // namespace fs
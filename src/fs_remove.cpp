@@ -0,0 +1,511 @@
+#include "fs_remove.h"
+#include "fs_directory.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <deque>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+#if PLATFORM_MSW
+#	define NOMINMAX
+#	define NO_STRICT
+#	define WIN32_LEAN_AND_MEAN
+#	include <Windows.h>
+#elif PLATFORM_POSIX
+#	include <fcntl.h>
+#	include <unistd.h>
+#	include <sys/stat.h>
+#endif
+
+namespace fs {
+
+// Directories whose children may still need them stay open (see remove_node::fd). Past this many,
+// a directory's subdirectories are removed inline by the worker listing it, with one directory open
+// at a time (see remove_inline), so very deep trees can't exhaust the process fd limit.
+static const int remove_max_retained_fds = 256;
+
+// A directory being removed. Freed by whichever worker removes it.
+struct remove_node
+{
+	remove_node*		parent		= nullptr;
+	std::string			dir;						// universal path
+	size_t				name_pos	= 0;			// start of the final component within dir
+	int					fd			= -1;			// posix: kept open for children's openat/unlinkat
+
+	// one for the listing in progress, plus one per subdirectory not yet removed.
+	std::atomic<int>	pending		= { 1 };
+	std::atomic<bool>	incomplete	= { false };	// something below couldn't be removed
+
+	const char* name() const { return dir.c_str() + name_pos; }
+};
+
+// already gone is as good as removed.
+static bool is_gone(int err) {
+#if PLATFORM_MSW
+	return err == ERROR_FILE_NOT_FOUND || err == ERROR_PATH_NOT_FOUND;
+#else
+	return err == ENOENT;
+#endif
+}
+
+struct remove_queue {
+	std::mutex					mutex;
+	std::deque<remove_node*>	tasks;
+};
+
+class remover
+{
+protected:
+	const remove_options&				options_;
+	int									workers_;
+	std::unique_ptr<remove_queue[]>		queues_;
+
+	std::atomic<intmax_t>				pending_	= { 0 };		// tasks queued or in progress
+	std::atomic<int>					retained_	= { 0 };
+	std::atomic<intmax_t>				files_		= { 0 };
+	std::atomic<intmax_t>				dirs_		= { 0 };
+	std::atomic<intmax_t>				bytes_		= { 0 };
+	std::atomic<intmax_t>				errors_		= { 0 };
+
+	std::mutex							failures_mutex_;
+	std::vector<remove_failure>			failures_;
+
+public:
+	remover(const remove_options& options, int workers)
+		: options_(options), workers_(workers), queues_(new remove_queue[workers]) { }
+
+	remove_stats run(const path& root) {
+		auto* node = new remove_node;
+		node->dir = root.uni_string();
+		push(0, node);
+
+		std::vector<std::thread> threads;
+		threads.reserve(workers_ - 1);
+		for (int worker=1; worker<workers_; ++worker) {
+			threads.emplace_back([this, worker]() { work(worker); });
+		}
+		work(0);
+		for (auto& thread : threads) {
+			thread.join();
+		}
+		return stats();
+	}
+
+	// a root that isn't a directory.
+	remove_stats run_single(const path& root, const CStatInfo& st) {
+		if (!options_.dry_run) {
+			std::error_code ec;
+			if (!std::filesystem::remove(root.asLibcStr(), ec) && ec) {
+				fail(std::string(root.uni_string()), ec.value());
+				return stats();
+			}
+		}
+		++files_;
+		if (options_.count_bytes && st.IsFile()) {
+			bytes_ += st.st_size;
+		}
+		return stats();
+	}
+
+	// a root that couldn't be stat'd.
+	remove_stats run_failed(const path& root, int err) {
+		fail(std::string(root.uni_string()), err);
+		return stats();
+	}
+
+protected:
+	remove_stats stats() {
+		remove_stats result;
+		result.files	= files_;
+		result.dirs		= dirs_;
+		result.bytes	= bytes_;
+		result.errors	= errors_;
+		result.failures	= std::move(failures_);
+		return result;
+	}
+
+	void fail(std::string&& item, int err) {
+		errors_.fetch_add(1, std::memory_order_relaxed);
+		std::lock_guard<std::mutex> lock(failures_mutex_);
+		if (failures_.size() < options_.max_failures) {
+			failures_.push_back({ std::move(item), err });
+		}
+	}
+
+	void push(int worker, remove_node* node) {
+		pending_.fetch_add(1, std::memory_order_acq_rel);
+		auto& queue = queues_[worker];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		queue.tasks.push_back(node);
+	}
+
+	bool pop(int worker, remove_node*& dest) {
+		{
+			// own queue: newest first, so subtrees are finished (and their fds released) early.
+			auto& queue = queues_[worker];
+			std::lock_guard<std::mutex> lock(queue.mutex);
+			if (!queue.tasks.empty()) {
+				dest = queue.tasks.back();
+				queue.tasks.pop_back();
+				return true;
+			}
+		}
+
+		for (int i=1; i<workers_; ++i) {
+			auto& queue = queues_[(worker + i) % workers_];
+			std::lock_guard<std::mutex> lock(queue.mutex);
+			if (!queue.tasks.empty()) {
+				dest = queue.tasks.front();
+				queue.tasks.pop_front();
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void work(int worker) {
+		std::string fullpath;
+		remove_node* node;
+		int idle = 0;
+
+		while (1) {
+			if (pop(worker, node)) {
+				process(worker, node, fullpath);
+				pending_.fetch_sub(1, std::memory_order_acq_rel);
+				idle = 0;
+				continue;
+			}
+			if (pending_.load(std::memory_order_acquire) == 0) {
+				break;
+			}
+			if (++idle < 64) {
+				std::this_thread::yield();
+			}
+			else {
+				std::this_thread::sleep_for(std::chrono::microseconds(50));
+			}
+		}
+	}
+
+	directory_stream open(remove_node* node, int& err) {
+#if PLATFORM_POSIX
+		// only the root is opened by path: anything else by path could be redirected by a symlink
+		// swapped in for one of its components meanwhile.
+		auto* parent = node->parent;
+		int fd = parent
+			? openat(parent->fd, node->name(), O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC)
+			: ::open(node->dir.c_str(), O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+		if (fd < 0) {
+			err = errno;
+			return {};
+		}
+
+		// children are queued while the listing runs, so whether they may use this fd has to be
+		// settled before the first is pushed.
+		if (retained_.fetch_add(1, std::memory_order_relaxed) < remove_max_retained_fds) {
+			node->fd = fcntl(fd, F_DUPFD_CLOEXEC, 0);
+		}
+		if (node->fd < 0) {
+			retained_.fetch_sub(1, std::memory_order_relaxed);
+		}
+		return directory_stream::adopt_fd(fd);
+#else
+		directory_stream stream(path(path_view(node->dir)));
+		err = stream.error();
+		return stream;
+#endif
+	}
+
+	// removes a non-directory entry of the stream being listed. Returns 0 or an error code.
+	int remove_entry(const directory_stream& stream, const dir_entry& entry, [[maybe_unused]] const std::string& fullpath, file_type& type) {
+#if PLATFORM_POSIX
+		int dirfd = stream.native_fd();
+		if (type == file_type::unknown || (type == file_type::regular && options_.count_bytes)) {
+			struct stat sinfo;
+			if (fstatat(dirfd, entry.name.data(), &sinfo, AT_SYMLINK_NOFOLLOW) < 0) {
+				return (errno == ENOENT) ? 0 : errno;
+			}
+			if (S_ISDIR(sinfo.st_mode)) {
+				type = file_type::directory;		// d_type wasn't filled in
+				return 0;
+			}
+			if (S_ISREG(sinfo.st_mode) && options_.count_bytes) {
+				bytes_.fetch_add(sinfo.st_size, std::memory_order_relaxed);
+			}
+		}
+		if (!options_.dry_run && unlinkat(dirfd, entry.name.data(), 0) < 0 && errno != ENOENT) {
+			return errno;
+		}
+#else
+		// msw: sizes come with the listing, removal is by path.
+		if (options_.count_bytes) {
+			auto st = stream.status(entry);
+			if (st.IsFile()) bytes_.fetch_add(st.st_size, std::memory_order_relaxed);
+		}
+		if (!options_.dry_run) {
+			std::error_code ec;
+			if (!std::filesystem::remove(path(path_view(fullpath)).asLibcStr(), ec) && ec) {
+				return ec.value();
+			}
+		}
+#endif
+		files_.fetch_add(1, std::memory_order_relaxed);
+		return 0;
+	}
+
+	void process(int worker, remove_node* node, std::string& fullpath) {
+		int err = 0;
+		auto stream = open(node, err);
+		if (!stream.is_open()) {
+			if (!is_gone(err)) {
+				fail(std::string(node->dir), err);
+				node->incomplete = true;
+			}
+			release(node);
+			return;
+		}
+
+		fullpath  = node->dir;
+		fullpath += '/';
+		auto dirlen = fullpath.length();
+
+		dir_entry entry;
+		while (stream.next(entry)) {
+			fullpath.resize(dirlen);
+			fullpath += entry.name;
+
+			auto type = entry.type;
+			if (type != file_type::directory) {
+				if (int entry_err = remove_entry(stream, entry, fullpath, type)) {
+					fail(std::string(fullpath), entry_err);
+					node->incomplete = true;
+					continue;
+				}
+				if (type != file_type::directory) continue;
+			}
+
+#if PLATFORM_POSIX
+			if (node->fd < 0) {
+				// no fd to hand to a child task.
+				if (!remove_inline(stream.native_fd(), entry.name.data(), fullpath)) {
+					node->incomplete = true;
+				}
+				continue;
+			}
+#endif
+			auto* child = new remove_node;
+			child->parent	= node;
+			child->dir		= fullpath;
+			child->name_pos	= dirlen;
+			node->pending.fetch_add(1, std::memory_order_relaxed);
+			push(worker, child);
+		}
+
+		if (stream.error()) {
+			fail(std::string(node->dir), stream.error());
+			node->incomplete = true;
+		}
+		release(node);
+	}
+
+	// drops a reference to node, removing it (and then any ancestors) once nothing below remains.
+	void release(remove_node* node) {
+		while (node && node->pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+			auto* parent = node->parent;
+#if PLATFORM_POSIX
+			if (node->fd >= 0) {
+				::close(node->fd);
+				retained_.fetch_sub(1, std::memory_order_relaxed);
+			}
+#endif
+			if (node->incomplete) {
+				// whatever failed below was already reported; the ENOTEMPTY here would only repeat it.
+				if (parent) parent->incomplete = true;
+			}
+			else if (int err = remove_dir(node)) {
+				fail(std::string(node->dir), err);
+				if (parent) parent->incomplete = true;
+			}
+			else {
+				dirs_.fetch_add(1, std::memory_order_relaxed);
+			}
+			delete node;
+			node = parent;
+		}
+	}
+
+#if PLATFORM_POSIX
+	// removes directory name of dirfd and everything below it on the calling worker, with one
+	// directory open at a time however deep it goes: a subdirectory is opened relative to the
+	// directory listing it, which is closed meanwhile and reopened afterwards as the subdirectory's
+	// "..", provided that's still the same directory. Returns false if anything was left behind.
+	bool remove_inline(int dirfd, const char* name, std::string& fullpath) {
+		struct level {
+			std::string						name;			// in the directory above
+			size_t							pathlen;		// of fullpath, for this directory
+			dev_t							dev;
+			ino_t							ino;
+			bool							complete;
+			std::unordered_set<std::string>	left;			// entries still there once handled, not to revisit
+		};
+		std::vector<level> levels;
+
+		// opens directory child of parentfd as the new innermost level. Returns 0 or an error code,
+		// recorded against the level above unless the directory is already gone.
+		directory_stream stream;
+		auto enter = [&](int parentfd, std::string_view child) {
+			int fd = openat(parentfd, child.data(), O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+			struct stat sinfo;
+			if (fd >= 0 && fstat(fd, &sinfo) < 0) {
+				::close(fd);
+				fd = -1;
+			}
+			if (fd < 0) {
+				int err = errno;
+				if (is_gone(err)) return err;
+				fail(std::string(fullpath), err);
+				if (!levels.empty()) {
+					levels.back().left.emplace(child);
+					levels.back().complete = false;
+				}
+				return err;
+			}
+			levels.push_back({ std::string(child), fullpath.length(), sinfo.st_dev, sinfo.st_ino, true, {} });
+			stream = directory_stream::adopt_fd(fd);		// closes the directory above
+			return 0;
+		};
+
+		// removes the innermost level, now listed, from parentfd.
+		auto leave = [&](int parentfd) {
+			auto& done = levels.back();
+			fullpath.resize(done.pathlen);
+			if (done.complete && !options_.dry_run && unlinkat(parentfd, done.name.c_str(), AT_REMOVEDIR) < 0 && errno != ENOENT) {
+				fail(std::string(fullpath), errno);
+				done.complete = false;
+			}
+			if (done.complete) {
+				dirs_.fetch_add(1, std::memory_order_relaxed);
+			}
+			bool complete = done.complete;
+			if (levels.size() > 1) {
+				auto& above = levels[levels.size() - 2];
+				above.complete = above.complete && complete;
+				if (!complete || options_.dry_run) above.left.emplace(std::move(done.name));
+			}
+			levels.pop_back();
+			return complete;
+		};
+
+		if (int err = enter(dirfd, name)) return is_gone(err);
+
+		dir_entry entry;
+		while (true) {
+			auto* current = &levels.back();
+			fullpath.resize(current->pathlen);
+			fullpath += '/';
+			auto dirlen = fullpath.length();
+
+			bool descended = false;
+			while (!descended && stream.next(entry)) {
+				if (!current->left.empty() && current->left.count(std::string(entry.name))) continue;
+				fullpath.resize(dirlen);
+				fullpath += entry.name;
+
+				auto type = entry.type;
+				if (type != file_type::directory) {
+					if (int entry_err = remove_entry(stream, entry, fullpath, type)) {
+						fail(std::string(fullpath), entry_err);
+						current->left.emplace(entry.name);
+						current->complete = false;
+						continue;
+					}
+					if (type != file_type::directory) {
+						if (options_.dry_run) current->left.emplace(entry.name);
+						continue;
+					}
+				}
+				descended = !enter(stream.native_fd(), entry.name);
+			}
+			if (descended) continue;
+
+			fullpath.resize(current->pathlen);
+			if (stream.error()) {
+				fail(std::string(fullpath), stream.error());
+				current->complete = false;
+			}
+			if (levels.size() == 1) break;
+
+			// back up to the directory above, which must not have moved meanwhile.
+			const auto& above = levels[levels.size() - 2];
+			int up = openat(stream.native_fd(), "..", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+			struct stat sinfo;
+			int err = (up < 0 || fstat(up, &sinfo) < 0) ? errno : 0;
+			if (!err && (sinfo.st_dev != above.dev || sinfo.st_ino != above.ino)) {
+				err = ESTALE;
+			}
+			if (err) {
+				if (up >= 0) ::close(up);
+				fail(std::string(fullpath), err);
+				fullpath.resize(levels.front().pathlen);
+				return false;
+			}
+			stream = directory_stream::adopt_fd(up);			// closes the one just listed
+			leave(up);
+		}
+		stream = directory_stream();
+		return leave(dirfd);
+	}
+#endif
+
+	int remove_dir(remove_node* node) {
+		if (options_.dry_run) return 0;
+#if PLATFORM_POSIX
+		auto* parent = node->parent;
+		int result = parent
+			? unlinkat(parent->fd, node->name(), AT_REMOVEDIR)
+			: unlinkat(AT_FDCWD, node->dir.c_str(), AT_REMOVEDIR);
+		return (result < 0 && errno != ENOENT) ? errno : 0;
+#else
+		std::error_code ec;
+		std::filesystem::remove(path(path_view(node->dir)).asLibcStr(), ec);
+		return ec.value();
+#endif
+	}
+};
+
+remove_stats remove_all(const path& root, const remove_options& options)
+{
+	int workers = (options.threads > 0) ? options.threads : std::max(1, (int)std::thread::hardware_concurrency());
+	remover r(options, workers);
+
+#if PLATFORM_POSIX
+	struct stat sinfo;
+	if (lstat(root.c_str(), &sinfo) < 0) {
+		return (errno == ENOENT) ? remove_stats() : r.run_failed(root, errno);
+	}
+	if (!S_ISDIR(sinfo.st_mode)) {
+		return r.run_single(root, { uint32_t(sinfo.st_mode), intmax_t(sinfo.st_size), sinfo.st_atime, sinfo.st_mtime, sinfo.st_ctime });
+	}
+#else
+	auto st = status(root);
+	if (!st.Exists()) {
+		std::error_code ec;
+		std::filesystem::symlink_status(root.asLibcStr(), ec);
+		bool missing = !ec || ec == std::errc::no_such_file_or_directory;
+		return missing ? remove_stats() : r.run_failed(root, ec.value());
+	}
+	if (!st.IsDir()) {
+		return r.run_single(root, st);
+	}
+#endif
+	return r.run(root);
+}
+
+} // namespace fs
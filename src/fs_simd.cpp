@@ -0,0 +1,284 @@
+#include "fs_simd.h"
+#include "StringUtil.h"
+
+#include <atomic>
+
+#if FS_SIMD_X86
+#	include <emmintrin.h>
+#	include <immintrin.h>
+#	if defined(_MSC_VER)
+#		include <intrin.h>
+#	endif
+#endif
+
+#if FS_SIMD_NEON
+#	include <arm_neon.h>
+#endif
+
+namespace fs {
+namespace simd {
+
+using TranslateFn = void   (char* dst, const char* src, size_t len, char from, char to);
+using FindSepFn   = size_t (const char* src, size_t len);
+
+// --------------------------------------------------------------------------------------------------
+// scalar (reference implementation, also handles tails of the vector kernels)
+
+static void TranslateChar_scalar(char* dst, const char* src, size_t len, char from, char to) {
+	for (size_t i=0; i<len; ++i) {
+		dst[i] = (src[i] == from) ? to : src[i];
+	}
+}
+
+static size_t FindPathSep_scalar(const char* src, size_t len) {
+	for (size_t i=0; i<len; ++i) {
+		if (src[i] == '/' || src[i] == '\\') return i;
+	}
+	return len;
+}
+
+#if FS_SIMD_X86
+static int first_set_bit(uint32_t mask) {
+#if defined(_MSC_VER)
+	unsigned long idx;
+	_BitScanForward(&idx, mask);
+	return int(idx);
+#else
+	return __builtin_ctz(mask);
+#endif
+}
+
+// --------------------------------------------------------------------------------------------------
+// SSE2 (baseline on x86-64, checked for on 32-bit x86)
+
+FS_TARGET_SSE2 static void TranslateChar_sse2(char* dst, const char* src, size_t len, char from, char to) {
+	const __m128i vfrom = _mm_set1_epi8(from);
+	const __m128i vflip = _mm_set1_epi8(char(from ^ to));
+
+	size_t i = 0;
+	for (; i + 16 <= len; i += 16) {
+		__m128i v    = _mm_loadu_si128((const __m128i*)(src + i));
+		__m128i hits = _mm_cmpeq_epi8(v, vfrom);
+		_mm_storeu_si128((__m128i*)(dst + i), _mm_xor_si128(v, _mm_and_si128(hits, vflip)));
+	}
+	TranslateChar_scalar(dst + i, src + i, len - i, from, to);
+}
+
+FS_TARGET_SSE2 static size_t FindPathSep_sse2(const char* src, size_t len) {
+	const __m128i vfwd  = _mm_set1_epi8('/');
+	const __m128i vback = _mm_set1_epi8('\\');
+
+	size_t i = 0;
+	for (; i + 16 <= len; i += 16) {
+		__m128i v    = _mm_loadu_si128((const __m128i*)(src + i));
+		__m128i hits = _mm_or_si128(_mm_cmpeq_epi8(v, vfwd), _mm_cmpeq_epi8(v, vback));
+		if (uint32_t mask = (uint32_t)_mm_movemask_epi8(hits)) {
+			return i + first_set_bit(mask);
+		}
+	}
+	return i + FindPathSep_scalar(src + i, len - i);
+}
+
+// --------------------------------------------------------------------------------------------------
+// AVX2
+//
+// Tails are handled inline rather than by tail-calling the SSE2 kernels: those are legacy-encoded,
+// and entering them with dirty upper YMM state costs a transition penalty on every call, which for
+// typical short paths made AVX2 several times slower than SSE2.
+
+FS_TARGET_AVX2 static void TranslateChar_avx2(char* dst, const char* src, size_t len, char from, char to) {
+	size_t i = 0;
+	if (len >= 32) {
+		const __m256i vfrom = _mm256_set1_epi8(from);
+		const __m256i vflip = _mm256_set1_epi8(char(from ^ to));
+		for (; i + 32 <= len; i += 32) {
+			__m256i v    = _mm256_loadu_si256((const __m256i*)(src + i));
+			__m256i hits = _mm256_cmpeq_epi8(v, vfrom);
+			_mm256_storeu_si256((__m256i*)(dst + i), _mm256_xor_si256(v, _mm256_and_si256(hits, vflip)));
+		}
+		_mm256_zeroupper();
+	}
+
+	const __m128i vfrom = _mm_set1_epi8(from);
+	const __m128i vflip = _mm_set1_epi8(char(from ^ to));
+	for (; i + 16 <= len; i += 16) {
+		__m128i v    = _mm_loadu_si128((const __m128i*)(src + i));
+		__m128i hits = _mm_cmpeq_epi8(v, vfrom);
+		_mm_storeu_si128((__m128i*)(dst + i), _mm_xor_si128(v, _mm_and_si128(hits, vflip)));
+	}
+	for (; i < len; ++i) {
+		dst[i] = (src[i] == from) ? to : src[i];
+	}
+}
+
+FS_TARGET_AVX2 static size_t FindPathSep_avx2(const char* src, size_t len) {
+	size_t i = 0;
+	if (len >= 32) {
+		const __m256i vfwd  = _mm256_set1_epi8('/');
+		const __m256i vback = _mm256_set1_epi8('\\');
+		for (; i + 32 <= len; i += 32) {
+			__m256i v    = _mm256_loadu_si256((const __m256i*)(src + i));
+			__m256i hits = _mm256_or_si256(_mm256_cmpeq_epi8(v, vfwd), _mm256_cmpeq_epi8(v, vback));
+			if (uint32_t mask = (uint32_t)_mm256_movemask_epi8(hits)) {
+				_mm256_zeroupper();
+				return i + first_set_bit(mask);
+			}
+		}
+		_mm256_zeroupper();
+	}
+
+	for (; i < len; ++i) {
+		if (src[i] == '/' || src[i] == '\\') return i;
+	}
+	return len;
+}
+
+static bool cpu_has_sse2() {
+#if defined(__x86_64__) || defined(_M_X64)
+	return true;
+#elif defined(_MSC_VER)
+	int regs[4];
+	__cpuid(regs, 1);
+	return (regs[3] & (1 << 26)) != 0;
+#else
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("sse2");
+#endif
+}
+
+static bool cpu_has_avx2() {
+#if defined(_MSC_VER)
+	int regs[4];
+	__cpuid(regs, 0);
+	if (regs[0] < 7) return false;
+
+	// AVX2 also needs the OS to preserve YMM state: OSXSAVE set and XCR0 enabling SSE|AVX state.
+	__cpuid(regs, 1);
+	if (!(regs[2] & (1 << 27))) return false;
+	if ((_xgetbv(0) & 6) != 6) return false;
+
+	__cpuidex(regs, 7, 0);
+	return (regs[1] & (1 << 5)) != 0;
+#else
+	__builtin_cpu_init();		// required when called during static initialization
+	return __builtin_cpu_supports("avx2");
+#endif
+}
+#endif
+
+#if FS_SIMD_NEON
+// --------------------------------------------------------------------------------------------------
+// NEON (baseline on aarch64)
+
+static void TranslateChar_neon(char* dst, const char* src, size_t len, char from, char to) {
+	const uint8x16_t vfrom = vdupq_n_u8(uint8_t(from));
+	const uint8x16_t vto   = vdupq_n_u8(uint8_t(to));
+
+	size_t i = 0;
+	for (; i + 16 <= len; i += 16) {
+		uint8x16_t v    = vld1q_u8((const uint8_t*)(src + i));
+		uint8x16_t hits = vceqq_u8(v, vfrom);
+		vst1q_u8((uint8_t*)(dst + i), vbslq_u8(hits, vto, v));
+	}
+	TranslateChar_scalar(dst + i, src + i, len - i, from, to);
+}
+
+static size_t FindPathSep_neon(const char* src, size_t len) {
+	const uint8x16_t vfwd  = vdupq_n_u8('/');
+	const uint8x16_t vback = vdupq_n_u8('\\');
+
+	size_t i = 0;
+	for (; i + 16 <= len; i += 16) {
+		uint8x16_t v    = vld1q_u8((const uint8_t*)(src + i));
+		uint8x16_t hits = vorrq_u8(vceqq_u8(v, vfwd), vceqq_u8(v, vback));
+		if (vmaxvq_u8(hits)) {
+			return i + FindPathSep_scalar(src + i, 16);
+		}
+	}
+	return i + FindPathSep_scalar(src + i, len - i);
+}
+#endif
+
+// --------------------------------------------------------------------------------------------------
+// dispatch
+
+struct KernelSet {
+	TranslateFn*	translate;
+	FindSepFn*		find_sep;
+};
+
+static KernelSet get_kernels(isa which) {
+	switch (which) {
+#if FS_SIMD_X86
+		case isa::sse2: return { TranslateChar_sse2, FindPathSep_sse2 };
+		case isa::avx2: return { TranslateChar_avx2, FindPathSep_avx2 };
+#endif
+#if FS_SIMD_NEON
+		case isa::neon: return { TranslateChar_neon, FindPathSep_neon };
+#endif
+		default: break;
+	}
+	return { TranslateChar_scalar, FindPathSep_scalar };
+}
+
+static isa detect_best_isa() {
+#if FS_SIMD_X86
+	return cpu_has_avx2() ? isa::avx2 : cpu_has_sse2() ? isa::sse2 : isa::scalar;
+#elif FS_SIMD_NEON
+	return isa::neon;
+#else
+	return isa::scalar;
+#endif
+}
+
+// Function-local static so that paths constructed during static init of other TUs are safe.
+static std::atomic<isa>& active_isa() {
+	static std::atomic<isa> s_active = { detect_best_isa() };
+	return s_active;
+}
+
+bool IsaSupported(isa which) {
+	switch (which) {
+		case isa::scalar: return true;
+#if FS_SIMD_X86
+		case isa::sse2: return cpu_has_sse2();
+		case isa::avx2: return cpu_has_avx2();
+#endif
+#if FS_SIMD_NEON
+		case isa::neon: return true;
+#endif
+		default: break;
+	}
+	return false;
+}
+
+const char* IsaName(isa which) {
+	switch (which) {
+		CaseReturnString(isa::scalar);
+		CaseReturnString(isa::sse2);
+		CaseReturnString(isa::avx2);
+		CaseReturnString(isa::neon);
+	}
+	return "unknown";
+}
+
+isa ActiveIsa() {
+	return active_isa().load(std::memory_order_relaxed);
+}
+
+bool ForceIsa(isa which) {
+	if (!IsaSupported(which)) return false;
+	active_isa().store(which, std::memory_order_relaxed);
+	return true;
+}
+
+void TranslateChar(char* dst, const char* src, size_t len, char from, char to) {
+	get_kernels(ActiveIsa()).translate(dst, src, len, from, to);
+}
+
+size_t FindPathSep(const char* src, size_t len) {
+	return get_kernels(ActiveIsa()).find_sep(src, len);
+}
+
+} // namespace simd
+} // namespace fs
@@ -0,0 +1,370 @@
+#include "fs_snapshot.h"
+#include "fs_directory.h"
+#include "fs_hash.h"
+#include "fs_walk.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+#include <mutex>
+#include <numeric>
+#include <string>
+#include <vector>
+
+#if PLATFORM_MSW
+#	include <process.h>
+#elif PLATFORM_POSIX
+#	include <fcntl.h>
+#	include <unistd.h>
+#	include <sys/stat.h>
+#endif
+
+namespace fs {
+
+static const char		snapshot_magic[8]	= { 'I', 'C', 'Y', 'S', 'N', 'A', 'P', 0 };
+static const uint32_t	snapshot_byte_order	= 0x01020304;
+
+static uint64_t align_up(uint64_t value, uint64_t alignment) {
+	return (value + alignment - 1) & ~(alignment - 1);
+}
+
+// stat of the entry itself, not of a symlink's target. Returns 0 or an error code.
+static int lstat_info(const path_view& item, CStatInfo& dest) {
+#if PLATFORM_POSIX
+	// walk_entry paths aren't guaranteed to be null-terminated.
+	thread_local std::string native;
+	native.assign(item.uni_string());
+	struct stat sinfo;
+	if (lstat(native.c_str(), &sinfo) < 0) {
+		return errno;
+	}
+	dest = { uint32_t(sinfo.st_mode), intmax_t(sinfo.st_size), sinfo.st_atime, sinfo.st_mtime, sinfo.st_ctime };
+	return 0;
+#else
+	dest = status(path(item));
+	return dest.Exists() ? 0 : ENOENT;
+#endif
+}
+
+static bool write_full(int fd, const void* src, size_t length) {
+	auto* pos = (const uint8_t*)src;
+	while (length) {
+		auto chunk = std::min<size_t>(length, 1024 * 1024 * 1024);
+		auto wrote = intmax_t(posix_write(fd, pos, (unsigned)chunk));
+		if (wrote < 0) {
+			if (errno == EINTR) continue;
+			return false;
+		}
+		pos    += wrote;
+		length -= size_t(wrote);
+	}
+	return true;
+}
+
+// writes the image to a temporary sibling of file and renames it into place. Returns 0 or an error code.
+static int write_atomically(const path& file, const snapshot_header& header, const std::vector<snapshot_record>& records, const std::string& strings) {
+	static std::atomic<unsigned> s_sequence = { 0 };
+#if PLATFORM_MSW
+	auto pid = unsigned(_getpid());
+#else
+	auto pid = unsigned(getpid());
+#endif
+	path temp = sFmtStr("%s.%u-%u.tmp", file.uni_string().c_str(), pid, s_sequence++).c_str();
+
+	int fd = posix_open(temp.c_str(), O_WRONLY | O_CREAT | O_EXCL, DEFFILEMODE);
+	if (fd < 0) {
+		return errno;
+	}
+
+	static const uint8_t padding[64] = {};
+	int err = 0;
+	if (!write_full(fd, &header, sizeof(header))
+	||  !write_full(fd, padding, size_t(header.records_offset - sizeof(header)))
+	||  !write_full(fd, records.data(), records.size() * sizeof(snapshot_record))
+	||  !write_full(fd, strings.data(), strings.size())) {
+		err = errno;
+	}
+
+	// the rename must not become durable ahead of the data it exposes.
+#if PLATFORM_MSW
+	if (!err && _commit(fd) < 0) err = errno;
+#else
+	if (!err && fsync(fd) < 0) err = errno;
+#endif
+	if (posix_close(fd) < 0 && !err) {
+		err = errno;
+	}
+
+	if (!err) {
+		std::error_code ec;
+		std::filesystem::rename(temp.asLibcStr(), file.asLibcStr(), ec);
+		err = ec.value();
+	}
+	if (err) {
+		posix_unlink(temp.c_str());
+		return err;
+	}
+
+#if PLATFORM_POSIX
+	// and the rename itself, which lives in the directory.
+	auto parent = file.uni_string();
+	auto slash  = parent.rfind('/');
+	parent = (slash == std::string::npos) ? std::string(".") : parent.substr(0, slash ? slash : 1);
+	int dirfd = ::open(parent.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if (dirfd >= 0) {
+		fsync(dirfd);
+		::close(dirfd);
+	}
+#endif
+	return 0;
+}
+
+snapshot_result write_snapshot(const path& root, const path& file, const snapshot_options& options)
+{
+	struct item {
+		std::string		relative;
+		CStatInfo		info;
+	};
+
+	snapshot_result result;
+	std::vector<item> items(1);
+
+	// the root is followed if it's a symlink: it's what the caller asked for.
+	items[0].info = status(root);
+	if (!items[0].info.IsDir()) {
+		result.error = items[0].info.Exists() ? ENOTDIR : ENOENT;
+		return result;
+	}
+
+	std::mutex mutex;
+	std::atomic<intmax_t> stat_errors = { 0 };
+
+	walk_options walk_opts;
+	walk_opts.threads = options.threads;
+	if (options.filter) {
+		walk_opts.filter  = [&](const walk_entry& entry) { return options.filter(entry.relative, entry.is_directory()); };
+		walk_opts.descend = walk_opts.filter;
+	}
+
+	auto created = time(nullptr);
+	auto listed = walk(root, [&](const walk_entry& entry) {
+		CStatInfo info;
+		if (int err = lstat_info(entry.path, info)) {
+			if (err != ENOENT) stat_errors.fetch_add(1, std::memory_order_relaxed);
+			return;
+		}
+		std::lock_guard<std::mutex> lock(mutex);
+		items.push_back({ std::string(entry.relative), info });
+	}, walk_opts);
+	result.errors = listed.errors + stat_errors;
+
+	if (items.size() > UINT32_MAX) {
+		result.error = EFBIG;
+		return result;
+	}
+
+	// the root ("") sorts first, and stays there.
+	std::vector<uint32_t> order(items.size());
+	std::iota(order.begin(), order.end(), uint32_t(0));
+	std::sort(order.begin() + 1, order.end(), [&](uint32_t a, uint32_t b) {
+		return component_less(items[a].relative, items[b].relative);
+	});
+
+	std::string strings;
+	strings.reserve(root.uni_string().length() + 1 + items.size() * 32);
+	strings += root.uni_string();
+	strings += '\0';
+
+	std::vector<snapshot_record> records(items.size());
+	std::vector<uint32_t> open_dirs;		// ancestors of the current record, innermost last
+	for (uint32_t idx=0; idx<uint32_t(order.size()); ++idx) {
+		const auto& src = items[order[idx]];
+
+		// close the directories this entry isn't inside of.
+		while (!open_dirs.empty()) {
+			const auto& dir = items[order[open_dirs.back()]].relative;
+			bool inside = dir.empty() || (src.relative.length() > dir.length()
+				&& src.relative[dir.length()] == '/' && src.relative.compare(0, dir.length(), dir) == 0
+			);
+			if (inside) break;
+			records[open_dirs.back()].subtree_end = idx;
+			open_dirs.pop_back();
+		}
+
+		auto& dest = records[idx];
+		dest.path_offset	= uint32_t(src.relative.empty() ? strings.length() - 1 : strings.length());
+		dest.path_length	= uint32_t(src.relative.length());
+		dest.subtree_end	= idx + 1;
+		dest.mode			= src.info.st_mode;
+		dest.size			= int64_t(src.info.st_size);
+		dest.time_accessed	= int64_t(src.info.time_accessed);
+		dest.time_modified	= int64_t(src.info.time_modified);
+		dest.time_created	= int64_t(src.info.time_created);
+
+		if (!src.relative.empty()) {
+			strings += src.relative;
+			strings += '\0';
+		}
+		if (src.info.IsDir()) {
+			open_dirs.push_back(idx);
+		}
+		if (strings.length() > UINT32_MAX) {
+			result.error = EFBIG;
+			return result;
+		}
+	}
+	for (auto idx : open_dirs) {
+		records[idx].subtree_end = uint32_t(records.size());
+	}
+
+	snapshot_header header = {};
+	memcpy(header.magic, snapshot_magic, sizeof(header.magic));
+	header.version			= snapshot_version;
+	header.byte_order		= snapshot_byte_order;
+	header.header_size		= sizeof(snapshot_header);
+	header.record_size		= sizeof(snapshot_record);
+	header.count			= records.size();
+	header.records_offset	= align_up(sizeof(snapshot_header), 64);
+	header.strings_offset	= header.records_offset + records.size() * sizeof(snapshot_record);
+	header.strings_size		= strings.size();
+	header.root_length		= root.uni_string().length();
+	header.created			= int64_t(created);
+	header.file_size		= header.strings_offset + header.strings_size;
+
+	hasher checksum;
+	checksum.update(records.data(), records.size() * sizeof(snapshot_record));
+	checksum.update(strings.data(), strings.size());
+	header.checksum = checksum.digest();
+
+	result.error = write_atomically(file, header, records, strings);
+	if (!result.error) {
+		result.entries = records.size();
+	}
+	return result;
+}
+
+// --------------------------------------------------------------------------------------------------
+// snapshot
+//
+snapshot::snapshot(const path& file, bool verify) {
+	open(file, verify);
+}
+
+snapshot::snapshot(snapshot&& rvalue) noexcept {
+	*this = std::move(rvalue);
+}
+
+snapshot& snapshot::operator=(snapshot&& rvalue) noexcept {
+	if (this != &rvalue) {
+		// the mapping doesn't move, so the pointers into it stay valid.
+		file_		= std::move(rvalue.file_);
+		header_		= rvalue.header_;
+		records_	= rvalue.records_;
+		strings_	= rvalue.strings_;
+		error_		= rvalue.error_;
+		rvalue.header_	= nullptr;
+		rvalue.records_	= nullptr;
+		rvalue.strings_	= nullptr;
+	}
+	return *this;
+}
+
+bool snapshot::open(const path& file, bool verify) {
+	close();
+
+	if (!file_.open(file) || !file_.map()) {
+		error_ = file_.error();
+		file_.close();
+		return false;
+	}
+
+	auto span = file_.span();
+	const auto* header = (const snapshot_header*)span.data;
+	bool valid = span.size >= sizeof(snapshot_header)
+		&& !memcmp(header->magic, snapshot_magic, sizeof(header->magic))
+		&& header->version		== snapshot_version
+		&& header->byte_order	== snapshot_byte_order
+		&& header->header_size	== sizeof(snapshot_header)
+		&& header->record_size	== sizeof(snapshot_record)
+		&& header->file_size	== span.size
+		&& header->count		>= 1
+		&& header->records_offset >= sizeof(snapshot_header) && header->records_offset % 8 == 0
+		&& header->count <= (span.size - header->records_offset) / sizeof(snapshot_record)
+		&& header->strings_offset == header->records_offset + header->count * sizeof(snapshot_record)
+		&& header->strings_size == span.size - header->strings_offset
+		&& header->root_length	< header->strings_size
+		&& span.data[span.size - 1] == 0;
+	if (!valid) {
+		error_ = EINVAL;
+		file_.close();
+		return false;
+	}
+
+	if (verify) {
+		auto body = span.subspan(size_t(header->records_offset));
+		if (hasher::hash(hash_algorithm::xxh3, body.data, body.size) != header->checksum) {
+			error_ = EILSEQ;
+			file_.close();
+			return false;
+		}
+	}
+
+	header_		= header;
+	records_	= (const snapshot_record*)(span.data + header->records_offset);
+	strings_	= (const char*)(span.data + header->strings_offset);
+	error_		= 0;
+	return true;
+}
+
+void snapshot::close() {
+	file_.close();
+	header_		= nullptr;
+	records_	= nullptr;
+	strings_	= nullptr;
+}
+
+std::string_view snapshot::root() const {
+	return header_ ? std::string_view(strings_, size_t(header_->root_length)) : std::string_view();
+}
+
+std::string_view snapshot::relative(size_t idx) const {
+	// the terminator must be inside the strings too.
+	const auto& src = records_[idx];
+	if (uint64_t(src.path_offset) + src.path_length >= header_->strings_size) {
+		return {};
+	}
+	return { strings_ + src.path_offset, src.path_length };
+}
+
+size_t snapshot::subtree_end(size_t idx) const {
+	return std::min(std::max(size_t(records_[idx].subtree_end), idx + 1), size());
+}
+
+snapshot_entry snapshot::operator[](size_t idx) const {
+	const auto& src = records_[idx];
+	snapshot_entry entry;
+	entry.relative		= relative(idx);
+	entry.info			= { src.mode, intmax_t(src.size), time_t(src.time_accessed), time_t(src.time_modified), time_t(src.time_created) };
+	entry.index			= idx;
+	entry.subtree_end	= subtree_end(idx);
+	return entry;
+}
+
+size_t snapshot::find(std::string_view relative) const {
+	size_t lo = 0;
+	size_t hi = size();
+	while (lo < hi) {
+		auto mid = lo + (hi - lo) / 2;
+		if (component_less(this->relative(mid), relative)) {
+			lo = mid + 1;
+		}
+		else {
+			hi = mid;
+		}
+	}
+	return (lo < size() && this->relative(lo) == relative) ? lo : npos;
+}
+
+} // namespace fs
@@ -0,0 +1,69 @@
+#include "fs_stat_cache.h"
+
+namespace fs {
+
+CStatInfo stat_cache::status(const path& fspath)
+{
+	auto& shard = shard_for(fspath);
+	auto  gen   = generation();
+	uint64_t erasures;
+
+	{
+		std::lock_guard<std::mutex> lock(shard.mutex);
+		auto it = shard.entries.find(fspath.uni_string());
+		if (it != shard.entries.end() && it->second.generation == gen) {
+			hits_.fetch_add(1, std::memory_order_relaxed);
+			return it->second.info;
+		}
+		erasures = shard.erasures;
+	}
+
+	// stat outside the lock. The entry is tagged with the generation sampled beforehand, so an
+	// invalidate() racing with the stat leaves it stale rather than letting it pass as current.
+	// Likewise a racing invalidate(path) on this shard means the result isn't stored at all.
+	misses_.fetch_add(1, std::memory_order_relaxed);
+	auto info = fs::status(fspath);
+
+	std::lock_guard<std::mutex> lock(shard.mutex);
+	if (shard.erasures == erasures) {
+		auto& slot = shard.entries[fspath.uni_string()];
+		if (slot.generation <= gen) {
+			slot = { info, gen };
+		}
+	}
+	return info;
+}
+
+void stat_cache::invalidate()
+{
+	generation_.fetch_add(1, std::memory_order_relaxed);
+}
+
+void stat_cache::invalidate(const path& fspath)
+{
+	auto& shard = shard_for(fspath);
+	std::lock_guard<std::mutex> lock(shard.mutex);
+	shard.entries.erase(fspath.uni_string());
+	++shard.erasures;
+}
+
+void stat_cache::clear()
+{
+	for (auto& shard : shards_) {
+		std::lock_guard<std::mutex> lock(shard.mutex);
+		shard.entries.clear();
+		++shard.erasures;
+	}
+}
+
+size_t stat_cache::size()
+{
+	size_t total = 0;
+	for (auto& shard : shards_) {
+		std::lock_guard<std::mutex> lock(shard.mutex);
+		total += shard.entries.size();
+	}
+	return total;
+}
+
+} // namespace fs
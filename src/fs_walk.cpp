@@ -0,0 +1,304 @@
+#include "fs_walk.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_set>
+
+#if PLATFORM_POSIX
+#	include <fcntl.h>
+#	include <unistd.h>
+#	include <sys/stat.h>
+#endif
+
+namespace fs {
+
+// Subdirectories are opened by their parent (openat) and stay open while queued. Past this many
+// open queued fds, further subdirectories are queued by path and opened when popped instead, so
+// very wide trees can't exhaust the process fd limit.
+static const int walk_max_queued_fds = 256;
+
+using walk_visitor = std::function<void (int worker, const walk_entry& entry)>;
+
+struct walk_task {
+	std::string		dir;			// universal path
+	int				fd		= -1;	// already-open directory (posix), or -1 to open by path
+	int				depth	= 0;	// depth of the directory itself, 0 for the root
+};
+
+struct walk_queue {
+	std::mutex				mutex;
+	std::deque<walk_task>	tasks;
+};
+
+#if PLATFORM_POSIX
+static file_type file_type_from_mode(mode_t mode) {
+	switch (mode & S_IFMT) {
+		case S_IFREG:	return file_type::regular;
+		case S_IFDIR:	return file_type::directory;
+		case S_IFLNK:	return file_type::symlink;
+		case S_IFBLK:	return file_type::block;
+		case S_IFCHR:	return file_type::character;
+		case S_IFIFO:	return file_type::fifo;
+		case S_IFSOCK:	return file_type::socket;
+	}
+	return file_type::unknown;
+}
+
+struct dev_ino_hash {
+	size_t operator()(const std::pair<dev_t, ino_t>& key) const {
+		return std::hash<uint64_t>()(uint64_t(key.first) * 0x9E3779B97F4A7C15ULL ^ uint64_t(key.second));
+	}
+};
+#endif
+
+class walker
+{
+protected:
+	const walk_options&				options_;
+	const walk_visitor&				visitor_;
+	int								workers_;
+	size_t							root_len_	= 0;		// length of the root prefix, with separator
+	std::unique_ptr<walk_queue[]>	queues_;
+
+	std::atomic<intmax_t>			pending_	= { 0 };		// tasks queued or in progress
+	std::atomic<int>				queued_fds_	= { 0 };
+	std::atomic<intmax_t>			dirs_		= { 0 };
+	std::atomic<intmax_t>			entries_	= { 0 };
+	std::atomic<intmax_t>			errors_		= { 0 };
+
+#if PLATFORM_POSIX
+	// only populated when following symlinks, which is the only way a walk can revisit a directory.
+	std::mutex													visited_mutex_;
+	std::unordered_set<std::pair<dev_t, ino_t>, dev_ino_hash>	visited_;
+#endif
+
+public:
+	walker(const walk_options& options, const walk_visitor& visitor, int workers)
+		: options_(options), visitor_(visitor), workers_(workers), queues_(new walk_queue[workers]) { }
+
+	walk_stats run(const path& root) {
+		walk_task task;
+		task.dir  = root.uni_string();
+		root_len_ = task.dir.length() + 1;
+		push(0, std::move(task));
+
+		std::vector<std::thread> threads;
+		threads.reserve(workers_ - 1);
+		for (int worker=1; worker<workers_; ++worker) {
+			threads.emplace_back([this, worker]() { work(worker); });
+		}
+		work(0);
+		for (auto& thread : threads) {
+			thread.join();
+		}
+
+		walk_stats stats;
+		stats.dirs		= dirs_;
+		stats.entries	= entries_;
+		stats.errors	= errors_;
+		return stats;
+	}
+
+protected:
+	void push(int worker, walk_task&& task) {
+		pending_.fetch_add(1, std::memory_order_acq_rel);
+		auto& queue = queues_[worker];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		queue.tasks.push_back(std::move(task));
+	}
+
+	bool pop(int worker, walk_task& dest) {
+		{
+			// own queue: newest first.
+			auto& queue = queues_[worker];
+			std::lock_guard<std::mutex> lock(queue.mutex);
+			if (!queue.tasks.empty()) {
+				dest = std::move(queue.tasks.back());
+				queue.tasks.pop_back();
+				return true;
+			}
+		}
+
+		// steal: oldest first, which tends to be the shallowest and thus largest remaining subtree.
+		for (int i=1; i<workers_; ++i) {
+			auto& queue = queues_[(worker + i) % workers_];
+			std::lock_guard<std::mutex> lock(queue.mutex);
+			if (!queue.tasks.empty()) {
+				dest = std::move(queue.tasks.front());
+				queue.tasks.pop_front();
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void work(int worker) {
+		std::string fullpath;
+		walk_task	task;
+		int			idle = 0;
+
+		while (1) {
+			if (pop(worker, task)) {
+				process(worker, task, fullpath);
+				pending_.fetch_sub(1, std::memory_order_acq_rel);
+				idle = 0;
+				continue;
+			}
+			if (pending_.load(std::memory_order_acquire) == 0) {
+				break;
+			}
+
+			// others are still listing and may yet queue work. Back off if that takes a while.
+			if (++idle < 64) {
+				std::this_thread::yield();
+			}
+			else {
+				std::this_thread::sleep_for(std::chrono::microseconds(50));
+			}
+		}
+	}
+
+	directory_stream open_task(walk_task& task) {
+#if PLATFORM_POSIX
+		if (task.fd >= 0) {
+			queued_fds_.fetch_sub(1, std::memory_order_relaxed);
+			return directory_stream::adopt_fd(task.fd);
+		}
+		// the root is followed whatever the policy: it's what the caller asked for.
+		if (task.depth > 0 && options_.symlinks != symlink_policy::follow) {
+			return directory_stream::adopt_fd(::open(task.dir.c_str(), O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC));
+		}
+#endif
+		return directory_stream(path(path_view(task.dir)));
+	}
+
+	bool first_visit(const directory_stream& stream) {
+#if PLATFORM_POSIX
+		if (options_.symlinks != symlink_policy::follow) return true;
+
+		struct stat sinfo;
+		if (fstat(stream.native_fd(), &sinfo) == -1) return true;
+
+		std::lock_guard<std::mutex> lock(visited_mutex_);
+		return visited_.insert({ sinfo.st_dev, sinfo.st_ino }).second;
+#else
+		// msw: no cheap directory identity, cycles through reparse points are bounded by max_depth only.
+		return true;
+#endif
+	}
+
+	void process(int worker, walk_task& task, std::string& fullpath) {
+		auto stream = open_task(task);
+		if (!stream.is_open()) {
+			errors_.fetch_add(1, std::memory_order_relaxed);
+			return;
+		}
+		if (!first_visit(stream)) {
+			return;
+		}
+		dirs_.fetch_add(1, std::memory_order_relaxed);
+
+		fullpath  = task.dir;
+		fullpath += '/';
+		auto dirlen = fullpath.length();
+		auto depth  = task.depth + 1;
+		bool may_descend = (options_.max_depth < 0 || depth < options_.max_depth);
+
+		dir_entry entry;
+		while (stream.next(entry)) {
+			fullpath.resize(dirlen);
+			fullpath += entry.name;
+
+			walk_entry item;
+			item.path		= path_view(fullpath);
+			item.relative	= std::string_view(fullpath).substr(root_len_);
+			item.name		= std::string_view(fullpath).substr(dirlen);
+			item.type		= entry.type;
+			item.depth		= depth;
+
+#if PLATFORM_POSIX
+			if (item.type == file_type::unknown) {
+				// filesystem doesn't fill d_type (some network and older filesystems).
+				struct stat sinfo;
+				if (fstatat(stream.native_fd(), entry.name.data(), &sinfo, AT_SYMLINK_NOFOLLOW) == 0) {
+					item.type = file_type_from_mode(sinfo.st_mode);
+				}
+			}
+#endif
+
+			if (!options_.filter || options_.filter(item)) {
+				visitor_(worker, item);
+				entries_.fetch_add(1, std::memory_order_relaxed);
+			}
+
+			if (!may_descend) continue;
+
+			bool is_dir = (item.type == file_type::directory);
+			if (item.type == file_type::symlink && options_.symlinks == symlink_policy::follow) {
+				is_dir = stream.status(entry).IsDir();
+			}
+			if (!is_dir || (options_.descend && !options_.descend(item))) continue;
+
+			walk_task child;
+			child.dir	= fullpath;
+			child.depth	= depth;
+#if PLATFORM_POSIX
+			// a directory swapped for a symlink since it was listed mustn't be descended into.
+			if (queued_fds_.fetch_add(1, std::memory_order_relaxed) < walk_max_queued_fds) {
+				int nofollow = (options_.symlinks == symlink_policy::follow) ? 0 : O_NOFOLLOW;
+				child.fd = openat(stream.native_fd(), entry.name.data(), O_RDONLY | O_DIRECTORY | O_CLOEXEC | nofollow);
+			}
+			if (child.fd < 0) {
+				queued_fds_.fetch_sub(1, std::memory_order_relaxed);
+			}
+#endif
+			push(worker, std::move(child));
+		}
+
+		if (stream.error()) {
+			errors_.fetch_add(1, std::memory_order_relaxed);
+		}
+	}
+};
+
+static int walk_worker_count(const walk_options& options) {
+	if (options.threads > 0) return options.threads;
+	return std::max(1, (int)std::thread::hardware_concurrency());
+}
+
+walk_stats walk(const path& root, const std::function<void (const walk_entry& entry)>& visitor, const walk_options& options)
+{
+	if (options.max_depth == 0) return {};
+
+	walk_visitor forward = [&visitor](int, const walk_entry& entry) {
+		visitor(entry);
+	};
+	walker w(options, forward, walk_worker_count(options));
+	return w.run(root);
+}
+
+walk_stats walk(const path& root, path_list& dest, const walk_options& options)
+{
+	if (options.max_depth == 0) return {};
+
+	// one list per worker, so collection needs no synchronization.
+	auto workers = walk_worker_count(options);
+	std::vector<path_list> partial(workers);
+	walk_visitor collect = [&partial](int worker, const walk_entry& entry) {
+		partial[worker].push_back(entry.path);
+	};
+
+	walker w(options, collect, workers);
+	auto stats = w.run(root);
+	for (const auto& list : partial) {
+		dest.append(list);
+	}
+	return stats;
+}
+
+} // namespace fs
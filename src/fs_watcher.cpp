@@ -0,0 +1,420 @@
+#include "fs_watcher.h"
+#include "fs_stat_cache.h"
+#include "fs_directory.h"
+#include "icy_log.h"
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+#if PLATFORM_LINUX
+#	include <poll.h>
+#	include <unistd.h>
+#	include <cerrno>
+#	include <sys/eventfd.h>
+#	include <sys/inotify.h>
+#endif
+
+namespace fs {
+
+// --------------------------------------------------------------------------------------------------
+// Accumulates the events of a burst, keeping one record per path in order of first appearance.
+//
+class change_coalescer
+{
+protected:
+	std::vector<file_change>				changes_;
+	std::vector<bool>						live_;			// false once a change cancelled itself out
+	std::unordered_map<std::string, size_t>	index_;
+
+public:
+	bool empty() const { return changes_.empty(); }
+
+	void record(const std::string& uni_path, change_kind kind) {
+		auto it = index_.find(uni_path);
+		if (it == index_.end()) {
+			index_.emplace(uni_path, changes_.size());
+			changes_.push_back({ path(path_view(uni_path)), kind });
+			live_.push_back(true);
+			return;
+		}
+
+		auto  idx  = it->second;
+		auto& prev = changes_[idx].kind;
+		if (!live_[idx]) {
+			// created and removed earlier in the burst, so it didn't exist beforehand.
+			prev = change_kind::created;
+			live_[idx] = (kind != change_kind::removed);
+		}
+		else if (prev == change_kind::created) {
+			live_[idx] = (kind != change_kind::removed);
+		}
+		else if (prev == change_kind::removed && kind == change_kind::created) {
+			prev = change_kind::modified;		// replaced: existed before and after
+		}
+		else {
+			prev = kind;
+		}
+	}
+
+	void take(change_set& dest) {
+		dest.changes.clear();
+		for (size_t i=0; i<changes_.size(); ++i) {
+			if (live_[i]) {
+				dest.changes.push_back(std::move(changes_[i]));
+			}
+		}
+		changes_.clear();
+		live_   .clear();
+		index_  .clear();
+	}
+};
+
+struct watcher::impl
+{
+	struct config_entry {
+		path				file;				// lexically normal, for comparison against changes
+		ConfigParseAddFunc	push_item;
+	};
+
+	std::mutex					mutex;			// guards everything below that isn't thread-owned
+	stat_cache*					cache = nullptr;
+	std::vector<config_entry>	configs;
+
+	callback					func;
+	watcher_options				options;
+	std::thread					thread;
+	std::atomic<bool>			running = { false };
+
+#if PLATFORM_LINUX
+	struct watch_entry {
+		std::string		dir;					// universal path
+		bool			recursive	= false;
+		bool			root		= false;		// given to watch(), rather than found below one
+	};
+
+	int										notify_fd	= -1;
+	int										stop_fd		= -1;
+	std::unordered_map<int, watch_entry>	watches;
+
+	bool add_watch(const std::string& dir, bool recursive, change_coalescer* created_out, bool root = false);
+	void remove_watches(const std::string& dir);
+	void read_events(change_coalescer& pending, bool& overflowed);
+	void run();
+#endif
+
+	void deliver(change_coalescer& pending, bool overflowed);
+};
+
+// Runs on the watcher thread: cache invalidation and config reloads first, so that the callback
+// observes their results.
+void watcher::impl::deliver(change_coalescer& pending, bool overflowed)
+{
+	change_set batch;
+	pending.take(batch);
+	batch.overflowed = overflowed;
+	if (batch.changes.empty() && !overflowed) return;
+
+	std::vector<config_entry> reloads;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (cache) {
+			if (overflowed) {
+				cache->invalidate();
+			}
+			for (const auto& change : batch.changes) {
+				cache->invalidate(change.path);
+				if (change.kind != change_kind::modified) {
+					// creation and removal also change the parent directory.
+					cache->invalidate(path(change.path.parent_path()));
+				}
+			}
+		}
+
+		for (const auto& config : configs) {
+			bool changed = overflowed;
+			for (const auto& change : batch.changes) {
+				if (changed) break;
+				changed = (change.kind != change_kind::removed) && (change.path.lexically_normal() == config.file);
+			}
+			if (changed) {
+				reloads.push_back(config);
+			}
+		}
+	}
+
+	// copies, parsed outside the lock so that push_item may call back into the watcher.
+	for (const auto& config : reloads) {
+		ConfigParseFile(config.file.c_str(), config.push_item);
+	}
+
+	if (func) {
+		func(batch);
+	}
+}
+
+#if PLATFORM_LINUX
+// --------------------------------------------------------------------------------------------------
+// linux: inotify
+//
+static const uint32_t watch_mask =
+	IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_MODIFY | IN_CLOSE_WRITE | IN_ATTRIB |
+	IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR;
+
+// Adds a watch for dir, and for recursive watches every directory below it. When created_out is
+// given, entries found below dir are recorded as created: they appeared between the creation of
+// dir and the watch being placed on it, so no event will ever be reported for them.
+bool watcher::impl::add_watch(const std::string& dir, bool recursive, change_coalescer* created_out, bool root)
+{
+	int wd = inotify_add_watch(notify_fd, dir.c_str(), watch_mask);
+	if (wd < 0) {
+		return false;
+	}
+
+	{
+		// the same directory may be watched twice, eg. by reload_config(): recursive wins.
+		std::lock_guard<std::mutex> lock(mutex);
+		auto& entry = watches[wd];
+		entry.recursive = entry.recursive || recursive;
+		entry.root      = entry.root || root;
+		entry.dir = dir;
+	}
+
+	if (!recursive && !created_out) return true;
+
+	directory_stream stream{ path(path_view(dir)) };
+	std::string child = dir + '/';
+	auto dirlen = child.length();
+	for (const auto& entry : stream) {
+		child.resize(dirlen);
+		child += entry.name;
+		if (created_out) {
+			created_out->record(child, change_kind::created);
+		}
+		if (recursive) {
+			bool is_dir = (entry.type == file_type::unknown) ? stream.status(entry).IsDir() : entry.is_directory();
+			if (is_dir) {
+				add_watch(child, true, created_out);
+			}
+		}
+	}
+	return true;
+}
+
+// Drops the watches on dir and every directory below it, save those given to watch(). Their wds keep reporting the inodes
+// wherever they go, under paths recorded for where they were.
+void watcher::impl::remove_watches(const std::string& dir)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	for (auto it = watches.begin(); it != watches.end(); ) {
+		const auto& watched = it->second.dir;
+		bool below = watched.length() > dir.length() && watched[dir.length()] == '/' && !watched.compare(0, dir.length(), dir);
+		if ((watched == dir || below) && !it->second.root) {
+			inotify_rm_watch(notify_fd, it->first);
+			it = watches.erase(it);
+		}
+		else {
+			++it;
+		}
+	}
+}
+
+void watcher::impl::read_events(change_coalescer& pending, bool& overflowed)
+{
+	alignas(inotify_event) char buf[16 * 1024];
+
+	while (1) {
+		auto got = read(notify_fd, buf, sizeof(buf));
+		if (got <= 0) {
+			// EAGAIN: drained.
+			return;
+		}
+
+		for (char* ptr = buf; ptr < buf + got; ) {
+			auto* ev = (const inotify_event*)ptr;
+			ptr += sizeof(inotify_event) + ev->len;
+
+			if (ev->mask & IN_Q_OVERFLOW) {
+				overflowed = true;
+				continue;
+			}
+
+			watch_entry watched;
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				auto it = watches.find(ev->wd);
+				if (it == watches.end()) continue;
+				if (ev->mask & IN_IGNORED) {
+					watches.erase(it);
+					continue;
+				}
+				watched = it->second;
+			}
+
+			if (ev->mask & (IN_DELETE_SELF | IN_MOVE_SELF)) {
+				// children are reported individually, and the parent's watch reports the dir itself.
+				continue;
+			}
+			if (!ev->len) continue;
+
+			std::string full = watched.dir + '/' + ev->name;
+			auto kind =
+				(ev->mask & (IN_CREATE | IN_MOVED_TO))		? change_kind::created	:
+				(ev->mask & (IN_DELETE | IN_MOVED_FROM))	? change_kind::removed	:
+															  change_kind::modified	;
+
+			pending.record(full, kind);
+
+			// a directory moved away takes its watches along. They are dropped here rather than on its
+			// IN_MOVE_SELF, which arrives after IN_MOVED_TO: a move within the tree has re-added them
+			// under the new path by then.
+			if ((ev->mask & IN_MOVED_FROM) && (ev->mask & IN_ISDIR)) {
+				remove_watches(full);
+			}
+
+			if (kind == change_kind::created && (ev->mask & IN_ISDIR) && watched.recursive) {
+				add_watch(full, true, &pending);
+			}
+		}
+	}
+}
+
+void watcher::impl::run()
+{
+	using clock = std::chrono::steady_clock;
+
+	change_coalescer	pending;
+	bool				overflowed	= false;
+	clock::time_point	first_event;
+	clock::time_point	last_event;
+
+	pollfd fds[2] = {
+		{ notify_fd,	POLLIN, 0 },
+		{ stop_fd,		POLLIN, 0 },
+	};
+
+	while (1) {
+		int timeout = -1;
+		if (!pending.empty() || overflowed) {
+			auto due = std::min(last_event + options.debounce, first_event + options.max_delay);
+			auto ms  = std::chrono::duration_cast<std::chrono::milliseconds>(due - clock::now()).count();
+			timeout  = (ms > 0) ? int(ms) : 0;
+		}
+
+		if (poll(fds, 2, timeout) < 0 && errno != EINTR) {
+			log_error("fs::watcher: poll() failed, errno=%d", errno);
+			break;
+		}
+		if (fds[1].revents) {
+			break;
+		}
+
+		if (fds[0].revents & POLLIN) {
+			bool was_idle = pending.empty() && !overflowed;
+			read_events(pending, overflowed);
+			last_event = clock::now();
+			if (was_idle) {
+				first_event = last_event;
+			}
+		}
+
+		if (!pending.empty() || overflowed) {
+			auto now = clock::now();
+			if (now - last_event >= options.debounce || now - first_event >= options.max_delay) {
+				deliver(pending, overflowed);
+				overflowed = false;
+			}
+		}
+	}
+}
+
+watcher::watcher() : impl_(new impl) {
+	impl_->notify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	impl_->stop_fd   = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (impl_->notify_fd < 0) {
+		log_error("fs::watcher: inotify_init1() failed, errno=%d", errno);
+	}
+}
+
+watcher::~watcher() {
+	stop();
+	if (impl_->notify_fd >= 0) close(impl_->notify_fd);
+	if (impl_->stop_fd   >= 0) close(impl_->stop_fd);
+}
+
+// inotify may be left out of the kernel, or its per-user instance limit reached.
+bool watcher::is_supported() {
+	int fd = inotify_init1(IN_CLOEXEC);
+	if (fd < 0) return false;
+	close(fd);
+	return true;
+}
+
+bool watcher::watch(const path& dir, bool recursive) {
+	if (impl_->notify_fd < 0) return false;
+	return impl_->add_watch(dir.uni_string(), recursive, nullptr, true);
+}
+
+bool watcher::start(const callback& func, const watcher_options& options) {
+	if (impl_->notify_fd < 0 || impl_->stop_fd < 0) return false;
+	if (impl_->running) return false;
+
+	impl_->func		= func;
+	impl_->options	= options;
+	impl_->running	= true;
+	impl_->thread	= std::thread([this]() { impl_->run(); });
+	return true;
+}
+
+void watcher::stop() {
+	if (!impl_->running.exchange(false)) return;
+
+	uint64_t one = 1;
+	if (write(impl_->stop_fd, &one, sizeof(one)) < 0) {
+		log_error("fs::watcher: failed to signal stop, errno=%d", errno);
+	}
+	impl_->thread.join();
+
+	uint64_t drain;
+	if (read(impl_->stop_fd, &drain, sizeof(drain)) < 0) { }
+}
+
+#else
+// --------------------------------------------------------------------------------------------------
+// no backend: everything fails gracefully, callers fall back to polling.
+//
+watcher::watcher() : impl_(new impl) { }
+watcher::~watcher() { }
+
+bool watcher::is_supported()							{ return false; }
+bool watcher::watch(const path&, bool)					{ return false; }
+bool watcher::start(const callback&, const watcher_options&) { return false; }
+void watcher::stop() { }
+#endif
+
+bool watcher::is_running() const {
+	return impl_->running;
+}
+
+void watcher::attach_stat_cache(stat_cache* cache) {
+	std::lock_guard<std::mutex> lock(impl_->mutex);
+	impl_->cache = cache;
+}
+
+bool watcher::reload_config(const path& file, const ConfigParseAddFunc& push_item) {
+	ConfigParseFile(file.c_str(), push_item);
+
+	auto dir = file.parent_path();
+	if (!watch(dir.empty() ? path(".") : dir, false)) {
+		return false;
+	}
+
+	std::lock_guard<std::mutex> lock(impl_->mutex);
+	impl_->configs.push_back({ file.lexically_normal(), push_item });
+	return true;
+}
+
+} // namespace fs
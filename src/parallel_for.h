@@ -0,0 +1,46 @@
+#pragma once
+
+#include <thread>
+#include <vector>
+#include <algorithm>
+
+// --------------------------------------------------------------------------------------------------
+// ParallelForChunks
+//
+// Minimal fork/join helper for data-parallel batch APIs. Splits [0, count) into contiguous chunks
+// of near-equal size and runs func(chunk, beg, end) for each, on its own thread. The calling thread
+// always handles chunk 0, so a single-chunk job never spawns a thread.
+//
+// ParallelChunkCount() lets callers size per-chunk outputs before starting work. Chunks are never
+// smaller than min_chunk items (save for the case of count < min_chunk).
+//
+
+inline int ParallelChunkCount(size_t count, size_t min_chunk) {
+	int hw = std::max(1, (int)std::thread::hardware_concurrency());
+	auto by_size = (count + min_chunk - 1) / std::max<size_t>(min_chunk, 1);
+	return std::max(1, (int)std::min<size_t>(hw, by_size));
+}
+
+template<typename Func>
+void ParallelForChunks(size_t count, int chunks, Func&& func) {
+	auto chunk_range = [count, chunks](int chunk, size_t& beg, size_t& end) {
+		beg = (count *  chunk     ) / chunks;
+		end = (count * (chunk + 1)) / chunks;
+	};
+
+	std::vector<std::thread> workers;
+	workers.reserve(chunks - 1);
+	for (int chunk=1; chunk<chunks; ++chunk) {
+		size_t beg, end;
+		chunk_range(chunk, beg, end);
+		workers.emplace_back([&func, chunk, beg, end]() { func(chunk, beg, end); });
+	}
+
+	size_t beg, end;
+	chunk_range(0, beg, end);
+	func(0, beg, end);
+
+	for (auto& worker : workers) {
+		worker.join();
+	}
+}
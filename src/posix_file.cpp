@@ -14,27 +14,53 @@
 #include <climits>
 #include <algorithm>
 
-size_t _pread(int fd, void* dest, size_t count, x_off_t pos)
-{
-    // windows POSIX libs are lacking the fancy new pread() function. >_<
-    _lseeki64(fd, pos, SEEK_SET);
-    auto orig_count = count;
-
-    const auto int_max = 0x7fff'fffeULL;
-    static_assert(int_max == (int)int_max, "Looks like int is not four bytes.");
+// Both are implemented with OVERLAPPED offsets rather than _lseeki64 + _read, so that concurrent
+// calls on the same fd (eg. from fs::io_engine workers) don't race on the shared file position.
+// Returns size_t(-1) on error, with errno set.
 
-    // because Windows _read is still stuck in the land of 322-bits.
+static size_t _pio(int fd, void* buf, size_t count, x_off_t pos, bool write)
+{
+    auto handle = (HANDLE)_get_osfhandle(fd);
+    if (handle == INVALID_HANDLE_VALUE) {
+        errno = EBADF;
+        return size_t(-1);
+    }
 
-    while (count > 0) {
-        auto toread = std::min(count, int_max);
-        auto amt = _read(fd, dest, (int)toread);
-        count -= amt;
-        dbg_check(count >= 0);
-        if (amt != int_max) {
-            return orig_count - count;
+    // because Windows ReadFile/WriteFile are still stuck in the land of 32-bits.
+    const size_t chunk_max = 0x7fff'f000ULL;
+    size_t done = 0;
+    while (done < count) {
+        auto offset = uint64_t(pos) + done;
+        OVERLAPPED ov = {};
+        ov.Offset     = DWORD(offset);
+        ov.OffsetHigh = DWORD(offset >> 32);
+
+        DWORD amt = 0;
+        auto  len = DWORD(std::min(count - done, chunk_max));
+        BOOL  ok  = write
+            ? WriteFile(handle, (const char*)buf + done, len, &amt, &ov)
+            : ReadFile (handle, (char*)buf + done, len, &amt, &ov);
+        if (!ok) {
+            if (!write && GetLastError() == ERROR_HANDLE_EOF) break;
+            if (done) break;
+            errno = EIO;
+            return size_t(-1);
         }
+        done += amt;
+        if (amt != len) break;
     }
-    return orig_count;
+    return done;
+}
+
+size_t _pread(int fd, void* dest, size_t count, x_off_t pos)
+{
+    // windows POSIX libs are lacking the fancy new pread() function. >_<
+    return _pio(fd, dest, count, pos, false);
+}
+
+size_t _pwrite(int fd, const void* src, size_t count, x_off_t pos)
+{
+    return _pio(fd, (void*)src, count, pos, true);
 }
 
 CStatInfo posix_fstat(int fd) {
@@ -71,8 +97,8 @@ CStatInfo posix_stat(const char* path) {
     };
 }
 
-bool CStatInfo::IsFile     () const { return (st_mode & _S_IFREG) == _S_IFREG  ;}
-bool CStatInfo::IsDir      () const { return (st_mode & _S_IFDIR) == _S_IFDIR  ;}
+bool CStatInfo::IsFile     () const { return (st_mode & _S_IFMT ) == _S_IFREG  ;}
+bool CStatInfo::IsDir      () const { return (st_mode & _S_IFMT ) == _S_IFDIR  ;}
 bool CStatInfo::Exists     () const { return (st_mode & _S_IFMT ) != 0         ;}
 
 
@@ -122,8 +148,8 @@ CStatInfo posix_stat(const char* path) {
     };
 }
 
-bool CStatInfo::IsFile     () const { return (st_mode & S_IFREG) == S_IFREG  ;}
-bool CStatInfo::IsDir      () const { return (st_mode & S_IFDIR) == S_IFDIR  ;}
+bool CStatInfo::IsFile     () const { return (st_mode & S_IFMT ) == S_IFREG  ;}
+bool CStatInfo::IsDir      () const { return (st_mode & S_IFMT ) == S_IFDIR  ;}
 bool CStatInfo::Exists     () const { return (st_mode & S_IFMT ) != 0         ;}
 
 